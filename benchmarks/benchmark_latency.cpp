@@ -0,0 +1,549 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <cstdlib>
+#include <utility>
+#include <unistd.h>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+
+#include "fbgs-sensing/shape_sensing_interface.h"
+#include "fbgs-sensing/illumisense_interface.h"
+#include "fbgs-sensing/shape_sensing_simulator.h"
+#include "fbgs-sensing/illumisense_simulator.h"
+#include "fbgs-sensing/frame_server.h"
+#include "fbgs-sensing/frame.h"
+#include "fbgs-sensing/shared_memory_ring.h"
+#include "fbgs-sensing/sample_pipeline.h"
+
+
+
+// End-to-end latency of the samples, from the emission of the frame to its availability to the consumer, for every
+// ingest mode of the interfaces. A simulator is served on the loopback by an in-process FrameServer that records
+// the send time of every frame; the age of each sample is then measured at each stage:
+//      readable    the acquisition starts to read the frame (socket readable, or previous frame done)
+//      read        the frame is read (Sample::time_stamp)
+//      parsed      the frame is parsed
+//      stored      the sample reaches the sample callback (readNextSample() returns in the polling mode)
+//      published   the sample is seen by a SharedMemoryReader polling in another thread
+//      pipeline    the sample reaches a stage of a SamplePipeline (pipeline mode)
+// under configurable rates and background load (threads sweeping a large buffer), reported as p50/p99/p99.9/max.
+//      benchmark_latency --device illumisense --rates 1000,5000 --load 2 --modes loop-block,async
+
+
+
+//  Send times of the frames, indexed by sample number (modulo the size, a power of two)
+class SendTimes
+{
+public:
+
+    explicit SendTimes(const std::size_t t_size) :
+        m_times(t_size),
+        m_mask(t_size - 1)
+    {
+    }
+
+    void set(const std::int64_t t_sample_number, const std::int64_t t_time_ns)
+    {
+        m_times[t_sample_number & m_mask].store(t_time_ns, std::memory_order_release);
+    }
+
+    std::int64_t get(const std::int64_t t_sample_number) const
+    {
+        return m_times[t_sample_number & m_mask].load(std::memory_order_acquire);
+    }
+
+private:
+
+    std::vector<std::atomic<std::int64_t>> m_times;
+    std::size_t m_mask;
+};
+
+
+std::int64_t timeNs(const std::chrono::high_resolution_clock::time_point t_time)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t_time.time_since_epoch()).count();
+}
+
+std::int64_t nowNs()
+{
+    return timeNs(std::chrono::high_resolution_clock::now());
+}
+
+
+
+//  Records the send time of the frames of a simulator, from their sample number (third field of the frame)
+class TimedSource : public FrameSource
+{
+public:
+
+    TimedSource(std::shared_ptr<FrameSource> t_source,
+                SendTimes &t_send_times) :
+        m_source(t_source),
+        m_send_times(t_send_times)
+    {
+    }
+
+    bool nextFrame(std::vector<char> &t_frame,
+                   double &t_time) override
+    {
+        return m_source->nextFrame(t_frame, t_time);
+    }
+
+    void reset() override { m_source->reset(); }
+
+    void onSend(const std::vector<char> &t_frame) override
+    {
+        const char *field = t_frame.data() + FRAME_HEADER_SIZE;
+        const char *end = t_frame.data() + t_frame.size();
+
+        for(int tabs=0; tabs < 2 and field < end; field++)
+            if(*field == '\t')
+                tabs++;
+
+        m_send_times.set(std::strtoll(field, nullptr, 10), nowNs());
+    }
+
+private:
+
+    std::shared_ptr<FrameSource> m_source;
+    SendTimes &m_send_times;
+};
+
+
+
+
+enum Stage
+{
+    READABLE,
+    READ,
+    PARSED,
+    STORED,
+    PUBLISHED,
+    PIPELINE,
+    NUM_STAGES
+};
+
+const char *stage_names[NUM_STAGES] = { "readable", "read", "parsed", "stored", "published", "pipeline" };
+
+
+//  Ages (ns) of the samples at every stage
+class LatencyRecorder
+{
+public:
+
+    LatencyRecorder(const SendTimes &t_send_times,
+                    const std::size_t t_capacity) :
+        m_send_times(t_send_times)
+    {
+        for(std::vector<std::int64_t> &ages : m_ages)
+            ages.reserve(t_capacity);
+    }
+
+    //  The samples sent before are not recorded (connection, warm up)
+    void start(const std::int64_t t_start_ns) { m_start_ns.store(t_start_ns, std::memory_order_release); }
+
+    //  From a single thread per stage
+    void record(const Stage t_stage,
+                const std::int64_t t_sample_number,
+                const std::int64_t t_time_ns)
+    {
+        const std::int64_t sent_ns = m_send_times.get(t_sample_number);
+        const std::int64_t start_ns = m_start_ns.load(std::memory_order_acquire);
+
+        if(start_ns == 0 or sent_ns < start_ns)
+            return;
+
+        std::vector<std::int64_t> &ages = m_ages[t_stage];
+        if(ages.size() < ages.capacity())
+            ages.push_back(t_time_ns - sent_ns);
+    }
+
+    template<typename Sample>
+    void recordSample(const Sample &t_sample,
+                      const std::int64_t t_stored_ns)
+    {
+        record(READABLE, t_sample.sample_number, timeNs(t_sample.readable_time_stamp));
+        record(READ, t_sample.sample_number, timeNs(t_sample.time_stamp));
+        record(PARSED, t_sample.sample_number, timeNs(t_sample.parsed_time_stamp));
+        record(STORED, t_sample.sample_number, t_stored_ns);
+    }
+
+    void print(std::ostream &t_output,
+               const std::string &t_mode,
+               const double t_rate,
+               const unsigned int t_load) const
+    {
+        for(int stage=0; stage<NUM_STAGES; stage++){
+            std::vector<std::int64_t> ages = m_ages[stage];
+            if(ages.empty())
+                continue;
+
+            std::sort(ages.begin(), ages.end());
+
+            auto percentile = [&](const double t_percentile){
+                const std::size_t index = std::min(ages.size() - 1, static_cast<std::size_t>(t_percentile*ages.size()));
+                return 1e-3*ages[index];
+            };
+
+            t_output << std::left << std::setw(16) << t_mode << std::right
+                     << std::fixed << std::setprecision(0) << std::setw(8) << t_rate << std::setw(6) << t_load << std::setw(9) << ages.size()
+                     << "  " << std::left << std::setw(10) << stage_names[stage] << std::right << std::fixed << std::setprecision(1)
+                     << std::setw(10) << percentile(0.5) << std::setw(10) << percentile(0.99)
+                     << std::setw(10) << percentile(0.999) << std::setw(10) << 1e-3*ages.back() << "\n";
+        }
+        t_output.flush();
+    }
+
+private:
+
+    const SendTimes &m_send_times;
+    std::atomic<std::int64_t> m_start_ns { 0 };
+
+    std::vector<std::int64_t> m_ages[NUM_STAGES];
+};
+
+
+
+
+//  Threads sweeping a buffer larger than the caches, to compete for the cores and the memory bandwidth
+class BackgroundLoad
+{
+public:
+
+    explicit BackgroundLoad(const unsigned int t_num_threads)
+    {
+        for(unsigned int i=0; i<t_num_threads; i++)
+            m_threads.emplace_back([this](){
+                std::vector<std::uint64_t> buffer(4 << 20, 1);
+                std::uint64_t sum = 0;
+
+                while(not m_stop.load(std::memory_order_relaxed))
+                    for(std::size_t j=0; j<buffer.size(); j+=8)
+                        sum += buffer[j]++;
+
+                m_sink.fetch_add(sum, std::memory_order_relaxed);
+            });
+    }
+
+    ~BackgroundLoad()
+    {
+        m_stop.store(true);
+        for(std::thread &thread : m_threads)
+            thread.join();
+    }
+
+private:
+
+    std::vector<std::thread> m_threads;
+    std::atomic<bool> m_stop { false };
+    std::atomic<std::uint64_t> m_sink { 0 };
+};
+
+
+
+
+struct Options
+{
+    std::string device { "shape" };
+    std::vector<double> rates { 100, 1000 };
+    std::vector<std::string> modes { "loop-block", "loop-hybrid", "loop-spin", "async", "coroutine", "polling", "pipeline" };
+    unsigned int load { 0 };
+    double duration { 2 };          //  s, per run
+    bool publish { true };
+
+    //  Topology
+    int num_sensors { 1 };
+    int num_points { 200 };
+    int num_cores { 3 };
+    int num_gratings { 10 };
+};
+
+
+
+template<typename Interface>
+void run(std::ostream &t_output,
+         const Options &t_options,
+         const std::string &t_mode,
+         const double t_rate,
+         std::shared_ptr<FrameSource> t_simulator)
+{
+    using Sample = typename Interface::Sample;
+
+    const std::size_t capacity = static_cast<std::size_t>(t_rate*t_options.duration) + 16;
+
+    SendTimes send_times(1 << 16);
+    LatencyRecorder recorder(send_times, capacity);
+
+    auto control = std::make_shared<AcquisitionControl>();
+
+    FrameServer server(std::make_shared<TimedSource>(t_simulator, send_times), "127.0.0.1", 0);
+    if(not server.start())
+        return;
+
+    auto io_context = std::make_shared<boost::asio::io_context>();
+
+    Interface interface(control, t_rate, io_context);
+    interface.setAddress("127.0.0.1", std::to_string(server.getPort()));
+
+    const std::string segment = "/fbgs_latency_" + std::to_string(getpid());
+    if(t_options.publish)
+        interface.enableSharedMemoryPublisher(segment, 64);
+
+    SamplePipeline<Sample> pipeline;
+    if(t_mode == "pipeline"){
+        pipeline.addStage("consumer", [&](const Sample &t_sample){
+            recorder.record(PIPELINE, t_sample.sample_number, nowNs());
+        }, 64);
+        pipeline.start();
+    }
+
+    interface.setSampleCallback([&](const Sample &t_sample){
+        recorder.recordSample(t_sample, nowNs());
+
+        if(t_mode == "pipeline")
+            pipeline.push(t_sample);
+    });
+
+    if(not interface.connect())
+        return;
+
+
+    //  Consumer of the shared memory, in another thread
+    std::atomic<bool> stop { false };
+    std::thread reader_thread;
+    if(t_options.publish)
+        reader_thread = std::thread([&](){
+            SharedMemoryReader reader(segment);
+            SharedMemoryReader::View view;
+            std::uint64_t seen = 0;
+
+            while(not stop.load(std::memory_order_relaxed)){
+                if(reader.isOpen() or reader.open()){
+                    const std::uint64_t count = reader.getWriteCount();
+                    if(count != seen and reader.latest(view)){
+                        recorder.record(PUBLISHED, view.sample_number, nowNs());
+                        seen = count;
+                    }
+                }
+
+                std::this_thread::yield();
+            }
+        });
+
+
+    //  Acquisition, in the given mode
+    std::thread acquisition_thread;
+
+    if(t_mode.rfind("loop", 0) == 0){
+        WaitPolicy policy;
+        if(t_mode == "loop-spin")
+            policy.strategy = WaitPolicy::Strategy::SPIN;
+        else if(t_mode == "loop-hybrid")
+            policy.strategy = WaitPolicy::Strategy::SPIN_THEN_BLOCK;
+        interface.setWaitPolicy(policy);
+
+        interface.startRecordinLoop();
+    }
+    else if(t_mode == "pipeline")
+        interface.startRecordinLoop();
+    else if(t_mode == "async"){
+        interface.startAsyncAcquisition();
+        acquisition_thread = std::thread([&](){ io_context->run(); });
+    }
+    else if(t_mode == "coroutine"){
+        boost::asio::co_spawn(*io_context, [&]() -> boost::asio::awaitable<void> {
+            Sample sample;
+            while(true){
+                const bool received = co_await interface.next(sample);
+                if(not received)
+                    break;
+            }
+        }, boost::asio::detached);
+        acquisition_thread = std::thread([&](){ io_context->run(); });
+    }
+    else if(t_mode == "polling"){
+        acquisition_thread = std::thread([&](){
+            Sample sample;
+            while(not control->isShutdown()){
+                if(not interface.nextSampleReady()){
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                if(interface.readNextSample(sample))
+                    recorder.recordSample(sample, nowNs());
+            }
+        });
+    }
+    else {
+        std::cerr << "unknown mode " << t_mode << std::endl;
+
+        stop.store(true);
+        if(reader_thread.joinable())
+            reader_thread.join();
+        return;
+    }
+
+
+    {
+        BackgroundLoad load(t_options.load);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        recorder.start(nowNs());
+
+        std::this_thread::sleep_for(std::chrono::duration<double>(t_options.duration));
+
+        control->shutdown();
+        io_context->stop();
+    }
+
+    interface.shutdown();
+    if(acquisition_thread.joinable())
+        acquisition_thread.join();
+
+    pipeline.stop();
+
+    stop.store(true);
+    if(reader_thread.joinable())
+        reader_thread.join();
+
+    server.stop();
+
+
+    recorder.print(t_output, t_mode, t_rate, t_options.load);
+}
+
+
+
+
+std::vector<std::string> split(const std::string &t_list)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(t_list);
+    std::string item;
+    while(std::getline(stream, item, ','))
+        if(not item.empty())
+            items.push_back(item);
+
+    return items;
+}
+
+
+void printUsage()
+{
+    std::cout << "Usage: benchmark_latency [options]\n"
+                 "  --device <shape|illumisense>   interrogator to simulate (shape)\n"
+                 "  --rates <Hz,...>               sample rates (100,1000)\n"
+                 "  --modes <mode,...>             loop-block, loop-hybrid, loop-spin, async, coroutine, polling, pipeline (all)\n"
+                 "  --load <n>                     background threads sweeping memory (0)\n"
+                 "  --duration <s>                 measurement per mode and rate (2)\n"
+                 "  --publish <0|1>                publishes to shared memory, read by another thread (1)\n"
+                 "  --sensors <n>, --points <n>    Shape Sensing topology (1, 200)\n"
+                 "  --cores <n>, --gratings <n>    IllumiSense topology (3 outer cores and the central one, 10)\n";
+}
+
+
+
+
+int main(int argc, char **argv)
+{
+    Options options;
+
+    for(int i=1; i<argc; i++){
+        const std::string option = argv[i];
+
+        if(option == "--help" or option == "-h"){
+            printUsage();
+            return 0;
+        }
+
+        if(i + 1 >= argc){
+            std::cerr << "missing value for " << option << std::endl;
+            printUsage();
+            return 1;
+        }
+
+        const std::string value = argv[++i];
+
+        if(option == "--device")                    options.device = value;
+        else if(option == "--rates"){
+            options.rates.clear();
+            for(const std::string &rate : split(value))
+                options.rates.push_back(std::stod(rate));
+        }
+        else if(option == "--modes")                options.modes = split(value);
+        else if(option == "--load")                 options.load = static_cast<unsigned int>(std::stoul(value));
+        else if(option == "--duration")             options.duration = std::stod(value);
+        else if(option == "--publish")              options.publish = std::stoi(value) != 0;
+        else if(option == "--sensors")              options.num_sensors = std::stoi(value);
+        else if(option == "--points")               options.num_points = std::stoi(value);
+        else if(option == "--cores")                options.num_cores = std::stoi(value);
+        else if(option == "--gratings")             options.num_gratings = std::stoi(value);
+        else {
+            std::cerr << "unknown option " << option << std::endl;
+            printUsage();
+            return 1;
+        }
+    }
+
+    if(options.device != "shape" and options.device != "illumisense"){
+        std::cerr << "unknown device " << options.device << std::endl;
+        return 1;
+    }
+
+    //  Checked before anything is started, the default list holds all the modes
+    const std::vector<std::string> known_modes = Options().modes;
+    for(const std::string &mode : options.modes)
+        if(std::find(known_modes.begin(), known_modes.end(), mode) == known_modes.end()){
+            std::cerr << "unknown mode " << mode << std::endl;
+            printUsage();
+            return 1;
+        }
+
+
+    //  The interfaces print their progress on the standard output, the results go to its original buffer
+    std::ostream results(std::cout.rdbuf());
+    std::ostringstream discarded;
+    std::cout.rdbuf(discarded.rdbuf());
+
+    results << "Ages of the samples since their emission, in us\n"
+            << std::left << std::setw(16) << "mode" << std::right << std::setw(8) << "rate" << std::setw(6) << "load"
+            << std::setw(9) << "samples" << "  " << std::left << std::setw(10) << "stage" << std::right
+            << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "p99.9" << std::setw(10) << "max" << std::endl;
+
+    for(const double rate : options.rates)
+        for(const std::string &mode : options.modes){
+            if(options.device == "shape"){
+                ShapeSensingSimulator::Config config;
+                config.frequency = rate;
+                config.num_sensors = options.num_sensors;
+                config.num_shape_points = options.num_points;
+                config.num_gratings = options.num_gratings;
+
+                run<ShapeSensingInterface>(results, options, mode, rate, std::make_shared<ShapeSensingSimulator>(config));
+            }
+            else {
+                IllumiSenseSimulator::Config config;
+                config.frequency = rate;
+                config.num_outer_cores = options.num_cores;
+                config.num_gratings = options.num_gratings;
+
+                run<IllumiSenseInterface>(results, options, mode, rate, std::make_shared<IllumiSenseSimulator>(config));
+            }
+
+            discarded.str("");
+        }
+
+    std::cout.rdbuf(results.rdbuf());
+
+    return 0;
+}
@@ -1,65 +1,386 @@
 #include <iostream>
+#include <sstream>
 #include <vector>
 #include <string>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <cstdlib>
+#include <cerrno>
 #include <Eigen/Dense>
 
-
-#include <boost/array.hpp>
-#include <boost/asio.hpp>
+#include <yaml-cpp/yaml.h>
 
 #include "fbgs-sensing/shape_sensing_interface.h"
 #include "fbgs-sensing/illumisense_interface.h"
+#include "fbgs-sensing/shape_sensing_simulator.h"
+#include "fbgs-sensing/illumisense_simulator.h"
+#include "fbgs-sensing/frame_server.h"
+#include "fbgs-sensing/frame.h"
 
 #include <benchmark/benchmark.h>
 
-//defines
-#define SERVER_ADDRESS "192.168.1.11"
-#define PORT_NUMBER "5001" //Default port number for Shape Sensing
 
 
+// Benchmarks of the acquisition without the hardware: the frames of the simulators are generated once, then
+// served endlessly on the loopback by an in-process FrameServer, at the rate of an interrogator, or parsed from memory.
+// Every benchmark reports the time per frame (readNextSample() only, not the wait for the next frame) or per export,
+// the bytes per second and the allocations per frame (or per export) made by the benchmark thread.
+//      benchmark_reading --benchmark_filter=ReadNextSample
 
-const unsigned int repetitions = 5;
 
 
-int main(int argc, char *argv[])
+//  Allocations of the threads that count them. They are counted at the allocator: Eigen allocates with malloc
+//  directly, without going through operator new. The functions of glibc are replaced for the whole process,
+//  the library included, and forward to its internal entry points
+std::atomic<std::uint64_t> allocations { 0 };
+thread_local bool count_allocations = false;
+
+extern "C" void *__libc_malloc(std::size_t);
+extern "C" void *__libc_calloc(std::size_t, std::size_t);
+extern "C" void *__libc_realloc(void*, std::size_t);
+extern "C" void *__libc_memalign(std::size_t, std::size_t);
+
+
+inline void countAllocation()
 {
-    ::benchmark::Initialize(&argc, argv);
+    if(count_allocations)
+        allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+extern "C" void *malloc(std::size_t t_size)
+{
+    countAllocation();
+    return __libc_malloc(t_size);
+}
+
+extern "C" void *calloc(std::size_t t_count, std::size_t t_size)
+{
+    countAllocation();
+    return __libc_calloc(t_count, t_size);
+}
+
+extern "C" void *realloc(void *t_pointer, std::size_t t_size)
+{
+    countAllocation();
+    return __libc_realloc(t_pointer, t_size);
+}
+
+extern "C" void *aligned_alloc(std::size_t t_alignment, std::size_t t_size)
+{
+    countAllocation();
+    return __libc_memalign(t_alignment, t_size);
+}
+
+extern "C" int posix_memalign(void **t_pointer, std::size_t t_alignment, std::size_t t_size)
+{
+    countAllocation();
+    *t_pointer = __libc_memalign(t_alignment, t_size);
+    return *t_pointer != nullptr or t_size == 0 ? 0 : ENOMEM;
+}
+
+
+
+//  Counts the allocations of the current thread while alive
+class AllocationCounter
+{
+public:
+
+    AllocationCounter() :
+        m_start(allocations.load(std::memory_order_relaxed))
+    {
+        count_allocations = true;
+    }
+
+    ~AllocationCounter()
+    {
+        count_allocations = false;
+    }
+
+    std::uint64_t count() const { return allocations.load(std::memory_order_relaxed) - m_start; }
+
+private:
+
+    std::uint64_t m_start;
+};
 
 
-    //Example code for Shape Sensing Interface
 
-    ShapeSensingInterface interface(SERVER_ADDRESS,PORT_NUMBER);
 
-    if(!interface.connect())
-        return 0;
+//  Frames generated once and sent in a loop, so that the server costs only the copies
+class CannedFrames : public FrameSource
+{
+public:
+
+    CannedFrames(FrameSource &t_source,
+                 const std::size_t t_num_frames,
+                 const double t_frequency) :
+        m_period(1/t_frequency)
+    {
+        std::vector<char> frame;
+        double time;
+        while(m_frames.size() < t_num_frames and t_source.nextFrame(frame, time))
+            m_frames.push_back(frame);
+    }
+
+    bool nextFrame(std::vector<char> &t_frame,
+                   double &t_time) override
+    {
+        t_frame = m_frames[m_next % m_frames.size()];
+        t_time = m_next*m_period;
+
+        m_next++;
+
+        return true;
+    }
+
+    const std::vector<std::vector<char>> &getFrames() const { return m_frames; }
+
+    //  Average size, with the 4 bytes length
+    double getFrameSize() const
+    {
+        double size = 0;
+        for(const std::vector<char> &frame : m_frames)
+            size += frame.size();
+
+        return size/m_frames.size();
+    }
+
+private:
+
+    std::vector<std::vector<char>> m_frames;
+    std::size_t m_next { 0 };
+    double m_period;
+};
+
+
+constexpr std::size_t num_canned_frames = 64;
+
+
+
+//  range(0): sensors, range(1): shape points per sensor (1 mm apart), range(2): rate (Hz) of the server
+std::shared_ptr<CannedFrames> shapeSensingFrames(const benchmark::State &t_state)
+{
+    ShapeSensingSimulator::Config config;
+    config.num_sensors = static_cast<int>(t_state.range(0));
+    config.num_shape_points = static_cast<int>(t_state.range(1));
+    config.num_gratings = 20;
 
+    ShapeSensingSimulator simulator(config);
 
-    ::benchmark::RegisterBenchmark("Reading data", [&](::benchmark::State &t_state){
+    return std::make_shared<CannedFrames>(simulator, num_canned_frames, t_state.range(2));
+}
+
+
+//  range(0): outer cores (plus the central one), range(1): gratings per core, range(2): rate (Hz) of the server
+std::shared_ptr<CannedFrames> illumiSenseFrames(const benchmark::State &t_state)
+{
+    IllumiSenseSimulator::Config config;
+    config.num_outer_cores = static_cast<int>(t_state.range(0));
+    config.num_gratings = static_cast<int>(t_state.range(1));
+
+    IllumiSenseSimulator simulator(config);
+
+    return std::make_shared<CannedFrames>(simulator, num_canned_frames, t_state.range(2));
+}
+
+
+
+
+template<typename Interface>
+void readNextSample(benchmark::State &t_state,
+                    std::shared_ptr<CannedFrames> t_frames)
+{
+    //  Paced, a flood of frames would only measure the socket buffers
+    FrameServer server(t_frames, "127.0.0.1", 0);
+    if(not server.start()){
+        t_state.SkipWithError("cannot start the frame server");
+        return;
+    }
+
+    Interface interface;
+    interface.setAddress("127.0.0.1", std::to_string(server.getPort()));
+    if(not interface.connect()){
+        t_state.SkipWithError("cannot connect to the frame server");
+        return;
+    }
+
+    typename Interface::Sample sample;
+
+    //  The buffers of the sample and of the interface are sized by the first frames
+    for(std::size_t i=0; i<num_canned_frames; i++){
+        while(not interface.nextSampleReady())
+            std::this_thread::yield();
+        interface.readNextSample(sample);
+    }
 
-        ShapeSensingInterface::Sample sample;
 
+    AllocationCounter counter;
 
+    for(auto _ : t_state){
         while(not interface.nextSampleReady())
-            std::this_thread::sleep_until([](){ using std::chrono::operator""ms;
-                return std::chrono::steady_clock::now() + 2000ms;
-            }());
-
-        if(interface.nextSampleReady()){
-            if(interface.readNextSample(sample)){
-                std::cout << "sample_number : " << sample.sample_number << "\n";
-            }
+            std::this_thread::yield();
+
+        const auto start = std::chrono::steady_clock::now();
+
+        const bool read = interface.readNextSample(sample);
+
+        t_state.SetIterationTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+        if(not read){
+            t_state.SkipWithError("the frame could not be read");
+            break;
         }
 
-        int numb = 0;
-        while(t_state.KeepRunning()){
-            if(interface.nextSampleReady()){
-                if(interface.readNextSample(sample)){
-                    numb = sample.num_channels;
-                }
-            }
+        benchmark::DoNotOptimize(sample);
+    }
+
+    t_state.counters["allocs/frame"] = benchmark::Counter(counter.count(), benchmark::Counter::kAvgIterations);
+    t_state.SetBytesProcessed(static_cast<std::int64_t>(t_state.iterations()*t_frames->getFrameSize()));
+
+    interface.getControl()->shutdown();
+    server.stop();
+}
+
+
+template<typename Interface>
+void parseFrame(benchmark::State &t_state,
+                std::shared_ptr<CannedFrames> t_frames)
+{
+    Interface interface;
+    typename Interface::Sample sample;
+
+    const std::vector<std::vector<char>> &frames = t_frames->getFrames();
+    std::size_t next = 0;
+
+    //  The buffers of the sample are sized by the first frame
+    interface.parseFrame(frames[0].data() + FRAME_HEADER_SIZE, frames[0].size() - FRAME_HEADER_SIZE, sample);
+
+    AllocationCounter counter;
+
+    for(auto _ : t_state){
+        const std::vector<char> &frame = frames[next];
+        next = (next + 1) % frames.size();
+
+        interface.parseFrame(frame.data() + FRAME_HEADER_SIZE, frame.size() - FRAME_HEADER_SIZE, sample);
+
+        benchmark::DoNotOptimize(sample);
+    }
+
+    t_state.counters["allocs/frame"] = benchmark::Counter(counter.count(), benchmark::Counter::kAvgIterations);
+    t_state.SetBytesProcessed(static_cast<std::int64_t>(t_state.iterations()*t_frames->getFrameSize()));
+}
+
+
+//  range(3): samples recorded, exported with getSamplesData(), then written as YAML and CSV in memory when t_write
+template<typename Interface>
+void exportSamples(benchmark::State &t_state,
+                   std::shared_ptr<CannedFrames> t_frames,
+                   const bool t_write)
+{
+    Interface interface;
+
+    const std::vector<std::vector<char>> &frames = t_frames->getFrames();
+    std::vector<typename Interface::Sample> samples(t_state.range(3));
+
+    for(std::size_t i=0; i<samples.size(); i++){
+        const std::vector<char> &frame = frames[i % frames.size()];
+        interface.parseFrame(frame.data() + FRAME_HEADER_SIZE, frame.size() - FRAME_HEADER_SIZE, samples[i]);
+        samples[i].time_stamp = std::chrono::high_resolution_clock::time_point(std::chrono::milliseconds(i));
+    }
+
+    interface.loadSamples(samples);
+
+
+    std::size_t bytes = 0;
+
+    AllocationCounter counter;
+
+    for(auto _ : t_state){
+        YAML::Node FBGS_node;
+        Eigen::MatrixXd FBGS_data;
+
+        interface.getSamplesData(FBGS_node, FBGS_data);
+
+        if(t_write){
+            std::ostringstream yaml_stream;
+            yaml_stream << FBGS_node;
+
+            std::ostringstream csv_stream;
+            csv_stream << FBGS_data.format(Eigen::IOFormat(16, 0, ","));
+
+            bytes = yaml_stream.str().size() + csv_stream.str().size();
         }
-    })->Repetitions(repetitions);
+        else
+            bytes = FBGS_data.size()*sizeof(double);
+
+        benchmark::DoNotOptimize(FBGS_data.data());
+    }
+
+    t_state.counters["allocs/export"] = benchmark::Counter(counter.count(), benchmark::Counter::kAvgIterations);
+    t_state.counters["time/sample"] = benchmark::Counter(t_state.range(3), benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+    t_state.SetBytesProcessed(static_cast<std::int64_t>(t_state.iterations()*bytes));
+}
+
+
+
+
+//  Topologies and rates: Shape Sensing {sensors, shape points, Hz}, IllumiSense {outer cores, gratings per core, Hz}
+void shapeSensingTopologies(benchmark::internal::Benchmark *t_benchmark)
+{
+    t_benchmark->Args({1, 100, 5000})->Args({2, 300, 1000})->Args({4, 1000, 200});
+}
+
+void illumiSenseTopologies(benchmark::internal::Benchmark *t_benchmark)
+{
+    t_benchmark->Args({3, 10, 10000})->Args({6, 20, 5000})->Args({6, 100, 1000});
+}
+
+void exportSizes(benchmark::internal::Benchmark *t_benchmark, const std::vector<std::int64_t> &t_topology)
+{
+    for(const std::int64_t num_samples : {100, 1000})
+        t_benchmark->Args({t_topology[0], t_topology[1], 100, num_samples});
+
+    t_benchmark->Unit(benchmark::kMillisecond);
+}
+
+
+
+
+int main(int argc, char *argv[])
+{
+    ::benchmark::Initialize(&argc, argv);
+
+
+    ::benchmark::RegisterBenchmark("ShapeSensing/ReadNextSample", [](benchmark::State &t_state){
+        readNextSample<ShapeSensingInterface>(t_state, shapeSensingFrames(t_state));
+    })->Apply(shapeSensingTopologies)->UseManualTime();
+
+    ::benchmark::RegisterBenchmark("ShapeSensing/ParseFrame", [](benchmark::State &t_state){
+        parseFrame<ShapeSensingInterface>(t_state, shapeSensingFrames(t_state));
+    })->Apply(shapeSensingTopologies);
+
+    ::benchmark::RegisterBenchmark("IllumiSense/ReadNextSample", [](benchmark::State &t_state){
+        readNextSample<IllumiSenseInterface>(t_state, illumiSenseFrames(t_state));
+    })->Apply(illumiSenseTopologies)->UseManualTime();
+
+    ::benchmark::RegisterBenchmark("IllumiSense/ParseFrame", [](benchmark::State &t_state){
+        parseFrame<IllumiSenseInterface>(t_state, illumiSenseFrames(t_state));
+    })->Apply(illumiSenseTopologies);
+
+
+    for(const bool write : {false, true}){
+        const std::string name = write ? "/ExportCsvYaml" : "/GetSamplesData";
+
+        ::benchmark::RegisterBenchmark(("ShapeSensing" + name).c_str(), [write](benchmark::State &t_state){
+            exportSamples<ShapeSensingInterface>(t_state, shapeSensingFrames(t_state), write);
+        })->Apply([](benchmark::internal::Benchmark *t_benchmark){ exportSizes(t_benchmark, {2, 300}); });
 
+        ::benchmark::RegisterBenchmark(("IllumiSense" + name).c_str(), [write](benchmark::State &t_state){
+            exportSamples<IllumiSenseInterface>(t_state, illumiSenseFrames(t_state), write);
+        })->Apply([](benchmark::internal::Benchmark *t_benchmark){ exportSizes(t_benchmark, {6, 20}); });
+    }
 
 
     ::benchmark::RunSpecifiedBenchmarks();
@@ -0,0 +1,455 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <map>
+#include <algorithm>
+#include <tuple>
+#include <cstdio>
+#include <utility>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+
+#include "fbgs-sensing/shape_sensing_interface.h"
+#include "fbgs-sensing/illumisense_interface.h"
+#include "fbgs-sensing/shape_sensing_simulator.h"
+#include "fbgs-sensing/illumisense_simulator.h"
+#include "fbgs-sensing/frame_server.h"
+
+
+
+// Scalability of the acquisition: a simulator is served on the loopback by an in-process FrameServer while the
+// frame rate and the frame size (sensors x shape points, or outer cores x gratings) are swept, for every ingest
+// mode and storage mode:
+//      none        the samples only reach the sample callback
+//      record      the samples are recorded (startRecording())
+//      raw         the frames are appended to a raw capture, not parsed (loops and async only)
+// Each run reports the rate achieved by the server and by the acquisition, the samples dropped (sequence gaps,
+// frames dropped by the raw capture) and left behind (sent, not yet acquired, at the end), the CPU used by the
+// process without the server thread (in cores) and the growth of the resident memory. A configuration is
+// sustained when the acquisition keeps up with the target rate; the table of the highest sustained rates ends
+// the report. "source" marks the runs where the simulator itself cannot generate the frames at the target rate
+// (measured alone before the runs of each topology).
+//      benchmark_stress --device shape --rates 100,1000,5000 --topologies 1x200,4x1000 --modes loop-block,async
+
+
+
+std::int64_t threadCpuTimeNs()
+{
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return static_cast<std::int64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+
+
+double processCpuTime()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + 1e-6*usage.ru_utime.tv_usec + usage.ru_stime.tv_sec + 1e-6*usage.ru_stime.tv_usec;
+}
+
+
+//  Resident memory, MB
+double residentMemory()
+{
+    std::ifstream statm("/proc/self/statm");
+    std::size_t size = 0, resident = 0;
+    statm >> size >> resident;
+
+    return 1e-6*resident*sysconf(_SC_PAGESIZE);
+}
+
+
+
+//  CPU time of the thread of the FrameServer, which runs the simulator, to leave it out of the acquisition
+class MeteredSource : public FrameSource
+{
+public:
+
+    explicit MeteredSource(std::shared_ptr<FrameSource> t_source) :
+        m_source(t_source)
+    {
+    }
+
+    bool nextFrame(std::vector<char> &t_frame,
+                   double &t_time) override
+    {
+        return m_source->nextFrame(t_frame, t_time);
+    }
+
+    void reset() override { m_source->reset(); }
+
+    void onSend(const std::vector<char> &) override
+    {
+        m_cpu_time_ns.store(threadCpuTimeNs(), std::memory_order_relaxed);
+    }
+
+    double getCpuTime() const { return 1e-9*m_cpu_time_ns.load(std::memory_order_relaxed); }
+
+private:
+
+    std::shared_ptr<FrameSource> m_source;
+    std::atomic<std::int64_t> m_cpu_time_ns { 0 };
+};
+
+
+
+
+//  Rate (Hz) at which the simulator generates its frames, the server cannot send faster
+double generationRate(FrameSource &t_simulator)
+{
+    std::vector<char> frame;
+    double time;
+    std::size_t frames = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    while(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(200) and t_simulator.nextFrame(frame, time))
+        frames++;
+
+    return frames/std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+
+
+struct Options
+{
+    std::string device { "shape" };
+    std::vector<double> rates { 100, 1000, 5000, 10000 };
+    std::vector<std::string> topologies;    //  default of the device
+    std::vector<std::string> modes { "loop-block", "loop-spin", "async", "coroutine" };
+    std::vector<std::string> storages { "none", "record", "raw" };
+    double duration { 1 };                  //  s, per run
+    int num_gratings { 20 };                //  per channel of the Shape Sensing
+};
+
+
+struct Result
+{
+    double frame_size { 0 };            //  bytes
+    double sent_rate { 0 };             //  Hz
+    double acquired_rate { 0 };         //  Hz
+    std::uint64_t dropped { 0 };
+    std::uint64_t behind { 0 };
+    double cpu { 0 };                   //  cores
+    double memory_growth { 0 };         //  MB/s
+
+    enum Verdict { SUSTAINED, OVERLOADED, SOURCE_LIMITED } verdict { OVERLOADED };
+};
+
+
+
+
+template<typename Interface>
+Result run(const std::string &t_mode,
+           const std::string &t_storage,
+           const double t_rate,
+           const double t_duration,
+           const double t_generation_rate,
+           std::shared_ptr<FrameSource> t_simulator)
+{
+    using Sample = typename Interface::Sample;
+
+    Result result;
+
+    auto source = std::make_shared<MeteredSource>(t_simulator);
+    auto control = std::make_shared<AcquisitionControl>();
+
+    FrameServer server(source, "127.0.0.1", 0);
+    if(not server.start())
+        return result;
+
+    auto io_context = std::make_shared<boost::asio::io_context>();
+
+    Interface interface(control, t_rate, io_context);
+    interface.setAddress("127.0.0.1", std::to_string(server.getPort()));
+
+    const std::string capture = "/tmp/fbgs_stress_" + std::to_string(getpid()) + ".raw";
+    if(t_storage == "raw")
+        interface.enableRawCapture(capture);
+
+    std::atomic<std::uint64_t> acquired { 0 };
+    interface.setSampleCallback([&](const Sample &){
+        acquired.fetch_add(1, std::memory_order_relaxed);
+    });
+
+    auto acquiredFrames = [&](){
+        return t_storage == "raw" ? interface.getRawCaptureStatistics().frames_written : acquired.load(std::memory_order_relaxed);
+    };
+
+    if(not interface.connect())
+        return result;
+
+
+    std::thread acquisition_thread;
+
+    if(t_mode.rfind("loop", 0) == 0){
+        WaitPolicy policy;
+        if(t_mode == "loop-spin")
+            policy.strategy = WaitPolicy::Strategy::SPIN;
+        else if(t_mode == "loop-hybrid")
+            policy.strategy = WaitPolicy::Strategy::SPIN_THEN_BLOCK;
+        interface.setWaitPolicy(policy);
+
+        interface.startRecordinLoop();
+    }
+    else if(t_mode == "async"){
+        interface.startAsyncAcquisition();
+        acquisition_thread = std::thread([&](){ io_context->run(); });
+    }
+    else if(t_mode == "coroutine"){
+        boost::asio::co_spawn(*io_context, [&]() -> boost::asio::awaitable<void> {
+            Sample sample;
+            while(true){
+                const bool received = co_await interface.next(sample);
+                if(not received)
+                    break;
+            }
+        }, boost::asio::detached);
+        acquisition_thread = std::thread([&](){ io_context->run(); });
+    }
+
+    //  Both the recorded samples and the raw capture need the recording
+    if(t_storage != "none")
+        interface.startRecording();
+
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    const SampleSequenceMonitor::Statistics sequence_start = interface.getSequenceStatistics();
+    const std::uint64_t sent_start = server.getNumberOfFramesSent();
+    const std::uint64_t bytes_start = server.getNumberOfBytesSent();
+    const std::uint64_t acquired_start = acquiredFrames();
+    const double cpu_start = processCpuTime() - source->getCpuTime();
+    const double memory_start = residentMemory();
+    const auto start = std::chrono::steady_clock::now();
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(t_duration));
+
+    const SampleSequenceMonitor::Statistics sequence_end = interface.getSequenceStatistics();
+    const std::uint64_t sent_end = server.getNumberOfFramesSent();
+    const std::uint64_t bytes_end = server.getNumberOfBytesSent();
+    const std::uint64_t acquired_end = acquiredFrames();
+    const double cpu_end = processCpuTime() - source->getCpuTime();
+    const double memory_end = residentMemory();
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+
+    control->shutdown();
+    io_context->stop();
+
+    interface.shutdown();
+    if(acquisition_thread.joinable())
+        acquisition_thread.join();
+
+    server.stop();
+
+    const RawCaptureWriter::Statistics raw_statistics = interface.getRawCaptureStatistics();
+    if(t_storage == "raw")
+        std::remove(capture.c_str());
+
+
+    const std::uint64_t sent = sent_end - sent_start;
+
+    result.frame_size = sent > 0 ? static_cast<double>(bytes_end - bytes_start)/sent : 0;
+    result.sent_rate = sent/elapsed;
+    result.acquired_rate = (acquired_end - acquired_start)/elapsed;
+    result.dropped = sequence_end.dropped - sequence_start.dropped + raw_statistics.frames_dropped;
+    //  Growth of the backlog, the frames dumped at the start of the loops are never acquired
+    const std::int64_t backlog_start = static_cast<std::int64_t>(sent_start) - static_cast<std::int64_t>(acquired_start);
+    const std::int64_t backlog_end = static_cast<std::int64_t>(sent_end) - static_cast<std::int64_t>(acquired_end);
+    result.behind = static_cast<std::uint64_t>(std::max<std::int64_t>(0, backlog_end - backlog_start));
+    result.cpu = (cpu_end - cpu_start)/elapsed;
+    result.memory_growth = (memory_end - memory_start)/elapsed;
+
+    //  The server is slowed down by the acquisition when it cannot keep up (full socket buffers), so only sending
+    //  at the target rate with a tenth of a second of backlog at most (the frames in flight) is sustained
+    if(t_generation_rate < t_rate)
+        result.verdict = Result::SOURCE_LIMITED;
+    else if(result.sent_rate >= 0.98*t_rate and result.dropped == 0 and result.behind <= 0.1*t_rate + 1)
+        result.verdict = Result::SUSTAINED;
+    else
+        result.verdict = Result::OVERLOADED;
+
+    return result;
+}
+
+
+
+
+std::vector<std::string> split(const std::string &t_list,
+                               const char t_separator=',')
+{
+    std::vector<std::string> items;
+    std::stringstream stream(t_list);
+    std::string item;
+    while(std::getline(stream, item, t_separator))
+        if(not item.empty())
+            items.push_back(item);
+
+    return items;
+}
+
+
+void printUsage()
+{
+    std::cout << "Usage: benchmark_stress [options]\n"
+                 "  --device <shape|illumisense>   interrogator to simulate (shape)\n"
+                 "  --rates <Hz,...>               sample rates (100,1000,5000,10000)\n"
+                 "  --topologies <AxB,...>         sensors x shape points for shape (1x200,2x500,4x1000),\n"
+                 "                                 outer cores x gratings for illumisense (3x10,6x50,6x200)\n"
+                 "  --gratings <n>                 gratings per channel of the Shape Sensing (20)\n"
+                 "  --modes <mode,...>             loop-block, loop-hybrid, loop-spin, async, coroutine\n"
+                 "                                 (loop-block,loop-spin,async,coroutine)\n"
+                 "  --storages <storage,...>       none, record, raw (all)\n"
+                 "  --duration <s>                 measurement per run (1)\n";
+}
+
+
+
+
+int main(int argc, char **argv)
+{
+    Options options;
+
+    for(int i=1; i<argc; i++){
+        const std::string option = argv[i];
+
+        if(option == "--help" or option == "-h"){
+            printUsage();
+            return 0;
+        }
+
+        if(i + 1 >= argc){
+            std::cerr << "missing value for " << option << std::endl;
+            printUsage();
+            return 1;
+        }
+
+        const std::string value = argv[++i];
+
+        if(option == "--device")                    options.device = value;
+        else if(option == "--rates"){
+            options.rates.clear();
+            for(const std::string &rate : split(value))
+                options.rates.push_back(std::stod(rate));
+        }
+        else if(option == "--topologies")           options.topologies = split(value);
+        else if(option == "--gratings")             options.num_gratings = std::stoi(value);
+        else if(option == "--modes")                options.modes = split(value);
+        else if(option == "--storages")             options.storages = split(value);
+        else if(option == "--duration")             options.duration = std::stod(value);
+        else {
+            std::cerr << "unknown option " << option << std::endl;
+            printUsage();
+            return 1;
+        }
+    }
+
+    const bool shape = options.device == "shape";
+    if(not shape and options.device != "illumisense"){
+        std::cerr << "unknown device " << options.device << std::endl;
+        return 1;
+    }
+
+    if(options.topologies.empty())
+        options.topologies = shape ? std::vector<std::string>{ "1x200", "2x500", "4x1000" }
+                                   : std::vector<std::string>{ "3x10", "6x50", "6x200" };
+
+
+    //  The interfaces print their progress on the standard output, the results go to its original buffer
+    std::ostream results(std::cout.rdbuf());
+    std::ostringstream discarded;
+    std::cout.rdbuf(discarded.rdbuf());
+
+    results << std::left << std::setw(10) << "topology" << std::setw(12) << "mode" << std::setw(8) << "storage" << std::right
+            << std::setw(8) << "rate" << std::setw(10) << "bytes" << std::setw(10) << "sent Hz" << std::setw(10) << "acq Hz"
+            << std::setw(9) << "dropped" << std::setw(8) << "behind" << std::setw(7) << "cpu" << std::setw(10) << "MB/s mem"
+            << "  verdict" << std::endl;
+
+    //  Highest sustained rate of every topology, mode and storage
+    std::map<std::tuple<std::string, std::string, std::string>, double> sustained;
+
+    for(const std::string &topology : options.topologies){
+        const std::vector<std::string> sizes = split(topology, 'x');
+        if(sizes.size() != 2){
+            std::cerr << "invalid topology " << topology << std::endl;
+            continue;
+        }
+
+        auto makeSimulator = [&](const double t_rate) -> std::shared_ptr<FrameSource> {
+            if(shape){
+                ShapeSensingSimulator::Config config;
+                config.frequency = t_rate;
+                config.num_sensors = std::stoi(sizes[0]);
+                config.num_shape_points = std::stoi(sizes[1]);
+                config.num_gratings = options.num_gratings;
+
+                return std::make_shared<ShapeSensingSimulator>(config);
+            }
+
+            IllumiSenseSimulator::Config config;
+            config.frequency = t_rate;
+            config.num_outer_cores = std::stoi(sizes[0]);
+            config.num_gratings = std::stoi(sizes[1]);
+
+            return std::make_shared<IllumiSenseSimulator>(config);
+        };
+
+        const double generation_rate = generationRate(*makeSimulator(options.rates.front()));
+        results << "# " << topology << ": the simulator generates up to " << std::fixed << std::setprecision(0)
+                << generation_rate << " frames/s" << std::endl;
+
+        for(const std::string &mode : options.modes)
+            for(const std::string &storage : options.storages){
+                //  next() parses the frames, there is no raw capture with the coroutines
+                if(storage == "raw" and mode == "coroutine")
+                    continue;
+
+                sustained[{topology, mode, storage}] = 0;
+
+                for(const double rate : options.rates){
+                    const Result result = shape ? run<ShapeSensingInterface>(mode, storage, rate, options.duration, generation_rate, makeSimulator(rate))
+                                                : run<IllumiSenseInterface>(mode, storage, rate, options.duration, generation_rate, makeSimulator(rate));
+
+                    discarded.str("");
+
+                    const char *verdicts[] = { "yes", "no", "source" };
+
+                    results << std::left << std::setw(10) << topology << std::setw(12) << mode << std::setw(8) << storage << std::right
+                            << std::fixed << std::setprecision(0) << std::setw(8) << rate << std::setw(10) << result.frame_size
+                            << std::setw(10) << result.sent_rate << std::setw(10) << result.acquired_rate
+                            << std::setw(9) << result.dropped << std::setw(8) << result.behind
+                            << std::setprecision(2) << std::setw(7) << result.cpu << std::setw(10) << result.memory_growth
+                            << "  " << verdicts[result.verdict] << std::endl;
+
+                    if(result.verdict == Result::SUSTAINED)
+                        sustained[{topology, mode, storage}] = std::max(sustained[{topology, mode, storage}], rate);
+                }
+            }
+    }
+
+
+    results << "\nHighest sustained rate (Hz, 0 for none of the rates tried)\n"
+            << std::left << std::setw(10) << "topology" << std::setw(12) << "mode" << std::setw(8) << "storage" << std::right
+            << std::setw(8) << "rate" << "\n";
+    for(const auto &[configuration, rate] : sustained)
+        results << std::left << std::setw(10) << std::get<0>(configuration) << std::setw(12) << std::get<1>(configuration)
+                << std::setw(8) << std::get<2>(configuration) << std::right << std::fixed << std::setprecision(0)
+                << std::setw(8) << rate << "\n";
+    results.flush();
+
+    std::cout.rdbuf(results.rdbuf());
+
+    return 0;
+}
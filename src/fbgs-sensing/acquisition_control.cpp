@@ -0,0 +1,144 @@
+/*
+This code implements the control of the acquisition threads of the interfaces
+*/
+
+#include "fbgs-sensing/acquisition_control.h"
+
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <cstdint>
+#include <cerrno>
+
+
+AcquisitionControl::AcquisitionControl()
+{
+    for(auto &listener : m_listeners)
+        listener.store(-1, std::memory_order_relaxed);
+}
+
+
+AcquisitionControl::~AcquisitionControl()
+{
+    for(auto &listener : m_listeners){
+        const int event_fd = listener.exchange(-1);
+        if(event_fd >= 0)
+            close(event_fd);
+    }
+}
+
+
+
+void AcquisitionControl::startRecording()
+{
+    //  Once shut down there is no way back
+    State expected = State::IDLE;
+    if(m_state.compare_exchange_strong(expected, State::RECORDING, std::memory_order_acq_rel))
+        notifyListeners();
+}
+
+
+void AcquisitionControl::stopRecording()
+{
+    State expected = State::RECORDING;
+    if(m_state.compare_exchange_strong(expected, State::IDLE, std::memory_order_acq_rel))
+        notifyListeners();
+}
+
+
+void AcquisitionControl::shutdown()
+{
+    m_state.store(State::SHUTDOWN, std::memory_order_release);
+
+    notifyListeners();
+}
+
+
+void AcquisitionControl::notifyListeners()
+{
+    const std::uint64_t event = 1;
+    for(auto &listener : m_listeners){
+        const int event_fd = listener.load(std::memory_order_acquire);
+        if(event_fd >= 0){
+            [[maybe_unused]] ssize_t written = write(event_fd, &event, sizeof(event));
+        }
+    }
+}
+
+
+
+
+int AcquisitionControl::addListener()
+{
+    const int event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(event_fd < 0)
+        return -1;
+
+    for(auto &listener : m_listeners){
+        int expected = -1;
+        if(listener.compare_exchange_strong(expected, event_fd))
+            return event_fd;
+    }
+
+    close(event_fd);
+    return -1;
+}
+
+
+void AcquisitionControl::removeListener(const int t_event_fd)
+{
+    if(t_event_fd < 0)
+        return;
+
+    for(auto &listener : m_listeners){
+        int expected = t_event_fd;
+        if(listener.compare_exchange_strong(expected, -1)){
+            close(t_event_fd);
+            return;
+        }
+    }
+}
+
+
+void AcquisitionControl::clearEvents(const int t_event_fd)
+{
+    std::uint64_t events;
+    [[maybe_unused]] ssize_t size_read = read(t_event_fd, &events, sizeof(events));
+}
+
+
+
+
+bool AcquisitionControl::waitReadable(const int t_fd,
+                                      const int t_event_fd,
+                                      const int t_timeout_ms)
+{
+    pollfd fds[2];
+    fds[0] = { t_fd, POLLIN, 0 };
+    fds[1] = { t_event_fd, POLLIN, 0 };
+
+    const nfds_t count = t_event_fd >= 0 ? 2 : 1;
+
+    int ready;
+    do {
+        ready = poll(fds, count, t_timeout_ms);
+    } while(ready < 0 and errno == EINTR);
+
+    if(ready <= 0)
+        return false;
+
+    if(count == 2 and (fds[1].revents & POLLIN))
+        clearEvents(t_event_fd);
+
+    //  Errors and hang up are reported as readable, the following read will fail and tell why
+    return fds[0].revents & (POLLIN | POLLERR | POLLHUP);
+}
+
+
+bool AcquisitionControl::setReadableThreshold(const int t_fd,
+                                              const int t_bytes)
+{
+    return setsockopt(t_fd, SOL_SOCKET, SO_RCVLOWAT, &t_bytes, sizeof(t_bytes)) == 0;
+}
@@ -0,0 +1,94 @@
+/*
+This code implements the acquisition of several FBGS devices from a single thread
+*/
+
+#include "fbgs-sensing/acquisition_manager.h"
+
+
+AcquisitionManager::AcquisitionManager(const unsigned int t_number_of_threads,
+                                       std::shared_ptr<AcquisitionControl> t_control) :
+    m_number_of_threads(std::max(t_number_of_threads, 1u)),
+    m_control( t_control ? t_control : std::make_shared<AcquisitionControl>() ),
+    m_io_context( std::make_shared<boost::asio::io_context>(static_cast<int>(m_number_of_threads)) )
+{
+}
+
+
+AcquisitionManager::~AcquisitionManager()
+{
+    stop();
+}
+
+
+
+std::shared_ptr<ShapeSensingInterface> AcquisitionManager::addShapeSensing(const std::string &t_ip_address,
+                                                                           const std::string &t_port_number,
+                                                                           const double t_frequency)
+{
+    auto interface = std::make_shared<ShapeSensingInterface>(m_control, t_frequency, m_io_context);
+    interface->setAddress(t_ip_address, t_port_number);
+
+    m_devices.push_back({ [interface](){ return interface->connect(); },
+                          [interface](){ interface->startAsyncAcquisition(); } });
+    m_interfaces.push_back(interface);
+
+    return interface;
+}
+
+
+std::shared_ptr<IllumiSenseInterface> AcquisitionManager::addIllumiSense(const std::string &t_ip_address,
+                                                                         const std::string &t_port_number,
+                                                                         const double t_frequency)
+{
+    auto interface = std::make_shared<IllumiSenseInterface>(m_control, t_frequency, m_io_context);
+    interface->setAddress(t_ip_address, t_port_number);
+
+    m_devices.push_back({ [interface](){ return interface->connect(); },
+                          [interface](){ interface->startAsyncAcquisition(); } });
+    m_interfaces.push_back(interface);
+
+    return interface;
+}
+
+
+
+
+bool AcquisitionManager::connect()
+{
+    bool all_connected = true;
+
+    for(auto &device : m_devices)
+        all_connected = device.connect() and all_connected;
+
+    return all_connected;
+}
+
+
+void AcquisitionManager::start()
+{
+    if(not m_threads.empty())
+        return;
+
+    m_io_context->restart();
+    m_work_guard = std::make_unique<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>>(m_io_context->get_executor());
+
+    for(auto &device : m_devices)
+        device.start();
+
+    for(unsigned int i=0; i<m_number_of_threads; i++)
+        m_threads.emplace_back([this](){ m_io_context->run(); });
+}
+
+
+void AcquisitionManager::stop()
+{
+    m_control->shutdown();
+
+    m_work_guard.reset();
+    m_io_context->stop();
+
+    for(auto &thread : m_threads)
+        thread.join();
+
+    m_threads.clear();
+}
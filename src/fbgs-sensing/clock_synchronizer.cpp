@@ -0,0 +1,222 @@
+/*
+This code implements the synchronisation of the interrogator clock with the host clock
+*/
+
+#include "fbgs-sensing/clock_synchronizer.h"
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+
+namespace
+{
+
+//  Samples needed before rejecting outliers
+constexpr unsigned int WARM_UP_UPDATES { 20 };
+
+//  Outliers in a row after which the regression restarts
+constexpr unsigned int MAX_CONSECUTIVE_OUTLIERS { 100 };
+
+//  Late samples in a row after which the interrogator is considered restarted, a reordered sample is isolated
+constexpr unsigned int MAX_CONSECUTIVE_LATE { 3 };
+
+//  Lower bound of the jitter used to detect outliers, a perfectly regular stream rejects nothing [s]
+constexpr double MIN_JITTER { 100e-6 };
+
+}
+
+
+
+
+ClockSynchronizer::ClockSynchronizer(const double t_forgetting_factor,
+                                     const double t_nominal_frequency,
+                                     const double t_outlier_threshold) :
+    m_forgetting_factor(std::clamp(t_forgetting_factor, 0.5, 1.0)),
+    m_nominal_period(t_nominal_frequency > 0 ? 1.0/t_nominal_frequency : 0),
+    m_outlier_threshold(t_outlier_threshold)
+{
+}
+
+
+void ClockSynchronizer::reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_number_of_updates = 0;
+    m_consecutive_outliers = 0;
+    m_consecutive_late = 0;
+}
+
+
+
+ClockSynchronizer::TimePoint ClockSynchronizer::update(const std::int64_t t_sample_number,
+                                                       const TimePoint &t_arrival_time)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(m_number_of_updates == 0){
+        restart(t_sample_number, t_arrival_time);
+        return t_arrival_time;
+    }
+
+    //  Interrogator restarted: far backward, beyond the window of the regression, or backward several times
+    //  in a row. An isolated late sample (reordered on the way) is only left out of the regression
+    if(t_sample_number < m_last_sample_number){
+        const double window = m_forgetting_factor < 1 ? 1/(1 - m_forgetting_factor) : std::numeric_limits<double>::max();
+
+        if(static_cast<double>(m_last_sample_number - t_sample_number) > window or ++m_consecutive_late >= MAX_CONSECUTIVE_LATE){
+            m_number_of_resets++;
+            restart(t_sample_number, t_arrival_time);
+            return t_arrival_time;
+        }
+
+        return m_number_of_updates >= 2 ? evaluate(t_sample_number) : t_arrival_time;
+    }
+    m_consecutive_late = 0;
+
+    //  Duplicate, it carries no new information
+    if(t_sample_number == m_last_sample_number)
+        return m_number_of_updates >= 2 ? evaluate(t_sample_number) : t_arrival_time;
+
+    m_last_sample_number = t_sample_number;
+
+
+    const double x = static_cast<double>(t_sample_number - m_origin_sample_number);
+    const double y = std::chrono::duration<double>(t_arrival_time - m_origin_time).count();
+
+
+    if(m_number_of_updates >= WARM_UP_UPDATES){
+        const double residual = y - (m_mean_y + m_period*(x - m_mean_x));
+        const double jitter = std::max(std::sqrt(m_residual_variance), MIN_JITTER);
+
+        if(std::abs(residual) > m_outlier_threshold*jitter){
+            if(++m_consecutive_outliers > MAX_CONSECUTIVE_OUTLIERS){
+                m_number_of_resets++;
+                restart(t_sample_number, t_arrival_time);
+                return t_arrival_time;
+            }
+
+            return evaluate(t_sample_number);
+        }
+    }
+    m_consecutive_outliers = 0;
+
+
+    //  Exponentially weighted means and covariances, updated incrementally
+    m_weight = m_forgetting_factor*m_weight + 1;
+    const double alpha = 1.0/m_weight;
+
+    const double dx = x - m_mean_x;
+    const double dy = y - m_mean_y;
+
+    m_mean_x += alpha*dx;
+    m_mean_y += alpha*dy;
+
+    m_covariance_xx = (1 - alpha)*(m_covariance_xx + alpha*dx*dx);
+    m_covariance_xy = (1 - alpha)*(m_covariance_xy + alpha*dx*dy);
+
+    if(m_covariance_xx > 0)
+        m_period = m_covariance_xy/m_covariance_xx;
+
+    const double residual = y - (m_mean_y + m_period*(x - m_mean_x));
+    m_residual_variance = (1 - alpha)*m_residual_variance + alpha*residual*residual;
+
+    m_number_of_updates++;
+
+    return evaluate(t_sample_number);
+}
+
+
+ClockSynchronizer::TimePoint ClockSynchronizer::synchronise(const std::int64_t t_sample_number) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return evaluate(t_sample_number);
+}
+
+
+
+
+bool ClockSynchronizer::isInitialised() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_number_of_updates >= 2;
+}
+
+
+ClockSynchronizer::TimePoint ClockSynchronizer::getOffset() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return evaluate(0);
+}
+
+
+double ClockSynchronizer::getPeriod() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_period;
+}
+
+
+double ClockSynchronizer::getDriftPpm() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(m_nominal_period <= 0 or m_number_of_updates < 2)
+        return 0;
+
+    return (m_period/m_nominal_period - 1)*1e6;
+}
+
+
+double ClockSynchronizer::getJitter() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return std::sqrt(m_residual_variance);
+}
+
+
+unsigned int ClockSynchronizer::getNumberOfResets() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_number_of_resets;
+}
+
+
+
+
+ClockSynchronizer::TimePoint ClockSynchronizer::evaluate(const std::int64_t t_sample_number) const
+{
+    const double x = static_cast<double>(t_sample_number - m_origin_sample_number);
+    const double y = m_mean_y + m_period*(x - m_mean_x);
+
+    return m_origin_time + std::chrono::duration_cast<TimePoint::duration>(std::chrono::duration<double>(y));
+}
+
+
+void ClockSynchronizer::restart(const std::int64_t t_sample_number,
+                                const TimePoint &t_arrival_time)
+{
+    m_origin_sample_number = t_sample_number;
+    m_origin_time = t_arrival_time;
+
+    m_weight = 1;
+    m_mean_x = 0;
+    m_mean_y = 0;
+    m_covariance_xx = 0;
+    m_covariance_xy = 0;
+    m_residual_variance = 0;
+
+    m_period = m_nominal_period;
+
+    m_last_sample_number = t_sample_number;
+    m_number_of_updates = 1;
+    m_consecutive_outliers = 0;
+    m_consecutive_late = 0;
+}
@@ -0,0 +1,328 @@
+/*
+This code implements the supervision of the connection to the interrogator
+*/
+
+#include "fbgs-sensing/connection_supervisor.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <cerrno>
+#include <climits>
+#include <algorithm>
+#include <iostream>
+
+
+using namespace std::chrono;
+using boost::asio::ip::tcp;
+
+
+namespace
+{
+
+//  Milliseconds left before t_deadline, for poll()
+int remainingMs(const steady_clock::time_point &t_deadline)
+{
+    return static_cast<int>(std::max<milliseconds::rep>(0, duration_cast<milliseconds>(t_deadline - steady_clock::now()).count()));
+}
+
+}
+
+
+
+
+ConnectionSupervisor::ConnectionSupervisor(std::shared_ptr<AcquisitionControl> t_control) :
+    m_control(t_control)
+{
+    m_control_event_fd = m_control->addListener();
+}
+
+
+ConnectionSupervisor::~ConnectionSupervisor()
+{
+    m_control->removeListener(m_control_event_fd);
+}
+
+
+
+
+bool ConnectionSupervisor::connect(tcp::socket &t_socket,
+                                   const std::string &t_ip_address,
+                                   const std::string &t_port_number)
+{
+    boost::system::error_code error;
+
+    tcp::resolver resolver(t_socket.get_executor());
+    const tcp::resolver::results_type endpoints = resolver.resolve(t_ip_address, t_port_number, error);
+    if(error){
+        std::cerr << "[FBGS] " << t_ip_address << ":" << t_port_number << " : " << error.message() << std::endl;
+        return false;
+    }
+
+
+    for(const auto &entry : endpoints){
+        t_socket.close(error);
+        t_socket.open(entry.endpoint().protocol(), error);
+        if(error)
+            continue;
+
+        //  boost::asio::connect() would block without timeout, the socket is connected by hand
+        t_socket.non_blocking(true, error);
+
+        const int fd = t_socket.native_handle();
+        int result = ::connect(fd, entry.endpoint().data(), static_cast<socklen_t>(entry.endpoint().size()));
+        int connect_error = result == 0 ? 0 : errno;
+
+        if(connect_error == EINPROGRESS){
+            const steady_clock::time_point deadline = steady_clock::now() + m_policy.connect_timeout;
+
+            bool writable = false;
+            while(not writable and not m_control->isShutdown() and steady_clock::now() < deadline){
+                pollfd fds[2];
+                fds[0] = { fd, POLLOUT, 0 };
+                fds[1] = { m_control_event_fd, POLLIN, 0 };
+
+                if(poll(fds, 2, remainingMs(deadline)) < 0 and errno != EINTR)
+                    break;
+
+                if(fds[1].revents & POLLIN)
+                    AcquisitionControl::clearEvents(m_control_event_fd);
+
+                writable = fds[0].revents & (POLLOUT | POLLERR | POLLHUP);
+            }
+
+            connect_error = ETIMEDOUT;
+            if(writable){
+                socklen_t length = sizeof(connect_error);
+                if(getsockopt(fd, SOL_SOCKET, SO_ERROR, &connect_error, &length) != 0)
+                    connect_error = errno;
+            }
+        }
+
+        if(connect_error == 0){
+            t_socket.non_blocking(false, error);
+            configureSocket(t_socket);
+            return true;
+        }
+    }
+
+    t_socket.close(error);
+
+    return false;
+}
+
+
+
+bool ConnectionSupervisor::reconnect(tcp::socket &t_socket,
+                                     const std::string &t_ip_address,
+                                     const std::string &t_port_number)
+{
+    boost::system::error_code error;
+    t_socket.close(error);
+
+    milliseconds backoff = m_policy.initial_backoff;
+    unsigned int attempts = 0;
+
+    while(sleepFor(backoff)){
+        attempts++;
+        std::cerr << "[FBGS] reconnecting to " << t_ip_address << ":" << t_port_number
+                  << " (attempt " << attempts << ")" << std::endl;
+
+        if(connect(t_socket, t_ip_address, t_port_number)){
+            m_reconnections.fetch_add(1, std::memory_order_relaxed);
+            std::cerr << "[FBGS] reconnected" << std::endl;
+            return true;
+        }
+
+        if(m_policy.max_attempts > 0 and attempts >= m_policy.max_attempts)
+            break;
+
+        backoff = nextBackoff(backoff);
+    }
+
+    return false;
+}
+
+
+
+void ConnectionSupervisor::asyncReconnect(tcp::socket &t_socket,
+                                          const std::string &t_ip_address,
+                                          const std::string &t_port_number,
+                                          std::function<void(bool)> t_handler)
+{
+    boost::system::error_code error;
+    t_socket.close(error);
+
+    if(not m_timer)
+        m_timer = std::make_unique<boost::asio::steady_timer>(t_socket.get_executor());
+
+    if(m_attempts == 0)
+        m_backoff = m_policy.initial_backoff;
+
+
+    auto retry = [this, &t_socket, t_ip_address, t_port_number, t_handler](){
+        if(m_policy.max_attempts > 0 and m_attempts >= m_policy.max_attempts){
+            m_attempts = 0;
+            t_handler(false);
+            return;
+        }
+
+        m_backoff = nextBackoff(m_backoff);
+        asyncReconnect(t_socket, t_ip_address, t_port_number, t_handler);
+    };
+
+
+    m_timer->expires_after(m_backoff);
+    m_timer->async_wait([this, &t_socket, t_ip_address, t_port_number, t_handler, retry](const boost::system::error_code &error){
+        if(error or m_control->isShutdown()){
+            m_attempts = 0;
+            t_handler(false);
+            return;
+        }
+
+        m_attempts++;
+        std::cerr << "[FBGS] reconnecting to " << t_ip_address << ":" << t_port_number
+                  << " (attempt " << m_attempts << ")" << std::endl;
+
+        boost::system::error_code resolve_error;
+        tcp::resolver resolver(t_socket.get_executor());
+        const tcp::resolver::results_type endpoints = resolver.resolve(t_ip_address, t_port_number, resolve_error);
+        if(resolve_error){
+            retry();
+            return;
+        }
+
+        //  Closing the socket at the timeout aborts the connection
+        auto done = std::make_shared<bool>(false);
+        m_timer->expires_after(m_policy.connect_timeout);
+        m_timer->async_wait([&t_socket, done](const boost::system::error_code &error){
+            boost::system::error_code close_error;
+            if(not error and not *done)
+                t_socket.close(close_error);
+        });
+
+        boost::asio::async_connect(t_socket, endpoints,
+                                   [this, &t_socket, t_handler, retry, done](const boost::system::error_code &error, const tcp::endpoint&){
+            *done = true;
+            m_timer->cancel();
+
+            if(error){
+                retry();
+                return;
+            }
+
+            configureSocket(t_socket);
+
+            m_attempts = 0;
+            m_reconnections.fetch_add(1, std::memory_order_relaxed);
+            std::cerr << "[FBGS] reconnected" << std::endl;
+
+            t_handler(true);
+        });
+    });
+}
+
+
+
+
+bool ConnectionSupervisor::waitForBytes(tcp::socket &t_socket,
+                                        const std::size_t t_size)
+{
+    boost::system::error_code error;
+    if(t_socket.available(error) >= t_size)
+        return true;
+    if(error)
+        return false;
+
+    //  Readable once the whole frame is queued rather than at every segment, the threshold set for the
+    //  headers (see SocketWaiter::configureSocket) is restored afterwards
+    const int fd = t_socket.native_handle();
+    int threshold = 1;
+    socklen_t length = sizeof(threshold);
+    getsockopt(fd, SOL_SOCKET, SO_RCVLOWAT, &threshold, &length);
+    AcquisitionControl::setReadableThreshold(fd, static_cast<int>(std::min<std::size_t>(t_size, INT_MAX)));
+
+    const steady_clock::time_point deadline = steady_clock::now() + m_policy.stall_timeout;
+    bool received = false;
+
+    while(not received){
+        if(m_control->isShutdown())
+            break;
+
+        if(steady_clock::now() >= deadline){
+            std::cerr << "[FBGS] no data for " << m_policy.stall_timeout.count() << " ms, the connection is lost" << std::endl;
+            break;
+        }
+
+        pollfd fds[2];
+        fds[0] = { fd, POLLIN | POLLRDHUP, 0 };
+        fds[1] = { m_control_event_fd, POLLIN, 0 };
+
+        if(poll(fds, 2, remainingMs(deadline)) < 0 and errno != EINTR)
+            break;
+
+        if(fds[1].revents & POLLIN)
+            AcquisitionControl::clearEvents(m_control_event_fd);
+
+        if(fds[0].revents == 0)
+            continue;
+
+        received = t_socket.available(error) >= t_size;
+        if(error)
+            break;
+
+        //  The peer closed its side (or the connection failed) before the end of the frame
+        if(not received and fds[0].revents & (POLLRDHUP | POLLERR | POLLHUP))
+            break;
+    }
+
+    AcquisitionControl::setReadableThreshold(fd, threshold);
+
+    return received;
+}
+
+
+
+
+void ConnectionSupervisor::configureSocket(tcp::socket &t_socket) const
+{
+    //  Probes a silent peer after the stall timeout, so that even a blocked read fails eventually
+    const int fd = t_socket.native_handle();
+    const int enable = 1;
+    const int idle = std::max<int>(1, static_cast<int>(duration_cast<seconds>(m_policy.stall_timeout).count()));
+    const int interval = 1;
+    const int count = 3;
+
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &enable, sizeof(enable));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count));
+}
+
+
+bool ConnectionSupervisor::sleepFor(const milliseconds t_duration) const
+{
+    const steady_clock::time_point deadline = steady_clock::now() + t_duration;
+
+    while(not m_control->isShutdown()){
+        const int remaining = remainingMs(deadline);
+        if(remaining <= 0)
+            return true;
+
+        pollfd fds[1];
+        fds[0] = { m_control_event_fd, POLLIN, 0 };
+
+        if(poll(fds, 1, remaining) > 0 and (fds[0].revents & POLLIN))
+            AcquisitionControl::clearEvents(m_control_event_fd);
+    }
+
+    return false;
+}
+
+
+milliseconds ConnectionSupervisor::nextBackoff(const milliseconds t_backoff) const
+{
+    return std::min(2*t_backoff, m_policy.max_backoff);
+}
@@ -0,0 +1,127 @@
+/*
+This code implements a synthetic motion of a multi-core fiber, used to simulate the interrogators
+*/
+
+#include "fbgs-sensing/fiber_motion.h"
+
+#include <cmath>
+#include <algorithm>
+
+
+double FiberMotion::curvature(const double t_s,
+                              const double t_time) const
+{
+    return m_parameters.curvature_amplitude*std::sin(2*M_PI*m_parameters.bending_frequency*t_time)*taper(t_s);
+}
+
+
+double FiberMotion::angle(const double,
+                          const double t_time) const
+{
+    return 2*M_PI*m_parameters.rotation_frequency*t_time;
+}
+
+
+double FiberMotion::twist(const double t_time) const
+{
+    return m_parameters.twist_amplitude*std::sin(2*M_PI*m_parameters.twist_frequency*t_time);
+}
+
+
+
+double FiberMotion::elongation(const double t_time) const
+{
+    return m_parameters.elongation_amplitude*std::sin(2*M_PI*m_parameters.elongation_frequency*t_time);
+}
+
+
+double FiberMotion::coreAngle(const double t_s,
+                              const double t_core_angle) const
+{
+    return t_core_angle + m_parameters.spin_rate*t_s;
+}
+
+
+
+double FiberMotion::bendingStrain(const double t_s,
+                                  const double t_time,
+                                  const double t_core_angle,
+                                  const double t_core_distance) const
+{
+    return -curvature(t_s, t_time)*t_core_distance*std::cos(angle(t_s, t_time) - coreAngle(t_s, t_core_angle));
+}
+
+
+double FiberMotion::coreStrain(const double t_s,
+                               const double t_time,
+                               const double t_core_angle,
+                               const double t_core_distance) const
+{
+    return elongation(t_time)
+           + bendingStrain(t_s, t_time, t_core_angle, t_core_distance)
+           + t_core_distance*t_core_distance*m_parameters.spin_rate*twist(t_time);
+}
+
+
+
+void FiberMotion::shape(const double t_time,
+                        const int t_num_points,
+                        const double t_spacing,
+                        Eigen::MatrixXd &t_shape) const
+{
+    t_shape.resize(t_num_points, 3);
+    if(t_num_points == 0)
+        return;
+
+    Eigen::Matrix3d rotation = Eigen::Matrix3d::Identity();
+    Eigen::Vector3d position = Eigen::Vector3d::Zero();
+    t_shape.row(0) = position.transpose();
+
+    const double base_curvature = curvature(0, t_time);
+    const double twist_rate = twist(t_time);
+
+    //  Frame of the cross section transported along the fiber, the curvature vector bends it towards the angle.
+    //  Exact rotation for a constant rate over every interval, midpoint rule for the position
+    for(int i=1; i<t_num_points; i++){
+        const double s = (i - 0.5)*t_spacing;
+        const double kappa = base_curvature*taper(s);
+        const double phi = angle(s, t_time);
+
+        Eigen::Vector3d axis(-kappa*std::sin(phi), kappa*std::cos(phi), twist_rate);
+        const double rate = axis.norm();
+        if(rate == 0){
+            position += t_spacing*rotation.col(2);
+            t_shape.row(i) = position.transpose();
+            continue;
+        }
+        axis /= rate;
+
+        //  Rodrigues formula, the full step is derived from the half step
+        const double half_cos = std::cos(0.5*rate*t_spacing);
+        const double half_sin = std::sin(0.5*rate*t_spacing);
+        const double cos = half_cos*half_cos - half_sin*half_sin;
+        const double sin = 2*half_sin*half_cos;
+
+        const Eigen::Vector3d half_tangent = half_cos*Eigen::Vector3d::UnitZ()
+                                             + half_sin*Eigen::Vector3d(axis.y(), -axis.x(), 0)
+                                             + (1 - half_cos)*axis.z()*axis;
+
+        Eigen::Matrix3d cross;
+        cross <<        0, -axis.z(),  axis.y(),
+                 axis.z(),         0, -axis.x(),
+                -axis.y(),  axis.x(),         0;
+
+        const Eigen::Matrix3d step = cos*Eigen::Matrix3d::Identity() + sin*cross + (1 - cos)*axis*axis.transpose();
+
+        position += t_spacing*rotation*half_tangent;
+        rotation = rotation*step;
+
+        t_shape.row(i) = position.transpose();
+    }
+}
+
+
+double FiberMotion::taper(const double t_s) const
+{
+    return 1 - 0.5*std::clamp(t_s/m_parameters.length, 0.0, 1.0);
+}
@@ -0,0 +1,252 @@
+/*
+This code implements a TCP server streaming frames of the FBGS protocol, used to stand in for the interrogator
+*/
+
+#include "fbgs-sensing/frame_server.h"
+
+#include <sys/socket.h>
+#include <sys/prctl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <cerrno>
+#include <cmath>
+#include <iostream>
+
+
+namespace
+{
+
+std::int64_t monotonicTimeNs()
+{
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return static_cast<std::int64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+
+}
+
+
+
+
+FrameServer::FrameServer(std::shared_ptr<FrameSource> t_source,
+                         const std::string &t_address,
+                         const unsigned short t_port,
+                         std::shared_ptr<AcquisitionControl> t_control) :
+    m_source(t_source),
+    m_address(t_address),
+    m_port(t_port),
+    m_control( t_control ? t_control : std::make_shared<AcquisitionControl>() )
+{
+    m_control_event_fd = m_control->addListener();
+}
+
+
+FrameServer::~FrameServer()
+{
+    stop();
+
+    m_control->removeListener(m_control_event_fd);
+}
+
+
+
+
+bool FrameServer::start()
+{
+    if(m_thread.joinable())
+        return false;
+
+    m_listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(m_listen_fd < 0)
+        return false;
+
+    const int enable = 1;
+    setsockopt(m_listen_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(m_port);
+
+    if(inet_pton(AF_INET, m_address.c_str(), &address.sin_addr) != 1
+       or bind(m_listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+       or listen(m_listen_fd, 1) != 0){
+        std::cerr << "[FBGS] cannot serve on " << m_address << ":" << m_port << std::endl;
+        close(m_listen_fd);
+        m_listen_fd = -1;
+        return false;
+    }
+
+    socklen_t length = sizeof(address);
+    getsockname(m_listen_fd, reinterpret_cast<sockaddr*>(&address), &length);
+    m_port = ntohs(address.sin_port);
+
+
+    m_running.store(true, std::memory_order_release);
+    m_thread = std::thread([this](){ serve(); });
+
+    return true;
+}
+
+
+void FrameServer::stop()
+{
+    if(m_thread.joinable()){
+        m_control->shutdown();
+        m_thread.join();
+    }
+}
+
+
+void FrameServer::wait()
+{
+    if(m_thread.joinable())
+        m_thread.join();
+}
+
+
+
+
+void FrameServer::serve()
+{
+    //  The default timer slack (50 us) would be a large part of the period at 10 kHz
+    prctl(PR_SET_TIMERSLACK, 1);
+
+    while(not m_control->isShutdown()){
+        pollfd fds[2];
+        fds[0] = { m_listen_fd, POLLIN, 0 };
+        fds[1] = { m_control_event_fd, POLLIN, 0 };
+
+        if(poll(fds, 2, -1) < 0 and errno != EINTR)
+            break;
+
+        if(fds[1].revents & POLLIN)
+            AcquisitionControl::clearEvents(m_control_event_fd);
+
+        if(not (fds[0].revents & POLLIN))
+            continue;
+
+        const int client_fd = accept4(m_listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(client_fd < 0)
+            continue;
+
+        const int enable = 1;
+        setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+        m_clients.fetch_add(1, std::memory_order_relaxed);
+        m_source->reset();
+
+        const bool connected = stream(client_fd);
+        close(client_fd);
+
+        //  End of the source
+        if(connected)
+            break;
+    }
+
+    close(m_listen_fd);
+    m_listen_fd = -1;
+
+    m_running.store(false, std::memory_order_release);
+}
+
+
+
+bool FrameServer::stream(const int t_client_fd)
+{
+    std::vector<char> frame;
+    double time = 0;
+
+    //  The schedule starts with the first frame sent to the client
+    std::int64_t origin_ns = 0;
+    double origin_time = 0;
+    bool first = true;
+
+    while(not m_control->isShutdown()){
+        if(not m_source->nextFrame(frame, time))
+            return true;
+
+        if(first){
+            origin_ns = monotonicTimeNs();
+            origin_time = time;
+            first = false;
+        }
+
+        if(m_speed > 0){
+            const std::int64_t deadline_ns = origin_ns + std::llround(1e9*(time - origin_time)/m_speed);
+            if(not sleepUntil(deadline_ns))
+                return false;
+        }
+
+        m_source->onSend(frame);
+
+        if(not sendAll(t_client_fd, frame.data(), frame.size()))
+            return false;
+
+        m_frames_sent.fetch_add(1, std::memory_order_relaxed);
+        m_bytes_sent.fetch_add(frame.size(), std::memory_order_relaxed);
+    }
+
+    return false;
+}
+
+
+
+bool FrameServer::sendAll(const int t_client_fd,
+                          const char *t_data,
+                          std::size_t t_size)
+{
+    while(t_size > 0){
+        const ssize_t sent = send(t_client_fd, t_data, t_size, MSG_NOSIGNAL);
+
+        if(sent > 0){
+            t_data += sent;
+            t_size -= static_cast<std::size_t>(sent);
+            continue;
+        }
+
+        if(sent < 0 and errno != EAGAIN and errno != EWOULDBLOCK and errno != EINTR)
+            return false;
+
+        //  The client does not keep up, its receive buffer is full
+        pollfd fds[2];
+        fds[0] = { t_client_fd, POLLOUT, 0 };
+        fds[1] = { m_control_event_fd, POLLIN, 0 };
+
+        if(poll(fds, 2, -1) < 0 and errno != EINTR)
+            return false;
+
+        if(fds[1].revents & POLLIN)
+            AcquisitionControl::clearEvents(m_control_event_fd);
+
+        if(m_control->isShutdown() or (fds[0].revents & (POLLERR | POLLHUP)))
+            return false;
+    }
+
+    return true;
+}
+
+
+bool FrameServer::sleepUntil(const std::int64_t t_deadline_ns)
+{
+    while(not m_control->isShutdown()){
+        const std::int64_t remaining_ns = t_deadline_ns - monotonicTimeNs();
+        if(remaining_ns <= 0)
+            return true;
+
+        //  ppoll() sleeps with a ns resolution and still wakes up at the shutdown
+        const timespec timeout { static_cast<time_t>(remaining_ns/1000000000), static_cast<long>(remaining_ns%1000000000) };
+
+        pollfd fds[1];
+        fds[0] = { m_control_event_fd, POLLIN, 0 };
+
+        if(ppoll(fds, 1, &timeout, nullptr) > 0 and (fds[0].revents & POLLIN))
+            AcquisitionControl::clearEvents(m_control_event_fd);
+    }
+
+    return false;
+}
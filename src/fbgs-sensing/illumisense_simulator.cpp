@@ -0,0 +1,127 @@
+/*
+This code implements a simulation of the stream of the FBGS IllumiSense interrogator
+*/
+
+#include "fbgs-sensing/illumisense_simulator.h"
+#include "fbgs-sensing/frame.h"
+
+#include <cmath>
+#include <ctime>
+#include <algorithm>
+
+
+IllumiSenseSimulator::IllumiSenseSimulator(const Config &t_config) :
+    m_config(t_config),
+    m_motion(t_config.motion),
+    m_noise(0, std::max(0.0, t_config.strain_noise))
+{
+    char date[16];
+    const std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y/%m/%d", std::localtime(&now));
+    m_date = date;
+}
+
+
+
+bool IllumiSenseSimulator::nextFrame(std::vector<char> &t_frame,
+                                     double &t_time)
+{
+    if(m_config.num_samples > 0 and m_sample_number >= m_config.num_samples)
+        return false;
+
+    t_time = m_sample_number/m_config.frequency;
+
+    const int num_channels = getNumberOfChannels();
+
+
+    beginFrame(t_frame);
+
+    appendText(t_frame, m_date);
+
+    appendClock(t_frame, t_time);
+
+    appendInteger(t_frame, static_cast<std::int64_t>(m_sample_number));
+    appendInteger(t_frame, num_channels);
+
+
+    //  The strains are drawn once, the wavelengths and the engineered values must agree
+    m_strains.resize(num_channels*m_config.num_gratings);
+
+    for(int i=0; i<num_channels; i++)
+        for(int j=0; j<m_config.num_gratings; j++){
+            double strain = getStrain(i, j, m_sample_number);
+            if(m_config.strain_noise > 0)
+                strain += m_noise(m_generator);
+
+            m_strains[i*m_config.num_gratings + j] = strain;
+        }
+
+
+    for(int i=0; i<num_channels; i++){
+        appendInteger(t_frame, i + 1);
+        appendInteger(t_frame, m_config.num_gratings);
+
+        //  Error status
+        for(int k=0; k<4; k++)
+            appendInteger(t_frame, 0);
+
+        for(int j=0; j<m_config.num_gratings; j++)
+            appendDecimal(t_frame, getReferenceWavelength(i, j)*(1 + 1e-6*m_config.gauge_factor*m_strains[i*m_config.num_gratings + j]), 5);
+
+        for(int j=0; j<m_config.num_gratings; j++)
+            appendDecimal(t_frame, 20 + 0.5*((i + j) % 5), 2);
+    }
+
+
+    appendInteger(t_frame, num_channels*m_config.num_gratings);
+
+    for(const double strain : m_strains)
+        appendDecimal(t_frame, strain, 3);
+
+    endFrame(t_frame);
+
+    m_sample_number++;
+
+    return true;
+}
+
+
+
+
+double IllumiSenseSimulator::getCoreAngle(const int t_channel) const
+{
+    if(t_channel >= m_config.num_outer_cores)
+        return 0;
+
+    return 2*M_PI*t_channel/m_config.num_outer_cores;
+}
+
+
+double IllumiSenseSimulator::getCoreDistance(const int t_channel) const
+{
+    return t_channel < m_config.num_outer_cores ? m_config.motion.core_distance : 0;
+}
+
+
+double IllumiSenseSimulator::getGratingPosition(const int t_grating) const
+{
+    return m_config.motion.length*(t_grating + 0.5)/std::max(1, m_config.num_gratings);
+}
+
+
+double IllumiSenseSimulator::getReferenceWavelength(const int t_channel,
+                                                    const int t_grating) const
+{
+    //  Spread over the C band, 0.8 nm between the cores of a grating
+    return 1525 + 40.0*(t_grating + 0.5)/std::max(1, m_config.num_gratings) + 0.8*t_channel/std::max(1, getNumberOfChannels());
+}
+
+
+double IllumiSenseSimulator::getStrain(const int t_channel,
+                                       const int t_grating,
+                                       const std::uint64_t t_sample_number) const
+{
+    const double time = t_sample_number/m_config.frequency;
+
+    return 1e6*m_motion.coreStrain(getGratingPosition(t_grating), time, getCoreAngle(t_channel), getCoreDistance(t_channel));
+}
@@ -0,0 +1,215 @@
+/*
+This code implements the timing of the stages of the acquisition
+*/
+
+#include "fbgs-sensing/instrumentation.h"
+
+#include <algorithm>
+#include <bit>
+#include <iomanip>
+#include <iostream>
+
+
+namespace
+{
+
+//  Reference of the measure of the period of the time stamp counter
+const std::uint64_t start_ticks = Instrumentation::ticks();
+const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+const char *stage_names[Instrumentation::NUM_STAGES] = { "read", "parse", "process", "store", "export" };
+
+}
+
+
+std::atomic<Instrumentation::ThreadHistograms*> Instrumentation::m_threads { nullptr };
+
+std::mutex Instrumentation::m_dump_mutex;
+std::condition_variable Instrumentation::m_dump_condition;
+std::thread Instrumentation::m_dump_thread;
+bool Instrumentation::m_dump_running { false };
+
+
+
+
+unsigned int Instrumentation::bucket(const std::uint64_t t_ticks)
+{
+    if(t_ticks < 8)
+        return static_cast<unsigned int>(t_ticks);
+
+    const unsigned int msb = static_cast<unsigned int>(std::bit_width(t_ticks)) - 1;
+    const unsigned int sub = static_cast<unsigned int>(t_ticks >> (msb - 2)) & (SUB_BUCKETS - 1);
+
+    return 8 + SUB_BUCKETS*(msb - 3) + sub;
+}
+
+
+std::uint64_t Instrumentation::bucketUpperBound(const unsigned int t_bucket)
+{
+    if(t_bucket < 8)
+        return t_bucket + 1;
+
+    const unsigned int msb = 3 + (t_bucket - 8)/SUB_BUCKETS;
+    const std::uint64_t sub = (t_bucket - 8) % SUB_BUCKETS;
+
+    return (SUB_BUCKETS + sub + 1) << (msb - 2);
+}
+
+
+
+Instrumentation::ThreadHistograms &Instrumentation::threadHistograms()
+{
+    thread_local ThreadHistograms *histograms = nullptr;
+
+    if(histograms == nullptr){
+        //  Never freed, the stats of the threads that exited are still reported
+        histograms = new ThreadHistograms();
+
+        ThreadHistograms *head = m_threads.load(std::memory_order_relaxed);
+        do {
+            histograms->next = head;
+        } while(not m_threads.compare_exchange_weak(head, histograms, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    return *histograms;
+}
+
+
+
+void Instrumentation::record(const Stage t_stage,
+                             const std::uint64_t t_ticks)
+{
+    Histogram &histogram = threadHistograms().stages[t_stage];
+
+    //  Single writer, the atomics are only there for the readers of the stats
+    std::atomic<std::uint64_t> &count = histogram.buckets[bucket(t_ticks)];
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    histogram.sum.store(histogram.sum.load(std::memory_order_relaxed) + t_ticks, std::memory_order_relaxed);
+    if(t_ticks > histogram.max.load(std::memory_order_relaxed))
+        histogram.max.store(t_ticks, std::memory_order_relaxed);
+}
+
+
+
+double Instrumentation::nanosecondsPerTick()
+{
+    //  The longer since the reference, the better the measure
+    if(std::chrono::steady_clock::now() - start_time < std::chrono::milliseconds(10))
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    const std::uint64_t elapsed_ticks = ticks() - start_ticks;
+    const double elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_time).count();
+
+    return elapsed_ticks > 0 ? elapsed_ns/elapsed_ticks : 1;
+}
+
+
+
+Instrumentation::Stats Instrumentation::getStats()
+{
+    Stats stats;
+    for(int stage=0; stage<NUM_STAGES; stage++)
+        stats[stage].name = stage_names[stage];
+
+    if(not isEnabled())
+        return stats;
+
+
+    const double us_per_tick = 1e-3*nanosecondsPerTick();
+
+    for(int stage=0; stage<NUM_STAGES; stage++){
+        std::array<std::uint64_t, BUCKETS> buckets {};
+        std::uint64_t count = 0;
+        std::uint64_t sum = 0;
+        std::uint64_t max = 0;
+
+        for(ThreadHistograms *thread = m_threads.load(std::memory_order_acquire); thread != nullptr; thread = thread->next){
+            const Histogram &histogram = thread->stages[stage];
+            for(unsigned int i=0; i<BUCKETS; i++)
+                buckets[i] += histogram.buckets[i].load(std::memory_order_relaxed);
+            sum += histogram.sum.load(std::memory_order_relaxed);
+            max = std::max(max, histogram.max.load(std::memory_order_relaxed));
+        }
+
+        //  Counted from the buckets, consistent with the percentiles when read during the acquisition
+        for(const std::uint64_t bucket_count : buckets)
+            count += bucket_count;
+
+        if(count == 0)
+            continue;
+
+        auto percentile = [&](const double t_fraction){
+            const std::uint64_t rank = static_cast<std::uint64_t>(t_fraction*(count - 1));
+            std::uint64_t cumulated = 0;
+            for(unsigned int i=0; i<BUCKETS; i++){
+                cumulated += buckets[i];
+                if(cumulated > rank)
+                    return us_per_tick*std::min(bucketUpperBound(i), max);
+            }
+            return us_per_tick*max;
+        };
+
+        StageStats &stage_stats = stats[stage];
+        stage_stats.count = count;
+        stage_stats.mean = us_per_tick*sum/count;
+        stage_stats.p50 = percentile(0.5);
+        stage_stats.p99 = percentile(0.99);
+        stage_stats.p999 = percentile(0.999);
+        stage_stats.max = us_per_tick*max;
+        stage_stats.total = 1e-6*us_per_tick*sum;
+    }
+
+    return stats;
+}
+
+
+
+void Instrumentation::printStats(std::ostream &t_output)
+{
+    if(not isEnabled()){
+        t_output << "[FBGS] instrumentation disabled, build with FBGS_ENABLE_INSTRUMENTATION" << std::endl;
+        return;
+    }
+
+    const Stats stats = getStats();
+
+    t_output << "[FBGS] stage        count   mean us    p50 us    p99 us  p99.9 us    max us   total s\n";
+    for(const StageStats &stage : stats)
+        t_output << "[FBGS] " << std::left << std::setw(8) << stage.name << std::right
+                 << std::setw(10) << stage.count << std::fixed << std::setprecision(2)
+                 << std::setw(10) << stage.mean << std::setw(10) << stage.p50 << std::setw(10) << stage.p99
+                 << std::setw(10) << stage.p999 << std::setw(10) << stage.max
+                 << std::setprecision(3) << std::setw(10) << stage.total << "\n";
+    t_output << std::defaultfloat << std::flush;
+}
+
+
+
+void Instrumentation::startPeriodicDump(const std::chrono::milliseconds t_period)
+{
+    stopPeriodicDump();
+
+    m_dump_running = true;
+    m_dump_thread = std::thread([t_period](){
+        std::unique_lock<std::mutex> lock(m_dump_mutex);
+
+        while(not m_dump_condition.wait_for(lock, t_period, [](){ return not m_dump_running; }))
+            printStats(std::cout);
+    });
+}
+
+
+void Instrumentation::stopPeriodicDump()
+{
+    if(not m_dump_thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_dump_mutex);
+        m_dump_running = false;
+    }
+
+    m_dump_condition.notify_one();
+    m_dump_thread.join();
+}
@@ -0,0 +1,204 @@
+/*
+This code implements the statistics of the arrival times of the samples of a stream
+*/
+
+#include "fbgs-sensing/jitter_analyzer.h"
+
+#include <yaml-cpp/yaml.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+
+unsigned int JitterAnalyzer::bucket(const std::uint64_t t_value)
+{
+    if(t_value < 2*SUB_BUCKETS)
+        return static_cast<unsigned int>(t_value);
+
+    //  The last power of two holds the larger values
+    const unsigned int max_msb = SUB_BUCKET_BITS + (BUCKETS - 2*SUB_BUCKETS)/SUB_BUCKETS;
+    const unsigned int msb = std::min<unsigned int>(std::bit_width(t_value) - 1, max_msb);
+    const unsigned int shift = msb - SUB_BUCKET_BITS;
+    const std::uint64_t sub = std::min(t_value >> shift, 2*SUB_BUCKETS - 1) - SUB_BUCKETS;
+
+    return static_cast<unsigned int>(2*SUB_BUCKETS + (msb - SUB_BUCKET_BITS - 1)*SUB_BUCKETS + sub);
+}
+
+
+std::uint64_t JitterAnalyzer::bucketLowerBound(const unsigned int t_bucket)
+{
+    if(t_bucket < 2*SUB_BUCKETS)
+        return t_bucket;
+
+    const unsigned int shift = 1 + (t_bucket - 2*SUB_BUCKETS)/SUB_BUCKETS;
+    const std::uint64_t sub = (t_bucket - 2*SUB_BUCKETS) % SUB_BUCKETS;
+
+    return (SUB_BUCKETS + sub) << shift;
+}
+
+
+std::uint64_t JitterAnalyzer::bucketUpperBound(const unsigned int t_bucket)
+{
+    if(t_bucket < 2*SUB_BUCKETS)
+        return t_bucket + 1;
+
+    const unsigned int shift = 1 + (t_bucket - 2*SUB_BUCKETS)/SUB_BUCKETS;
+
+    return bucketLowerBound(t_bucket) + (std::uint64_t(1) << shift);
+}
+
+
+
+
+void JitterAnalyzer::update(const std::int64_t t_sample_number,
+                            const std::chrono::high_resolution_clock::time_point t_time_stamp)
+{
+    if(m_samples == 0){
+        m_first_time_stamp = t_time_stamp;
+    }
+    else{
+        const double interval = std::chrono::duration<double, std::micro>(t_time_stamp - m_last_time_stamp).count();
+
+        m_intervals++;
+        const double delta = interval - m_mean;
+        m_mean += delta/m_intervals;
+        m_m2 += delta*(interval - m_mean);
+
+        m_min = m_intervals == 1 ? interval : std::min(m_min, interval);
+        m_max = m_intervals == 1 ? interval : std::max(m_max, interval);
+
+        m_histogram[bucket(static_cast<std::uint64_t>(std::max(0.0, std::round(interval))))]++;
+
+        m_steps[t_sample_number - m_last_sample_number]++;
+    }
+
+    m_samples++;
+    m_last_time_stamp = t_time_stamp;
+    m_last_sample_number = t_sample_number;
+}
+
+
+void JitterAnalyzer::reset()
+{
+    *this = JitterAnalyzer();
+}
+
+
+
+
+double JitterAnalyzer::percentile(const double t_fraction) const
+{
+    if(m_intervals == 0)
+        return 0;
+
+    const std::uint64_t rank = static_cast<std::uint64_t>(std::clamp(t_fraction, 0.0, 1.0)*(m_intervals - 1));
+
+    std::uint64_t cumulated = 0;
+    for(unsigned int i=0; i<BUCKETS; i++){
+        cumulated += m_histogram[i];
+        if(cumulated > rank){
+            //  Middle of the bucket, the exact value below 2 SUB_BUCKETS µs
+            const double value = 0.5*(bucketLowerBound(i) + bucketUpperBound(i) - 1);
+            return std::clamp(value, m_min, m_max);
+        }
+    }
+
+    return m_max;
+}
+
+
+
+JitterAnalyzer::Statistics JitterAnalyzer::getStatistics() const
+{
+    Statistics statistics;
+
+    statistics.samples = m_samples;
+    if(m_samples > 0)
+        statistics.duration = std::chrono::duration<double>(m_last_time_stamp - m_first_time_stamp).count();
+
+    statistics.intervals = m_intervals;
+    statistics.mean = m_mean;
+    statistics.standard_deviation = m_intervals > 1 ? std::sqrt(m_m2/(m_intervals - 1)) : 0;
+    statistics.min = m_min;
+    statistics.max = m_max;
+    statistics.p50 = percentile(0.5);
+    statistics.p90 = percentile(0.9);
+    statistics.p99 = percentile(0.99);
+    statistics.p999 = percentile(0.999);
+
+    for(const auto &[step, count] : m_steps){
+        if(step > 1){
+            statistics.gaps += count;
+            statistics.missed += count*static_cast<std::uint64_t>(step - 1);
+        }
+        else if(step < 1)
+            statistics.repeated += count;
+    }
+
+    if(not m_steps.empty())
+        statistics.largest_step = m_steps.rbegin()->first;
+
+    return statistics;
+}
+
+
+
+
+bool JitterAnalyzer::writeReport(const std::string &t_file_name) const
+{
+    const Statistics statistics = getStatistics();
+
+    YAML::Emitter report;
+    report << YAML::BeginMap;
+
+    report << YAML::Key << "samples" << YAML::Value << statistics.samples;
+    report << YAML::Key << "duration" << YAML::Value << statistics.duration;
+
+    report << YAML::Key << "inter_arrival_us" << YAML::Value << YAML::BeginMap;
+    report << YAML::Key << "count" << YAML::Value << statistics.intervals;
+    report << YAML::Key << "mean" << YAML::Value << statistics.mean;
+    report << YAML::Key << "standard_deviation" << YAML::Value << statistics.standard_deviation;
+    report << YAML::Key << "min" << YAML::Value << statistics.min;
+    report << YAML::Key << "p50" << YAML::Value << statistics.p50;
+    report << YAML::Key << "p90" << YAML::Value << statistics.p90;
+    report << YAML::Key << "p99" << YAML::Value << statistics.p99;
+    report << YAML::Key << "p99.9" << YAML::Value << statistics.p999;
+    report << YAML::Key << "max" << YAML::Value << statistics.max;
+
+    //  [lower bound, count] of the non empty buckets
+    report << YAML::Key << "histogram" << YAML::Value << YAML::BeginSeq;
+    for(unsigned int i=0; i<BUCKETS; i++)
+        if(m_histogram[i] > 0)
+            report << YAML::Flow << YAML::BeginSeq << bucketLowerBound(i) << m_histogram[i] << YAML::EndSeq;
+    report << YAML::EndSeq;
+    report << YAML::EndMap;
+
+    report << YAML::Key << "sample_number_steps" << YAML::Value << YAML::BeginMap;
+    report << YAML::Key << "gaps" << YAML::Value << statistics.gaps;
+    report << YAML::Key << "missed" << YAML::Value << statistics.missed;
+    report << YAML::Key << "repeated" << YAML::Value << statistics.repeated;
+    report << YAML::Key << "largest" << YAML::Value << statistics.largest_step;
+
+    //  [step, count]
+    report << YAML::Key << "histogram" << YAML::Value << YAML::BeginSeq;
+    for(const auto &[step, count] : m_steps)
+        report << YAML::Flow << YAML::BeginSeq << step << count << YAML::EndSeq;
+    report << YAML::EndSeq;
+    report << YAML::EndMap;
+
+    report << YAML::EndMap;
+
+
+    std::ofstream file(t_file_name);
+    file << report.c_str() << "\n";
+
+    if(not file){
+        std::cerr << "[FBGS] cannot write the jitter report " << t_file_name << std::endl;
+        return false;
+    }
+
+    return true;
+}
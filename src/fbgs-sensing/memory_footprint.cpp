@@ -0,0 +1,88 @@
+/*
+This code implements the accounting of the memory used by the storages of the samples
+*/
+
+#include "fbgs-sensing/memory_footprint.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#include <malloc.h>
+#include <unistd.h>
+
+
+std::size_t allocatedBytes(const void *t_pointer)
+{
+    if(t_pointer == nullptr)
+        return 0;
+
+    //  The usable size with the size field of the chunk, the smallest overhead of glibc's malloc
+    return malloc_usable_size(const_cast<void*>(t_pointer)) + sizeof(std::size_t);
+}
+
+
+std::uint64_t residentBytes()
+{
+    std::ifstream statm("/proc/self/statm");
+
+    std::uint64_t size = 0;
+    std::uint64_t resident = 0;
+    if(not (statm >> size >> resident))
+        return 0;
+
+    return resident*static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+}
+
+
+
+
+bool SampleMemoryAccount::add(const std::size_t t_bytes)
+{
+    if(m_exhausted)
+        return false;
+
+    const std::uint64_t samples = m_samples.load(std::memory_order_relaxed);
+    const std::uint64_t bytes = m_bytes.load(std::memory_order_relaxed) + t_bytes;
+
+    if(samples == 0)
+        m_first_sample = std::chrono::steady_clock::now();
+
+    if(m_budget.max_bytes > 0){
+        const std::uint64_t total_bytes = m_fixed_bytes + bytes;
+
+        if(total_bytes > m_budget.max_bytes){
+            std::cerr << "[FBGS] the recorded samples reached the memory budget of " << 1e-6*m_budget.max_bytes
+                      << " MB after " << samples << " samples, the next ones are not kept in memory" << std::endl;
+            m_exhausted = true;
+            return false;
+        }
+
+        if(not m_warned and total_bytes >= m_budget.warning_fraction*m_budget.max_bytes){
+            const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_first_sample).count();
+            const double samples_left = (m_budget.max_bytes - total_bytes)/(static_cast<double>(bytes)/(samples + 1));
+            std::cerr << "[FBGS] the recorded samples use " << 1e-6*total_bytes << " MB of the memory budget of "
+                      << 1e-6*m_budget.max_bytes << " MB, about " << samples_left*elapsed/std::max<std::uint64_t>(samples, 1)
+                      << " s left at the current rate" << std::endl;
+            m_warned = true;
+        }
+    }
+
+    m_samples.store(samples + 1, std::memory_order_relaxed);
+    m_bytes.store(bytes, std::memory_order_relaxed);
+
+    return true;
+}
+
+
+MemoryFootprint SampleMemoryAccount::getFootprint() const
+{
+    MemoryFootprint footprint;
+    footprint.samples = m_samples.load(std::memory_order_relaxed);
+    footprint.fixed_bytes = m_fixed_bytes;
+    footprint.sample_bytes = m_bytes.load(std::memory_order_relaxed);
+    footprint.bytes_per_sample = footprint.samples > 0 ? static_cast<double>(footprint.sample_bytes)/footprint.samples : 0;
+    footprint.resident_bytes = residentBytes();
+
+    return footprint;
+}
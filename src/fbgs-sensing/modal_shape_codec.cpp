@@ -0,0 +1,101 @@
+/*
+This code implements the compression of the shapes on a reduced polynomial basis
+*/
+
+#include "fbgs-sensing/modal_shape_codec.h"
+
+#include <algorithm>
+
+
+ModalShapeCodec::ModalShapeCodec(const double t_max_error,
+                                 const int t_max_modes) :
+    m_max_error(t_max_error),
+    m_max_modes(t_max_modes)
+{
+}
+
+
+
+void ModalShapeCodec::setNumberOfPoints(const int t_num_points)
+{
+    m_num_points = t_num_points;
+
+    const int modes = std::min(m_max_modes, m_num_points);
+
+
+    //  Legendre polynomials on [-1, 1] with the three terms recurrence
+    Eigen::MatrixXd legendre(m_num_points, modes);
+    Eigen::VectorXd s = Eigen::VectorXd::Zero(m_num_points);
+    if(m_num_points > 1)
+        s = Eigen::VectorXd::LinSpaced(m_num_points, -1.0, 1.0);
+
+    for(int k=0; k<modes; k++){
+        if(k == 0)
+            legendre.col(k).setOnes();
+        else if(k == 1)
+            legendre.col(k) = s;
+        else
+            legendre.col(k) = ( (2.0*k - 1.0)*s.cwiseProduct(legendre.col(k-1)) - (k - 1.0)*legendre.col(k-2) ) / k;
+    }
+
+
+    //  Orthonormalise them on the grid, the span of the first k columns is unchanged
+    Eigen::HouseholderQR<Eigen::MatrixXd> qr(legendre);
+    m_basis = qr.householderQ() * Eigen::MatrixXd::Identity(m_num_points, modes);
+
+    m_coefficients.resize(modes, 3);
+    m_residual.resize(m_num_points, 3);
+}
+
+
+
+
+bool ModalShapeCodec::encode(const Eigen::MatrixXd &t_shape, ModalShape &t_modal_shape)
+{
+    if(t_shape.rows() != m_num_points or m_basis.rows() != t_shape.rows())
+        setNumberOfPoints(static_cast<int>(t_shape.rows()));
+
+    t_modal_shape.num_shape_points = m_num_points;
+
+    if(m_num_points == 0){
+        t_modal_shape.num_modes = 0;
+        t_modal_shape.coefficients.resize(0, 3);
+        t_modal_shape.max_error = 0;
+        return true;
+    }
+
+    const int modes = static_cast<int>(m_basis.cols());
+
+    m_coefficients.noalias() = m_basis.transpose() * t_shape;
+
+
+    //  Add one mode at a time until every point is close enough
+    m_residual = t_shape;
+    int used_modes = 0;
+    double max_error = m_residual.rowwise().norm().maxCoeff();
+
+    while(used_modes < modes and max_error > m_max_error){
+        m_residual.noalias() -= m_basis.col(used_modes) * m_coefficients.row(used_modes);
+        used_modes++;
+
+        max_error = m_residual.rowwise().norm().maxCoeff();
+    }
+
+
+    t_modal_shape.num_modes = used_modes;
+    t_modal_shape.coefficients = m_coefficients.topRows(used_modes);
+    t_modal_shape.max_error = max_error;
+
+    return max_error <= m_max_error;
+}
+
+
+
+void ModalShapeCodec::decode(const ModalShape &t_modal_shape, Eigen::MatrixXd &t_shape)
+{
+    if(t_modal_shape.num_shape_points != m_num_points)
+        setNumberOfPoints(t_modal_shape.num_shape_points);
+
+    t_shape.resize(m_num_points, 3);
+    t_shape.noalias() = m_basis.leftCols(t_modal_shape.num_modes) * t_modal_shape.coefficients;
+}
@@ -0,0 +1,308 @@
+/*
+This code implements the file format of the raw captures of the streams of the interrogators
+*/
+
+#include "fbgs-sensing/raw_capture.h"
+
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+
+namespace
+{
+
+std::uint64_t decodeLittleEndian(const char *t_data, const std::size_t t_size)
+{
+    std::uint64_t value = 0;
+    for(std::size_t i=0; i<t_size; i++)
+        value |= static_cast<std::uint64_t>(static_cast<unsigned char>(t_data[i])) << (8*i);
+
+    return value;
+}
+
+
+void encodeLittleEndian(std::uint64_t t_value,
+                        const std::size_t t_size,
+                        char *t_data)
+{
+    for(std::size_t i=0; i<t_size; i++){
+        t_data[i] = static_cast<char>(t_value & 0xff);
+        t_value >>= 8;
+    }
+}
+
+
+bool writeAll(const int t_fd,
+              const char *t_data,
+              std::size_t t_size)
+{
+    while(t_size > 0){
+        const ssize_t written = ::write(t_fd, t_data, t_size);
+        if(written < 0){
+            if(errno == EINTR)
+                continue;
+            return false;
+        }
+
+        t_data += written;
+        t_size -= static_cast<std::size_t>(written);
+    }
+
+    return true;
+}
+
+}
+
+
+
+
+RawCaptureWriter::RawCaptureWriter(const std::string &t_file_name,
+                                   const RawCaptureConfig &t_config)
+{
+    m_fd = ::open(t_file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(m_fd < 0 or not writeAll(m_fd, RAW_CAPTURE_MAGIC, sizeof(RAW_CAPTURE_MAGIC))){
+        std::cerr << "[FBGS] cannot write the raw capture " << t_file_name << " : " << std::strerror(errno) << std::endl;
+        if(m_fd >= 0)
+            ::close(m_fd);
+        m_fd = -1;
+        return;
+    }
+
+    //  Allocated and touched now, so that the acquisition does not page fault
+    m_blocks.resize(std::max(2u, t_config.num_blocks));
+    for(Block &block : m_blocks){
+        block.data.assign(std::max(t_config.block_size, RAW_CAPTURE_RECORD_HEADER_SIZE), 0);
+        m_blocks_bytes += allocatedBytes(block.data);
+        m_free_blocks.push_back(&block);
+    }
+
+    m_current = m_free_blocks.front();
+    m_free_blocks.pop_front();
+
+    m_thread = std::thread([this](){ writingLoop(); });
+}
+
+
+RawCaptureWriter::~RawCaptureWriter()
+{
+    close();
+}
+
+
+
+bool RawCaptureWriter::append(const std::int64_t t_time_ns,
+                              const char *t_data,
+                              const std::size_t t_size)
+{
+    if(m_current == nullptr)
+        return false;
+
+    const std::size_t record_size = RAW_CAPTURE_RECORD_HEADER_SIZE + t_size;
+
+    if(m_current->size + record_size > m_current->data.size()){
+        if(record_size > m_current->data.size() or not nextBlock()){
+            m_frames_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    char *record = m_current->data.data() + m_current->size;
+    encodeLittleEndian(static_cast<std::uint64_t>(t_time_ns), 8, record);
+    encodeLittleEndian(t_size, 4, record + 8);
+    std::memcpy(record + RAW_CAPTURE_RECORD_HEADER_SIZE, t_data, t_size);
+
+    m_current->size += record_size;
+
+    m_frames_written.fetch_add(1, std::memory_order_relaxed);
+    m_bytes_written.fetch_add(record_size, std::memory_order_relaxed);
+
+    return true;
+}
+
+
+bool RawCaptureWriter::nextBlock()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if(m_free_blocks.empty())
+            return false;
+
+        m_full_blocks.push_back(m_current);
+        m_current = m_free_blocks.front();
+        m_free_blocks.pop_front();
+    }
+
+    m_condition.notify_one();
+
+    return true;
+}
+
+
+void RawCaptureWriter::flush()
+{
+    if(m_current != nullptr and m_current->size > 0)
+        nextBlock();
+}
+
+
+void RawCaptureWriter::close()
+{
+    if(not m_thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        //  The last block is written with the others
+        if(m_current->size > 0)
+            m_full_blocks.push_back(m_current);
+        m_current = nullptr;
+
+        m_closing = true;
+    }
+
+    m_condition.notify_one();
+    m_thread.join();
+
+    ::close(m_fd);
+    m_fd = -1;
+}
+
+
+
+void RawCaptureWriter::writingLoop()
+{
+    while(true){
+        Block *block = nullptr;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this](){ return m_closing or not m_full_blocks.empty(); });
+
+            if(m_full_blocks.empty())
+                return;
+
+            block = m_full_blocks.front();
+            m_full_blocks.pop_front();
+        }
+
+        if(not writeAll(m_fd, block->data.data(), block->size))
+            std::cerr << "[FBGS] cannot write the raw capture : " << std::strerror(errno) << std::endl;
+
+        block->size = 0;
+        m_blocks_written.fetch_add(1, std::memory_order_relaxed);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_free_blocks.push_back(block);
+        }
+    }
+}
+
+
+
+RawCaptureWriter::Statistics RawCaptureWriter::getStatistics() const
+{
+    Statistics statistics;
+    statistics.frames_written = m_frames_written.load(std::memory_order_relaxed);
+    statistics.bytes_written = m_bytes_written.load(std::memory_order_relaxed);
+    statistics.frames_dropped = m_frames_dropped.load(std::memory_order_relaxed);
+    statistics.blocks_written = m_blocks_written.load(std::memory_order_relaxed);
+
+    return statistics;
+}
+
+
+MemoryFootprint RawCaptureWriter::getMemoryFootprint() const
+{
+    MemoryFootprint footprint;
+    footprint.samples = m_frames_written.load(std::memory_order_relaxed);
+    footprint.fixed_bytes = m_blocks_bytes;
+    footprint.resident_bytes = residentBytes();
+
+    return footprint;
+}
+
+
+
+
+RawCaptureReader::RawCaptureReader(const std::string &t_file_name) :
+    m_file(t_file_name, std::ios::binary)
+{
+    char magic[sizeof(RAW_CAPTURE_MAGIC)];
+    m_open = m_file.read(magic, sizeof(magic)) and std::memcmp(magic, RAW_CAPTURE_MAGIC, sizeof(magic)) == 0;
+}
+
+
+
+bool RawCaptureReader::read(std::int64_t &t_time_ns,
+                            std::vector<char> &t_frame)
+{
+    if(not m_open)
+        return false;
+
+    char header[RAW_CAPTURE_RECORD_HEADER_SIZE];
+    if(not m_file.read(header, sizeof(header)))
+        return false;
+
+    t_time_ns = static_cast<std::int64_t>(decodeLittleEndian(header, 8));
+    t_frame.resize(decodeLittleEndian(header + 8, 4));
+
+    if(not m_file.read(t_frame.data(), static_cast<std::streamsize>(t_frame.size())))
+        return false;
+
+    m_records_read++;
+
+    return true;
+}
+
+
+std::size_t RawCaptureReader::readAll(std::vector<char> &t_data,
+                                      std::vector<Record> &t_records)
+{
+    t_data.clear();
+    t_records.clear();
+
+    if(not m_open)
+        return 0;
+
+    const std::streampos position = m_file.tellg();
+    m_file.seekg(0, std::ios::end);
+    const std::streamoff size = m_file.tellg() - position;
+    m_file.seekg(position);
+
+    t_data.resize(static_cast<std::size_t>(size));
+    m_file.read(t_data.data(), size);
+
+
+    std::size_t offset = 0;
+    while(offset + RAW_CAPTURE_RECORD_HEADER_SIZE <= t_data.size()){
+        const std::int64_t time_ns = static_cast<std::int64_t>(decodeLittleEndian(t_data.data() + offset, 8));
+        const std::size_t frame_size = decodeLittleEndian(t_data.data() + offset + 8, 4);
+
+        offset += RAW_CAPTURE_RECORD_HEADER_SIZE;
+        if(offset + frame_size > t_data.size())
+            break;
+
+        t_records.push_back({time_ns, offset, frame_size});
+        offset += frame_size;
+    }
+
+    m_records_read += t_records.size();
+
+    return t_records.size();
+}
+
+
+void RawCaptureReader::rewind()
+{
+    m_file.clear();
+    m_file.seekg(sizeof(RAW_CAPTURE_MAGIC));
+
+    m_records_read = 0;
+}
@@ -0,0 +1,60 @@
+/*
+This code implements the real time configuration of the acquisition threads
+*/
+
+#include "fbgs-sensing/real_time_config.h"
+
+#include <malloc.h>
+#include <unistd.h>
+#include <alloca.h>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+
+void configureRealTimeThread(const RealTimeConfig &t_config,
+                             const std::string &t_keyword,
+                             real_time_tools::RealTimeThreadParameters &t_parameters)
+{
+    t_parameters.keyword_ = t_keyword;
+    t_parameters.priority_ = t_config.priority;
+    t_parameters.cpu_id_ = t_config.cpu_ids;
+    t_parameters.block_memory_ = t_config.lock_memory;
+}
+
+
+
+void prefaultMemory(const RealTimeConfig &t_config)
+{
+    const std::size_t page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+
+
+    //  Touch the stack so that its pages are mapped (and locked) before the loop
+    if(t_config.prefault_stack_bytes > 0){
+        volatile char *stack = static_cast<volatile char*>(alloca(t_config.prefault_stack_bytes));
+        for(std::size_t i=0; i<t_config.prefault_stack_bytes; i+=page_size)
+            stack[i] = 0;
+    }
+
+
+    if(t_config.prefault_heap_bytes == 0)
+        return;
+
+    //  Freed memory must stay in the heap instead of going back to the system,
+    //  and large blocks must come from the heap too instead of a new mmap
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    char *heap = static_cast<char*>(std::malloc(t_config.prefault_heap_bytes));
+    if(heap == nullptr){
+        std::cerr << "[FBGS] could not pre-fault " << t_config.prefault_heap_bytes << " bytes of heap" << std::endl;
+        return;
+    }
+
+    //  Volatile writes so that the compiler cannot drop the allocation
+    volatile char *pages = heap;
+    for(std::size_t i=0; i<t_config.prefault_heap_bytes; i+=page_size)
+        pages[i] = 0;
+
+    std::free(heap);
+}
@@ -0,0 +1,415 @@
+/*
+This code implements the replay of recorded sessions as streams of the interrogators
+*/
+
+#include "fbgs-sensing/recording_replay.h"
+#include "fbgs-sensing/frame.h"
+
+#include <yaml-cpp/yaml.h>
+
+#include <fstream>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+
+RawCaptureReplay::RawCaptureReplay(const std::string &t_file_name,
+                                   const bool t_loop) :
+    m_reader(t_file_name),
+    m_loop(t_loop)
+{
+    if(not m_reader.isOpen())
+        std::cerr << "[FBGS] " << t_file_name << " is not a raw capture" << std::endl;
+}
+
+
+
+bool RawCaptureReplay::nextFrame(std::vector<char> &t_frame,
+                                 double &t_time)
+{
+    std::int64_t time_ns;
+
+    if(not m_reader.read(time_ns, m_payload)){
+        //  Next repetition, one mean period after the last frame
+        const std::uint64_t records = m_reader.getNumberOfRecordsRead();
+        if(not m_loop or records == 0)
+            return false;
+
+        const std::int64_t duration_ns = m_last_time_ns - m_first_time_ns;
+        m_offset_ns += duration_ns + duration_ns/std::max<std::int64_t>(1, records - 1);
+
+        m_reader.rewind();
+        if(not m_reader.read(time_ns, m_payload))
+            return false;
+    }
+
+    if(m_first_time_ns < 0)
+        m_first_time_ns = time_ns;
+    m_last_time_ns = time_ns;
+
+    t_time = 1e-9*(time_ns - m_first_time_ns + m_offset_ns);
+
+    t_frame.resize(FRAME_HEADER_SIZE + m_payload.size());
+    encodeFrameSize(static_cast<std::uint32_t>(m_payload.size()), t_frame.data());
+    std::memcpy(t_frame.data() + FRAME_HEADER_SIZE, m_payload.data(), m_payload.size());
+
+    return true;
+}
+
+
+void RawCaptureReplay::reset()
+{
+    m_reader.rewind();
+
+    m_first_time_ns = -1;
+    m_offset_ns = 0;
+}
+
+
+
+
+RecordedSamplesReplay::RecordedSamplesReplay(const std::string &t_yaml_file_name,
+                                             const std::string &t_csv_file_name,
+                                             const bool t_loop,
+                                             const int t_num_curvature_points) :
+    m_loop(t_loop),
+    m_num_curvature_points(t_num_curvature_points)
+{
+    try {
+        const YAML::Node description = YAML::LoadFile(t_yaml_file_name);
+
+        if(description["number_of_sensors"]){
+            m_device = Device::SHAPE_SENSING;
+
+            const YAML::Node data_order = description["data_order"];
+            if(not data_order or not data_order["sensors_data"] or not readSensorsDataOrder(data_order["sensors_data"])){
+                std::cerr << "[FBGS] " << t_yaml_file_name << " : unknown layout of the sensors data" << std::endl;
+                m_device = Device::UNKNOWN;
+            }
+        }
+        else if(description["number_of_channels"])
+            m_device = Device::ILLUMISENSE;
+        else
+            std::cerr << "[FBGS] " << t_yaml_file_name << " does not describe a recording" << std::endl;
+    }
+    catch(std::exception &e)
+    {
+        std::cerr << "[FBGS] " << t_yaml_file_name << " : " << e.what() << std::endl;
+        return;
+    }
+
+    if(m_device != Device::UNKNOWN and not readCsv(t_csv_file_name)){
+        std::cerr << "[FBGS] cannot read " << t_csv_file_name << std::endl;
+        m_device = Device::UNKNOWN;
+    }
+
+    if((m_device == Device::SHAPE_SENSING and not checkShapeSensingRows())
+       or (m_device == Device::ILLUMISENSE and not checkIllumiSenseRows())){
+        std::cerr << "[FBGS] the rows of " << t_csv_file_name << " do not match the layout of " << t_yaml_file_name << std::endl;
+        m_device = Device::UNKNOWN;
+    }
+}
+
+
+
+bool RecordedSamplesReplay::readSensorsDataOrder(const YAML::Node &t_sensors_data)
+{
+    const std::array<std::string, SENSOR_DATA_COUNT> names { "arc_length_coordinates", "curvature", "curvature_angle",
+                                                             "x_positions", "y_positions", "z_positions" };
+
+    m_sensors_data.clear();
+    std::array<int, SENSOR_DATA_COUNT> count {};
+
+    for(const YAML::Node &quantity : t_sensors_data){
+        const auto name = std::find(names.begin(), names.end(), quantity.as<std::string>());
+        if(name == names.end())
+            return false;
+
+        const SensorData data = static_cast<SensorData>(name - names.begin());
+        m_sensors_data.push_back(data);
+        count[data]++;
+    }
+
+    //  Every quantity at most once, the shape is required
+    return std::all_of(count.begin(), count.end(), [](const int t_count){ return t_count <= 1; })
+           and count[X_POSITIONS] == 1 and count[Y_POSITIONS] == 1 and count[Z_POSITIONS] == 1;
+}
+
+
+bool RecordedSamplesReplay::checkShapeSensingRows()
+{
+    if(m_data.rows() < 3 or m_data.cols() == 0)
+        return false;
+
+    const auto column = m_data.col(0);
+
+    const int num_sensors = static_cast<int>(column(2));
+    if(num_sensors < 0 or m_data.rows() < 3 + num_sensors)
+        return false;
+
+    Eigen::Index num_shape_points = 0;
+    for(int i=0; i<num_sensors; i++)
+        num_shape_points += static_cast<Eigen::Index>(column(3 + i));
+
+    const auto rows = [&](const std::size_t t_quantities){ return 3 + num_sensors + num_shape_points*static_cast<Eigen::Index>(t_quantities); };
+
+    if(m_data.rows() == rows(m_sensors_data.size()))
+        return true;
+
+    //  getSamplesData() used to describe its curvature rows as arc length, x, y and z only
+    const std::vector<SensorData> mislabelled { ARC_LENGTH, X_POSITIONS, Y_POSITIONS, Z_POSITIONS };
+    if(m_sensors_data == mislabelled and m_data.rows() == rows(SENSOR_DATA_COUNT)){
+        m_sensors_data = { ARC_LENGTH, CURVATURE, CURVATURE_ANGLE, X_POSITIONS, Y_POSITIONS, Z_POSITIONS };
+        return true;
+    }
+
+    return false;
+}
+
+
+
+bool RecordedSamplesReplay::checkIllumiSenseRows() const
+{
+    if(m_data.rows() < 3 or m_data.cols() == 0)
+        return false;
+
+    //  The channels can differ from sample to sample, but not the number of rows
+    for(Eigen::Index i=0; i<m_data.cols(); i++){
+        const auto column = m_data.col(i);
+
+        const int num_channels = static_cast<int>(column(2));
+        if(num_channels < 0 or m_data.rows() < 3 + num_channels)
+            return false;
+
+        //  Per channel: number, 4 error statuses, then wavelengths, powers and strains
+        Eigen::Index rows = 3 + num_channels;
+        for(int j=0; j<num_channels; j++){
+            const int num_gratings = static_cast<int>(column(3 + j));
+            if(num_gratings < 0)
+                return false;
+
+            rows += 5 + 3*static_cast<Eigen::Index>(num_gratings);
+        }
+
+        if(rows != m_data.rows())
+            return false;
+    }
+
+    return true;
+}
+
+
+
+bool RecordedSamplesReplay::readCsv(const std::string &t_file_name)
+{
+    std::ifstream file(t_file_name);
+    if(not file)
+        return false;
+
+    //  One line per quantity, one column per sample
+    std::vector<std::vector<double>> rows;
+    std::string line;
+
+    while(std::getline(file, line)){
+        if(line.empty())
+            continue;
+
+        std::vector<double> &row = rows.emplace_back();
+
+        const char *position = line.data();
+        const char *end = line.data() + line.size();
+        while(true){
+            //  The columns are aligned with spaces by Eigen
+            while(position < end and (*position == ',' or *position == ' ' or *position == '\r'))
+                position++;
+
+            if(position == end)
+                break;
+
+            double value = 0;
+            const std::from_chars_result result = std::from_chars(position, end, value);
+            if(result.ec != std::errc())
+                return false;
+
+            row.push_back(value);
+            position = result.ptr;
+        }
+
+        if(row.size() != rows.front().size())
+            return false;
+    }
+
+    if(rows.empty())
+        return false;
+
+
+    m_data.resize(rows.size(), rows.front().size());
+    for(std::size_t i=0; i<rows.size(); i++)
+        m_data.row(i) = Eigen::Map<const Eigen::RowVectorXd>(rows[i].data(), rows[i].size());
+
+    return true;
+}
+
+
+
+
+bool RecordedSamplesReplay::nextFrame(std::vector<char> &t_frame,
+                                      double &t_time)
+{
+    if(not isOpen())
+        return false;
+
+    if(m_next_column >= m_data.cols()){
+        if(not m_loop)
+            return false;
+
+        //  Next repetition, one mean period after the last sample
+        const double duration = m_data(1, m_data.cols() - 1) - m_data(1, 0);
+        m_offset += duration + duration/std::max<Eigen::Index>(1, m_data.cols() - 1);
+        m_next_column = 0;
+    }
+
+    t_time = m_data(1, m_next_column) - m_data(1, 0) + m_offset;
+
+    if(m_device == Device::SHAPE_SENSING)
+        writeShapeSensingFrame(m_next_column, t_frame);
+    else
+        writeIllumiSenseFrame(m_next_column, t_frame);
+
+    m_next_column++;
+
+    return true;
+}
+
+
+void RecordedSamplesReplay::reset()
+{
+    m_next_column = 0;
+    m_offset = 0;
+}
+
+
+
+
+void RecordedSamplesReplay::writeShapeSensingFrame(const Eigen::Index t_column,
+                                                   std::vector<char> &t_frame) const
+{
+    const auto column = m_data.col(t_column);
+
+    const int num_sensors = static_cast<int>(column(2));
+    const int num_curvature_points = std::max(0, m_num_curvature_points);
+
+    beginFrame(t_frame);
+
+    appendText(t_frame, "2000/01/01");
+    appendClock(t_frame, column(1));
+
+    appendInteger(t_frame, static_cast<std::int64_t>(column(0)));
+    appendInteger(t_frame, 4*num_sensors);
+
+    //  The wavelengths are not recorded, the channels only carry the number of curvature points
+    for(int i=0; i<4*num_sensors; i++){
+        appendInteger(t_frame, i + 1);
+        appendInteger(t_frame, num_curvature_points);
+
+        for(int k=0; k<4; k++)
+            appendInteger(t_frame, 0);
+
+        for(int j=0; j<2*num_curvature_points; j++)
+            appendDecimal(t_frame, 0, 1);
+    }
+
+
+    //  Per sensor: the quantities of data_order.sensors_data, num_shape_points rows each
+    Eigen::Index row = 3 + num_sensors;
+
+    for(int i=0; i<num_sensors; i++){
+        const int num_shape_points = static_cast<int>(column(3 + i));
+
+        //  First row of every quantity, -1 if not recorded
+        std::array<Eigen::Index, SENSOR_DATA_COUNT> first_row;
+        first_row.fill(-1);
+        for(std::size_t k=0; k<m_sensors_data.size(); k++)
+            first_row[m_sensors_data[k]] = row + static_cast<Eigen::Index>(k)*num_shape_points;
+        row += static_cast<Eigen::Index>(m_sensors_data.size())*num_shape_points;
+
+        const int num_curvature_rows = first_row[CURVATURE] >= 0 ? std::min(num_curvature_points, num_shape_points) : 0;
+        const int num_angle_rows = first_row[CURVATURE_ANGLE] >= 0 ? std::min(num_curvature_points, num_shape_points) : 0;
+
+        //  1/m to 1/cm
+        appendText(t_frame, "Curvature [1/cm]");
+        for(int j=0; j<num_curvature_points; j++)
+            appendDecimal(t_frame, j < num_curvature_rows ? 0.01*column(first_row[CURVATURE] + j) : 0, 8);
+
+        appendText(t_frame, "Curvature angle [rad]");
+        for(int j=0; j<num_curvature_points; j++)
+            appendDecimal(t_frame, j < num_angle_rows ? column(first_row[CURVATURE_ANGLE] + j) : 0, 6);
+
+        //  m to cm
+        const char *axes[3] = { "Shape x [cm]", "Shape y [cm]", "Shape z [cm]" };
+        for(int k=0; k<3; k++){
+            appendText(t_frame, axes[k]);
+            appendInteger(t_frame, num_shape_points);
+            for(int j=0; j<num_shape_points; j++)
+                appendDecimal(t_frame, 100*column(first_row[X_POSITIONS + k] + j), 6);
+        }
+    }
+
+    endFrame(t_frame);
+}
+
+
+void RecordedSamplesReplay::writeIllumiSenseFrame(const Eigen::Index t_column,
+                                                  std::vector<char> &t_frame) const
+{
+    const auto column = m_data.col(t_column);
+
+    const int num_channels = static_cast<int>(column(2));
+
+    beginFrame(t_frame);
+
+    appendText(t_frame, "2000/01/01");
+    appendClock(t_frame, column(1));
+
+    appendInteger(t_frame, static_cast<std::int64_t>(column(0)));
+    appendInteger(t_frame, num_channels);
+
+    //  Per channel: number and 4 error statuses, then wavelengths, powers and strains, num_gratings rows each
+    Eigen::Index row = 3 + num_channels;
+    int total_gratings = 0;
+
+    for(int i=0; i<num_channels; i++){
+        const int num_gratings = static_cast<int>(column(3 + i));
+        total_gratings += num_gratings;
+
+        appendInteger(t_frame, static_cast<std::int64_t>(column(row++)));
+        appendInteger(t_frame, num_gratings);
+
+        for(int k=0; k<4; k++)
+            appendInteger(t_frame, static_cast<std::int64_t>(column(row++)));
+
+        for(int j=0; j<num_gratings; j++)
+            appendDecimal(t_frame, column(row++), 6);
+
+        for(int j=0; j<num_gratings; j++)
+            appendDecimal(t_frame, column(row++), 3);
+
+        //  The strains come after all the channels
+        row += num_gratings;
+    }
+
+
+    appendInteger(t_frame, total_gratings);
+
+    row = 3 + num_channels;
+    for(int i=0; i<num_channels; i++){
+        const int num_gratings = static_cast<int>(column(3 + i));
+
+        row += 5 + 2*num_gratings;
+        for(int j=0; j<num_gratings; j++)
+            appendDecimal(t_frame, column(row++), 4);
+    }
+
+    endFrame(t_frame);
+}
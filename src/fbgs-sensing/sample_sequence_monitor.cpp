@@ -0,0 +1,119 @@
+/*
+This code implements the online detection of the samples lost by the acquisition
+*/
+
+#include "fbgs-sensing/sample_sequence_monitor.h"
+
+
+void SampleSequenceMonitor::reset()
+{
+    m_started = false;
+    m_received_window.reset();
+
+    m_received.store(0, std::memory_order_relaxed);
+    m_dropped.store(0, std::memory_order_relaxed);
+    m_gaps.store(0, std::memory_order_relaxed);
+    m_duplicates.store(0, std::memory_order_relaxed);
+    m_reordered.store(0, std::memory_order_relaxed);
+    m_restarts.store(0, std::memory_order_relaxed);
+    m_largest_gap.store(0, std::memory_order_relaxed);
+    m_last_sample_number.store(-1, std::memory_order_relaxed);
+}
+
+
+
+unsigned int SampleSequenceMonitor::update(const std::int64_t t_sample_number)
+{
+    //  Single writer: plain loads and stores, the atomics are only there for the readers
+    m_received.store(m_received.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    const std::int64_t last = m_last_sample_number.load(std::memory_order_relaxed);
+
+    if(not m_started){
+        restart(t_sample_number);
+        m_started = true;
+        return 0;
+    }
+
+
+    const std::int64_t step = t_sample_number - last;
+
+    if(step == 1){
+        m_received_window.set(index(t_sample_number));
+        m_last_sample_number.store(t_sample_number, std::memory_order_relaxed);
+        return 0;
+    }
+
+    if(step > 1){
+        const std::uint64_t missed = static_cast<std::uint64_t>(step - 1);
+
+        //  The missing samples are forgotten, in case they arrive later
+        if(step > REORDER_WINDOW)
+            m_received_window.reset();
+        else
+            for(std::int64_t n=last+1; n<t_sample_number; n++)
+                m_received_window.reset(index(n));
+        m_received_window.set(index(t_sample_number));
+
+        m_dropped.store(m_dropped.load(std::memory_order_relaxed) + missed, std::memory_order_relaxed);
+        m_gaps.store(m_gaps.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if(missed > m_largest_gap.load(std::memory_order_relaxed))
+            m_largest_gap.store(missed, std::memory_order_relaxed);
+
+        m_last_sample_number.store(t_sample_number, std::memory_order_relaxed);
+        return static_cast<unsigned int>(missed);
+    }
+
+    const bool in_window = -step < REORDER_WINDOW and t_sample_number >= m_first_sample_number;
+
+    if(in_window and m_received_window.test(index(t_sample_number))){
+        m_duplicates.store(m_duplicates.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    //  A late sample was counted as dropped when the gap appeared
+    if(in_window){
+        m_received_window.set(index(t_sample_number));
+        m_reordered.store(m_reordered.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        const std::uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+        if(dropped > 0)
+            m_dropped.store(dropped - 1, std::memory_order_relaxed);
+
+        return 0;
+    }
+
+    m_restarts.store(m_restarts.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    restart(t_sample_number);
+
+    return 0;
+}
+
+
+void SampleSequenceMonitor::restart(const std::int64_t t_sample_number)
+{
+    m_first_sample_number = t_sample_number;
+
+    m_received_window.reset();
+    m_received_window.set(index(t_sample_number));
+
+    m_last_sample_number.store(t_sample_number, std::memory_order_relaxed);
+}
+
+
+
+SampleSequenceMonitor::Statistics SampleSequenceMonitor::getStatistics() const
+{
+    Statistics statistics;
+
+    statistics.received = m_received.load(std::memory_order_relaxed);
+    statistics.dropped = m_dropped.load(std::memory_order_relaxed);
+    statistics.gaps = m_gaps.load(std::memory_order_relaxed);
+    statistics.duplicates = m_duplicates.load(std::memory_order_relaxed);
+    statistics.reordered = m_reordered.load(std::memory_order_relaxed);
+    statistics.restarts = m_restarts.load(std::memory_order_relaxed);
+    statistics.largest_gap = m_largest_gap.load(std::memory_order_relaxed);
+    statistics.last_sample_number = m_last_sample_number.load(std::memory_order_relaxed);
+
+    return statistics;
+}
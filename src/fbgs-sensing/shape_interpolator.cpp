@@ -0,0 +1,214 @@
+/*
+This code implements the interpolation of the shapes at arbitrary time instants
+*/
+
+#include "fbgs-sensing/shape_interpolator.h"
+
+
+ShapeInterpolator::ShapeInterpolator(const unsigned int t_history,
+                                     const unsigned int t_guard) :
+    m_history(std::max(t_history, 4u)),
+    m_capacity(m_history + std::max(t_guard, 1u))
+{
+    m_slots = std::make_unique<Slot[]>(m_capacity);
+}
+
+
+
+void ShapeInterpolator::allocate(const std::vector<Eigen::Index> &t_num_points)
+{
+    m_num_points = t_num_points;
+
+    for(unsigned int i=0; i<m_capacity; i++){
+        m_slots[i].shapes.clear();
+        for(const auto num_points : m_num_points)
+            m_slots[i].shapes.push_back(Eigen::MatrixXd::Zero(num_points, 3));
+
+        m_slots[i].tip_orientations.assign(m_num_points.size(), Eigen::Quaterniond::Identity());
+    }
+}
+
+
+Eigen::Quaterniond ShapeInterpolator::tipOrientation(const Eigen::MatrixXd &t_shape) const
+{
+    const Eigen::Index n = t_shape.rows();
+    if(n < 2)
+        return Eigen::Quaterniond::Identity();
+
+    const Eigen::Vector3d tangent = (t_shape.row(n-1) - t_shape.row(n-2)).transpose();
+    if(tangent.norm() == 0)
+        return Eigen::Quaterniond::Identity();
+
+    return Eigen::Quaterniond::FromTwoVectors(m_reference_direction, tangent);
+}
+
+
+
+
+bool ShapeInterpolator::isValid(const std::uint64_t t_index) const
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return slot(t_index).sequence.load(std::memory_order_relaxed) == publishedSequence(t_index);
+}
+
+
+bool ShapeInterpolator::findBracket(const TimePoint &t_time, Bracket &t_bracket) const
+{
+    const std::uint64_t count = m_count.load(std::memory_order_acquire);
+    if(count == 0)
+        return false;
+
+    const std::uint64_t newest = count - 1;
+    const std::uint64_t oldest = count > m_history ? count - m_history : 0;
+
+    //  Out of the history, hold the closest sample
+    if(t_time >= slot(newest).time_stamp or newest == oldest){
+        t_bracket = { newest, newest, 0.0, t_time == slot(newest).time_stamp };
+        return true;
+    }
+    if(t_time < slot(oldest).time_stamp){
+        t_bracket = { oldest, oldest, 0.0, false };
+        return true;
+    }
+
+    //  Walk back from the newest sample, the slots are validated after the copy
+    std::uint64_t after = newest;
+    while(after > oldest + 1 and slot(after - 1).time_stamp >= t_time)
+        after--;
+
+    const std::uint64_t before = after - 1;
+    const double span = std::chrono::duration<double>(slot(after).time_stamp - slot(before).time_stamp).count();
+    const double u = span > 0 ? std::chrono::duration<double>(t_time - slot(before).time_stamp).count() / span : 0.0;
+
+    t_bracket = { before, after, u, true };
+    return true;
+}
+
+
+
+
+bool ShapeInterpolator::shapeAt(const unsigned int t_sensor,
+                                const TimePoint &t_time,
+                                Eigen::MatrixXd &t_shape,
+                                const Interpolation t_interpolation) const
+{
+    if(m_count.load(std::memory_order_acquire) == 0 or t_sensor >= m_num_points.size())
+        return false;
+
+    Bracket bracket;
+    if(not findBracket(t_time, bracket))
+        return false;
+
+    const std::uint64_t before = bracket.before;
+    const std::uint64_t after = bracket.after;
+
+    const std::uint64_t first_sequence = slot(before).sequence.load(std::memory_order_acquire);
+    const std::uint64_t last_sequence = slot(after).sequence.load(std::memory_order_acquire);
+    if(first_sequence != publishedSequence(before) or last_sequence != publishedSequence(after))
+        return false;
+
+    const Eigen::MatrixXd &P0 = slot(before).shapes[t_sensor];
+    const Eigen::MatrixXd &P1 = slot(after).shapes[t_sensor];
+
+    t_shape.resize(m_num_points[t_sensor], 3);
+
+
+    if(bracket.before == bracket.after){
+        t_shape = P1;
+        return bracket.inside and isValid(after);
+    }
+
+
+    const double u = bracket.u;
+
+    if(t_interpolation == Interpolation::LINEAR){
+        t_shape = (1.0 - u)*P0 + u*P1;
+        return isValid(before) and isValid(after);
+    }
+
+
+    //  Cubic Hermite with finite differences tangents (Catmull-Rom on non uniform times).
+    //  Next to the ends of the history the tangents become one sided.
+    const std::uint64_t count = m_count.load(std::memory_order_acquire);
+    const std::uint64_t oldest = count > m_history ? count - m_history : 0;
+
+    const std::uint64_t previous = before > oldest ? before - 1 : before;
+    const std::uint64_t next = after + 1 < count ? after + 1 : after;
+
+    const double t0 = 0.0;
+    const double t1 = std::chrono::duration<double>(slot(after).time_stamp - slot(before).time_stamp).count();
+    const double tp = std::chrono::duration<double>(slot(previous).time_stamp - slot(before).time_stamp).count();
+    const double tn = std::chrono::duration<double>(slot(next).time_stamp - slot(before).time_stamp).count();
+
+    const double u2 = u*u;
+    const double u3 = u2*u;
+    const double h00 = 2*u3 - 3*u2 + 1;
+    const double h10 = u3 - 2*u2 + u;
+    const double h01 = -2*u3 + 3*u2;
+    const double h11 = u3 - u2;
+
+    //  Tangents as combination of the samples, m0 = (P1 - Pp)/(t1 - tp), m1 = (Pn - P0)/(tn - t0),
+    //  scaled by the interval length so that the result is a weighted sum of at most four shapes
+    const double s0 = t1 / (t1 - tp);
+    const double s1 = t1 / (tn - t0);
+
+    const double w_previous = -h10*s0;
+    const double w_before = h00 + (previous == before ? -h10*s0 : 0.0) - h11*s1;
+    const double w_after = h01 + h10*s0 + (next == after ? h11*s1 : 0.0);
+    const double w_next = next == after ? 0.0 : h11*s1;
+
+    const Eigen::MatrixXd &Pp = slot(previous).shapes[t_sensor];
+    const Eigen::MatrixXd &Pn = slot(next).shapes[t_sensor];
+
+    if(previous == before)
+        t_shape = w_before*P0 + w_after*P1 + w_next*Pn;
+    else
+        t_shape = w_previous*Pp + w_before*P0 + w_after*P1 + w_next*Pn;
+
+    return isValid(previous) and isValid(before) and isValid(after) and isValid(next);
+}
+
+
+
+
+bool ShapeInterpolator::tipOrientationAt(const unsigned int t_sensor,
+                                         const TimePoint &t_time,
+                                         Eigen::Quaterniond &t_orientation) const
+{
+    if(m_count.load(std::memory_order_acquire) == 0 or t_sensor >= m_num_points.size())
+        return false;
+
+    Bracket bracket;
+    if(not findBracket(t_time, bracket))
+        return false;
+
+    if(slot(bracket.before).sequence.load(std::memory_order_acquire) != publishedSequence(bracket.before) or
+       slot(bracket.after).sequence.load(std::memory_order_acquire) != publishedSequence(bracket.after))
+        return false;
+
+    const Eigen::Quaterniond q0 = slot(bracket.before).tip_orientations[t_sensor];
+    const Eigen::Quaterniond q1 = slot(bracket.after).tip_orientations[t_sensor];
+
+    t_orientation = q0.slerp(bracket.u, q1);
+
+    return bracket.inside and isValid(bracket.before) and isValid(bracket.after);
+}
+
+
+
+
+bool ShapeInterpolator::getTimeRange(TimePoint &t_oldest, TimePoint &t_newest) const
+{
+    const std::uint64_t count = m_count.load(std::memory_order_acquire);
+    if(count == 0)
+        return false;
+
+    const std::uint64_t newest = count - 1;
+    const std::uint64_t oldest = count > m_history ? count - m_history : 0;
+
+    t_oldest = slot(oldest).time_stamp;
+    t_newest = slot(newest).time_stamp;
+
+    return isValid(oldest) and isValid(newest);
+}
@@ -0,0 +1,145 @@
+/*
+This code implements a predictor compensating the latency of the shape measurements
+*/
+
+#include "fbgs-sensing/shape_predictor.h"
+
+
+ShapePredictor::ShapePredictor(const double t_process_noise,
+                               const double t_measurement_noise,
+                               const std::chrono::microseconds t_latency) :
+    m_process_noise(t_process_noise),
+    m_measurement_noise(t_measurement_noise),
+    m_latency(t_latency)
+{
+    m_covariance.setIdentity();
+    m_gain.setZero();
+}
+
+
+void ShapePredictor::setLatency(const std::chrono::microseconds t_latency)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_latency = t_latency;
+}
+
+
+void ShapePredictor::reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_filters.clear();
+    m_initialised = false;
+}
+
+
+
+
+bool ShapePredictor::predictShape(const unsigned int t_sensor,
+                                  const TimePoint &t_time,
+                                  Eigen::MatrixXd &t_shape) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(not m_initialised or t_sensor >= m_filters.size())
+        return false;
+
+    const double dt = horizon(t_time);
+    const Filter &filter = m_filters[t_sensor];
+
+    t_shape.resize(filter.position.rows(), 3);
+    t_shape = filter.position + dt*filter.velocity + (0.5*dt*dt)*filter.acceleration;
+
+    return true;
+}
+
+
+bool ShapePredictor::predictTip(const unsigned int t_sensor,
+                                const TimePoint &t_time,
+                                Eigen::Vector3d &t_tip) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(not m_initialised or t_sensor >= m_filters.size())
+        return false;
+
+    const Filter &filter = m_filters[t_sensor];
+    const Eigen::Index tip = filter.position.rows() - 1;
+    if(tip < 0)
+        return false;
+
+    const double dt = horizon(t_time);
+
+    t_tip = filter.position.row(tip).transpose()
+            + dt*filter.velocity.row(tip).transpose()
+            + (0.5*dt*dt)*filter.acceleration.row(tip).transpose();
+
+    return true;
+}
+
+
+double ShapePredictor::getSampleAge(const TimePoint &t_time) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return horizon(t_time);
+}
+
+
+
+
+void ShapePredictor::initialiseFilter(Filter &t_filter, const Eigen::MatrixXd &t_shape) const
+{
+    t_filter.position = t_shape;
+    t_filter.velocity = Eigen::MatrixXd::Zero(t_shape.rows(), t_shape.cols());
+    t_filter.acceleration = Eigen::MatrixXd::Zero(t_shape.rows(), t_shape.cols());
+}
+
+
+void ShapePredictor::predictCovariance(const double t_dt)
+{
+    const double dt2 = t_dt*t_dt;
+    const double dt3 = dt2*t_dt;
+
+    Eigen::Matrix3d F;
+    F << 1, t_dt, 0.5*dt2,
+         0,    1,    t_dt,
+         0,    0,       1;
+
+    //  Continuous white jerk noise
+    Eigen::Matrix3d Q;
+    Q << dt3*dt2/20, dt2*dt2/8, dt3/6,
+         dt2*dt2/8,  dt3/3,     dt2/2,
+         dt3/6,      dt2/2,     t_dt;
+    Q *= m_process_noise;
+
+    m_covariance = F*m_covariance*F.transpose() + Q;
+
+    //  Only the position is measured
+    m_gain = m_covariance.col(0) / (m_covariance(0, 0) + m_measurement_noise);
+
+    m_covariance -= m_gain*m_covariance.row(0);
+}
+
+
+void ShapePredictor::correctFilter(Filter &t_filter,
+                                   const double t_dt,
+                                   const Eigen::MatrixXd &t_shape) const
+{
+    //  Predict, the position first as it needs the old velocity
+    t_filter.position += t_dt*t_filter.velocity + (0.5*t_dt*t_dt)*t_filter.acceleration;
+    t_filter.velocity += t_dt*t_filter.acceleration;
+
+    //  Correct all the coordinates with the shared gain, the position goes last
+    //  so that the three corrections use the same residual
+    t_filter.acceleration += m_gain(2)*(t_shape - t_filter.position);
+    t_filter.velocity += m_gain(1)*(t_shape - t_filter.position);
+    t_filter.position += m_gain(0)*(t_shape - t_filter.position);
+}
+
+
+double ShapePredictor::horizon(const TimePoint &t_time) const
+{
+    return std::chrono::duration<double>(t_time - m_measurement_time).count();
+}
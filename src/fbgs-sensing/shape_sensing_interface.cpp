@@ -4,6 +4,9 @@ Copyright (C) 2022 Sven Lilge, Continuum Robotics Laboratory, University of Toro
 */
 
 #include "fbgs-sensing/shape_sensing_interface.h"
+#include "fbgs-sensing/frame.h"
+
+#include <boost/asio/redirect_error.hpp>
 
 #include <chrono>
 
@@ -22,26 +25,35 @@ using namespace std::chrono;
 //}
 
 
-ShapeSensingInterface::ShapeSensingInterface(std::shared_ptr<const bool> t_stop_demos,
-                        std::shared_ptr<const bool> t_start_recording,
-                        const double t_frequency) :
-    m_resolver(m_io_context),
-    m_socket(m_io_context),
+ShapeSensingInterface::ShapeSensingInterface(std::shared_ptr<AcquisitionControl> t_control,
+                                             const double t_frequency,
+                                             std::shared_ptr<boost::asio::io_context> t_io_context) :
+    m_io_context( t_io_context ? t_io_context : std::make_shared<boost::asio::io_context>() ),
+    m_resolver(*m_io_context),
+    m_socket(*m_io_context),
     m_frequency(t_frequency),
-    m_stop_demos( t_stop_demos ),
-    m_start_recording( t_start_recording )
+    m_control( t_control ? t_control : std::make_shared<AcquisitionControl>() ),
+    m_connection_supervisor(m_control)
 {
     m_connected = false;
 
+    m_control_event_fd = m_control->addListener();
+
 
     m_samples_stack.clear();
 }
 
 ShapeSensingInterface::~ShapeSensingInterface()
 {
+    //  Stop the acquisition thread before closing the socket it is using
+    if(thread.joinable() or m_real_time_thread_running){
+        m_control->shutdown();
+        joinRecordingThread();
+    }
+
     m_socket.close();
 
-    thread.join();
+    m_control->removeListener(m_control_event_fd);
 }
 
 bool ShapeSensingInterface::connect()
@@ -58,8 +70,14 @@ bool ShapeSensingInterface::connect()
 		
         std::cout << "Establishing connection to " << ep << "... \n";
 		
-        //Connect to socket and open connection
-        boost::asio::connect(m_socket, endpoints);
+        //Connect to socket and open connection, retried with backoff when supervised
+        if(m_connection_supervisor.isEnabled()){
+            if(not m_connection_supervisor.connect(m_socket, m_ip_address, m_port_number)
+               and not m_connection_supervisor.reconnect(m_socket, m_ip_address, m_port_number))
+                return false;
+        }
+        else
+            boost::asio::connect(m_socket, endpoints);
 		
         std::cout << "\n\n\n            Connected!\n\n\n" << std::endl << std::endl;
 
@@ -72,7 +90,7 @@ bool ShapeSensingInterface::connect()
         static int pos=0;
         char cursor[4]={'/','-','\\','|'};
         while(m_socket.available() < 4
-               and not *m_stop_demos){
+               and not m_control->isShutdown()){
             std::cout << "Waiting for Shape Sensing data stream...  " << cursor[pos] << "\r";
             pos = (pos+1) % 4;
             std::cout.flush();
@@ -115,13 +133,39 @@ bool ShapeSensingInterface::nextSampleReady()
 
 
 
+void ShapeSensingInterface::startRecordinLoop()
+{
+    if(m_real_time_config.enabled){
+        configureRealTimeThread(m_real_time_config, "fbgs_shape_sensing", m_real_time_thread.parameters_);
+
+        if(m_real_time_thread.create_realtime_thread(&ShapeSensingInterface::recordingLoopHelper, this) == 0){
+            m_real_time_thread_running = true;
+            return;
+        }
+
+        std::cerr << "[FBGS] could not create the real time thread, falling back to a normal one" << std::endl;
+    }
+
+    thread = std::thread([&](){recordingLoop();});
+
+}
+
+
+
+
 void ShapeSensingInterface::recordingLoop()
 {
+    if(m_real_time_config.enabled)
+        prefaultMemory(m_real_time_config);
+
     Sample sample;
 
+    //  Only the frames queued before the loop: with a stream faster than the parsing, the dump would never end
     unsigned int dumped = 0;
-    while(nextSampleReady()){
+    std::size_t queued = m_socket.available();
+    while(queued > 0 and nextSampleReady() and not m_control->isShutdown()){
         readNextSample(sample);
+        queued -= std::min(queued, FRAME_HEADER_SIZE + m_frame.size());
         dumped++;
     }
 
@@ -129,19 +173,230 @@ void ShapeSensingInterface::recordingLoop()
 
 
 
+    const std::chrono::milliseconds stall_timeout = m_connection_supervisor.getPolicy().stall_timeout;
+    const int wait_timeout = m_connection_supervisor.isEnabled() ? static_cast<int>(stall_timeout.count()) : -1;
+    bool reconnected = false;
+
+    m_socket_waiter.configureSocket(m_socket.native_handle(), FRAME_HEADER_SIZE);
+
     m_start = std::chrono::high_resolution_clock::now();
-    while(not *m_stop_demos){
+    m_frame_time_stamp = m_start;
+    while(not m_control->isShutdown()){
+
+        //  Connection lost, the recording continues after the reconnection
+        if(not m_connected){
+            if(not m_connection_supervisor.isEnabled()
+               or not m_connection_supervisor.reconnect(m_socket, m_ip_address, m_port_number)){
+                if(not m_control->isShutdown())
+                    std::cerr << "[FBGS] connection closed, stopping the acquisition" << std::endl;
+                break;
+            }
+
+            m_socket_waiter.configureSocket(m_socket.native_handle(), FRAME_HEADER_SIZE);
+
+            m_connected = true;
+            reconnected = true;
+            m_frame_time_stamp = std::chrono::high_resolution_clock::now();
+        }
+
+        //  Wait, as set by the wait policy, until data arrives or the state changes. The frames queued meanwhile are then read back to back
+        if(not nextSampleReady()){
+            if(not m_socket_waiter.wait(m_socket.native_handle(), m_control_event_fd, wait_timeout)){
+                if(m_connection_supervisor.isEnabled()
+                   and std::chrono::high_resolution_clock::now() - m_frame_time_stamp > stall_timeout){
+                    std::cerr << "[FBGS] no data for " << stall_timeout.count() << " ms, the connection is lost" << std::endl;
+                    m_connected = false;
+                }
+                continue;
+            }
+
+            //  Readable with nothing to read means that the connection is closed
+            if(m_socket.available() == 0){
+                m_connected = false;
+                continue;
+            }
+        }
 
         if(nextSampleReady()){
 
-            readNextSample(sample);
+            if(m_raw_capture){
+                if(readFrame())
+                    captureFrame();
+
+                reconnected = false;
+            }
+            else if(readNextSample(sample)){
+                //  The gap is marked by the jump of the sample number
+                if(reconnected){
+                    std::cerr << "[FBGS] acquisition resumed at sample " << sample.sample_number << ", "
+                              << sample.missed_since_previous << " samples lost" << std::endl;
+                    reconnected = false;
+                }
+
+                storeSample(sample);
+            }
+        }
+    }
+}
+
+
+
+
+void ShapeSensingInterface::startAsyncAcquisition()
+{
+    m_start = std::chrono::high_resolution_clock::now();
+
+    asyncReadFrame();
+}
+
+
+void ShapeSensingInterface::asyncReadFrame()
+{
+    boost::asio::async_read(m_socket, boost::asio::buffer(m_async_header),
+                            [this](const boost::system::error_code &error, std::size_t){
+        if(error or m_control->isShutdown()){
+            if(error)
+                onAsyncReadError(error);
+            return;
+        }
+
+        m_readable_time_stamp = std::chrono::high_resolution_clock::now();
+
+        const std::uint32_t frame_size = decodeFrameSize(m_async_header.data());
+        if(not isValidFrameSize(frame_size)){
+            onAsyncReadError(boost::asio::error::message_size);
+            return;
+        }
+
+        m_frame.resize(frame_size);
+
+        boost::asio::async_read(m_socket, boost::asio::buffer(m_frame),
+                                [this](const boost::system::error_code &error, std::size_t){
+            if(error){
+                onAsyncReadError(error);
+                return;
+            }
+
+            m_frame_time_stamp = std::chrono::high_resolution_clock::now();
+
+            if(m_raw_capture)
+                captureFrame();
+            else if(parseFrame(m_frame.data(), m_frame.size(), m_async_sample)){
+                m_async_sample.time_stamp = m_frame_time_stamp;
+                m_async_sample.readable_time_stamp = m_readable_time_stamp;
+                m_async_sample.parsed_time_stamp = std::chrono::high_resolution_clock::now();
+
+                processSample(m_async_sample);
+                storeSample(m_async_sample);
+            }
+
+            asyncReadFrame();
+        });
+    });
+}
+
+
+
+boost::asio::awaitable<std::optional<ShapeSensingInterface::Sample>> ShapeSensingInterface::next()
+{
+    Sample sample;
+
+    const bool received = co_await next(sample);
+    if(received)
+        co_return sample;
+
+    co_return std::nullopt;
+}
 
-            if(*m_start_recording){
-                m_samples_stack.push_back( sample );
 
+boost::asio::awaitable<bool> ShapeSensingInterface::next(Sample &t_sample)
+{
+    if(m_start == std::chrono::high_resolution_clock::time_point())
+        m_start = std::chrono::high_resolution_clock::now();
+
+    while(not m_control->isShutdown()){
+        boost::system::error_code error;
+
+        co_await boost::asio::async_read(m_socket, boost::asio::buffer(m_async_header),
+                                         boost::asio::redirect_error(boost::asio::use_awaitable, error));
+        if(not error){
+            m_readable_time_stamp = std::chrono::high_resolution_clock::now();
+
+            const std::uint32_t frame_size = decodeFrameSize(m_async_header.data());
+            if(isValidFrameSize(frame_size)){
+                m_frame.resize(frame_size);
+
+                co_await boost::asio::async_read(m_socket, boost::asio::buffer(m_frame),
+                                                 boost::asio::redirect_error(boost::asio::use_awaitable, error));
             }
+            else
+                error = boost::asio::error::message_size;
+        }
+
+        if(error){
+            if(error == boost::asio::error::operation_aborted or m_control->isShutdown())
+                co_return false;
+
+            std::cerr << "[FBGS] " << error.message() << std::endl;
+
+            if(not m_connection_supervisor.isEnabled())
+                co_return false;
+
+            const bool reconnected = co_await awaitReconnection();
+            if(not reconnected)
+                co_return false;
+
+            continue;
         }
+
+        m_frame_time_stamp = std::chrono::high_resolution_clock::now();
+
+        if(m_raw_capture)
+            captureFrame();
+
+        if(not parseFrame(m_frame.data(), m_frame.size(), t_sample))
+            continue;
+
+        t_sample.time_stamp = m_frame_time_stamp;
+        t_sample.readable_time_stamp = m_readable_time_stamp;
+        t_sample.parsed_time_stamp = std::chrono::high_resolution_clock::now();
+
+        processSample(t_sample);
+        storeSample(t_sample);
+
+        co_return true;
     }
+
+    co_return false;
+}
+
+
+boost::asio::awaitable<bool> ShapeSensingInterface::awaitReconnection()
+{
+    //  The handler of use_awaitable is move only, std::function needs a copyable one
+    co_return co_await boost::asio::async_initiate<const boost::asio::use_awaitable_t<>, void(bool)>(
+        [this](auto t_handler){
+            auto handler = std::make_shared<decltype(t_handler)>(std::move(t_handler));
+
+            m_connection_supervisor.asyncReconnect(m_socket, m_ip_address, m_port_number, [handler](const bool t_connected){
+                (*handler)(t_connected);
+            });
+        }, boost::asio::use_awaitable);
+}
+
+
+void ShapeSensingInterface::onAsyncReadError(const boost::system::error_code &t_error)
+{
+    if(t_error == boost::asio::error::operation_aborted or m_control->isShutdown())
+        return;
+
+    std::cerr << "[FBGS] " << t_error.message() << std::endl;
+
+    if(m_connection_supervisor.isEnabled())
+        m_connection_supervisor.asyncReconnect(m_socket, m_ip_address, m_port_number, [this](const bool t_connected){
+            if(t_connected)
+                asyncReadFrame();
+        });
 }
 
 
@@ -153,34 +408,87 @@ bool ShapeSensingInterface::readNextSample(Sample &sample)
     if((m_socket.available() < 4))
         return false;
 
+    if(not readFrame())
+        return false;
+
+    if(not parseFrame(m_frame.data(), m_frame.size(), sample))
+        return false;
+
+    sample.time_stamp = m_frame_time_stamp;
+    sample.readable_time_stamp = m_readable_time_stamp;
+    sample.parsed_time_stamp = std::chrono::high_resolution_clock::now();
+
+    processSample(sample);
+
+    return true;
+
+}
+
+
+
+bool ShapeSensingInterface::readFrame()
+{
+    FBGS_INSTRUMENT_STAGE(READ);
 
     try {
-        char buffer[4];
+        m_readable_time_stamp = std::chrono::high_resolution_clock::now();
+
+        char buffer[FRAME_HEADER_SIZE];
         //First read the first 4 bytes to figure out the size of the following ASCII string
-        [[maybe_unused]] size_t size_read = boost::asio::read(m_socket,boost::asio::buffer(&buffer,4));
+        boost::asio::read(m_socket,boost::asio::buffer(buffer, FRAME_HEADER_SIZE));
+
+        const std::uint32_t frame_size = decodeFrameSize(buffer);
+        if(not isValidFrameSize(frame_size)){
+            std::cerr << "[FBGS] invalid frame size " << frame_size << ", the stream is desynchronised" << std::endl;
+            m_connected = false;
+            return false;
+        }
+
+        //Now read the remaining ASCII string of the current data package, the buffer is reused
+        m_frame.resize(frame_size);
+
+        //  A peer dying in the middle of a frame would block the read forever
+        if(m_connection_supervisor.isEnabled() and not m_connection_supervisor.waitForBytes(m_socket, m_frame.size())){
+            m_connected = false;
+            return false;
+        }
 
-        //Convert the received bytes to signed integer
-        int size = int((unsigned char)(buffer[0]) << 24 |
-                       (unsigned char)(buffer[1]) << 16 |
-                       (unsigned char)(buffer[2]) << 8 |
-                       (unsigned char)(buffer[3]));
+        boost::asio::read(m_socket,boost::asio::buffer(m_frame));
 
+        m_frame_time_stamp = std::chrono::high_resolution_clock::now();
+    }
+    catch(std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        m_connected = false;
+        return false;
+    }
 
-        boost::asio::streambuf data;
-        //Now read the remaining ASCII string of the current data package
-        size_read = boost::asio::read(m_socket,data,boost::asio::transfer_exactly(size));
+    return true;
+}
 
-//            rt_printf("transfer_exactly");
 
-        std::string data_string;
+
+bool ShapeSensingInterface::parseFrame(const char *t_data,
+                                       const std::size_t t_size,
+                                       Sample &sample) const
+{
+    FBGS_INSTRUMENT_STAGE(PARSE);
+
+
+    try {
+        FrameBuffer data(t_data, t_size);
+
+        //  Reused by the following frames of the thread, the fields longer than the small string buffer would
+        //  otherwise allocate at every frame
+        thread_local std::string data_string;
         std::istream is(&data);
 
 
-        //Create new, empty sample and set the passed sample to it
-        Sample new_sample;
-        sample = new_sample;
+        //  The channels (and sensors) of the passed sample are reused: their buffers are only reallocated when
+        //  the topology changes
+        sample.missed_since_previous = 0;
 
-        sample.time_stamp = std::chrono::high_resolution_clock::now();
 
         //Skip first two entries (date and time)
         getline(is,data_string, '\t');
@@ -199,7 +507,9 @@ bool ShapeSensingInterface::readNextSample(Sample &sample)
         //Now we run through all channels
         for(int i = 0; i < sample.num_channels; i++)
         {
-            ShapeSensingInterface::Channel channel;
+            if(i >= static_cast<int>(sample.channels.size()))
+                sample.channels.emplace_back();
+            ShapeSensingInterface::Channel &channel = sample.channels[i];
 
             //Next string is channel number
             getline(is,data_string, '\t');
@@ -235,11 +545,10 @@ bool ShapeSensingInterface::readNextSample(Sample &sample)
                 channel.peak_powers(j) = std::stod(data_string);
             }
 
-            sample.channels.push_back(channel);
-
 //                rt_printf("channel : %i", i);
 
         }
+        sample.channels.resize(sample.num_channels);
 
 
         //Now run through the file to the end
@@ -247,7 +556,9 @@ bool ShapeSensingInterface::readNextSample(Sample &sample)
         int num_sensors = 0;
         while(data_string == "Curvature [1/cm]")
         {
-            ShapeSensingInterface::Sensor sensor;
+            if(num_sensors >= static_cast<int>(sample.sensors.size()))
+                sample.sensors.emplace_back();
+            ShapeSensingInterface::Sensor &sensor = sample.sensors[num_sensors];
             sensor.num_curv_points = sample.channels.at(0 + 4*num_sensors).num_gratings;
 
             //Save kappa (curvature) values
@@ -319,14 +630,13 @@ bool ShapeSensingInterface::readNextSample(Sample &sample)
             //Next entry is either new curvature data (while loop will restart and add new sensor) or new line (no new sensor)
             getline(is,data_string, '\t');
 
-            sample.sensors.push_back(sensor);
-
             num_sensors++;
 
 //                rt_printf("sensor %i", num_sensors);
         }
 
         sample.num_sensors = num_sensors;
+        sample.sensors.resize(num_sensors);
 
 
 
@@ -341,6 +651,243 @@ bool ShapeSensingInterface::readNextSample(Sample &sample)
 
 }
 
+void ShapeSensingInterface::processSample(Sample &sample)
+{
+    FBGS_INSTRUMENT_STAGE(PROCESS);
+
+    sample.missed_since_previous = m_sequence_monitor.update(sample.sample_number);
+
+    if(m_clock_synchronizer)
+        sample.synchronised_time_stamp = m_clock_synchronizer->update(sample.sample_number, sample.time_stamp);
+    else
+        sample.synchronised_time_stamp = sample.time_stamp;
+
+    if(m_strain_converter)
+        m_strain_converter->update(sample.channels);
+
+    if(m_estimate_tip_state)
+        estimateTipStates(sample);
+
+    if(m_shape_predictor)
+        m_shape_predictor->update(sample.synchronised_time_stamp, sample.sensors);
+
+    if(m_shape_interpolator)
+        m_shape_interpolator->push(sample.synchronised_time_stamp, sample.sensors);
+
+    if(m_shared_memory_publisher)
+        publishSample(sample);
+}
+
+
+void ShapeSensingInterface::publishSample(const Sample &sample)
+{
+    //  The layout is derived from the topology of the first sample
+    if(not m_shared_memory_publisher->isCreated()){
+        std::vector<SharedMemoryPublisher::Block> blocks;
+        for(unsigned int i=0; i<sample.channels.size(); i++){
+            const unsigned int n = sample.channels[i].num_gratings;
+            const std::string prefix = "channel" + std::to_string(i);
+            blocks.push_back({prefix + "/wavelengths", n, 1});
+            blocks.push_back({prefix + "/powers", n, 1});
+            blocks.push_back({prefix + "/strains", n, 1});
+        }
+        for(unsigned int j=0; j<sample.sensors.size(); j++){
+            const unsigned int n = sample.sensors[j].num_curv_points;
+            const unsigned int m = sample.sensors[j].num_shape_points;
+            const std::string prefix = "sensor" + std::to_string(j);
+            blocks.push_back({prefix + "/kappa", n, 1});
+            blocks.push_back({prefix + "/phi", n, 1});
+            blocks.push_back({prefix + "/shape", m, 3});
+            blocks.push_back({prefix + "/arc_length", m, 1});
+            blocks.push_back({prefix + "/tip_state", 3, 3});
+        }
+
+        if(not m_shared_memory_publisher->create(blocks)){
+            m_shared_memory_publisher.reset();
+            return;
+        }
+    }
+    else{
+        //  Then only the sizes are checked, without allocations
+        unsigned int b = 0;
+        bool same = m_shared_memory_publisher->getNumberOfBlocks() == 3*sample.channels.size() + 5*sample.sensors.size();
+        for(unsigned int i=0; same and i<sample.channels.size(); i++, b+=3)
+            same = m_shared_memory_publisher->blockSize(b) == static_cast<std::size_t>(sample.channels[i].num_gratings);
+        for(unsigned int j=0; same and j<sample.sensors.size(); j++, b+=5)
+            same = m_shared_memory_publisher->blockSize(b) == static_cast<std::size_t>(sample.sensors[j].num_curv_points)
+                   and m_shared_memory_publisher->blockSize(b+3) == static_cast<std::size_t>(sample.sensors[j].num_shape_points);
+
+        if(not same){
+            std::cerr << "[FBGS] the topology changed, stop publishing to " << m_shared_memory_publisher->getName() << std::endl;
+            m_shared_memory_publisher.reset();
+            return;
+        }
+    }
+
+
+    SharedMemoryPublisher &publisher = *m_shared_memory_publisher;
+    publisher.beginWrite(sample.sample_number,
+                         std::chrono::duration_cast<std::chrono::nanoseconds>(sample.synchronised_time_stamp.time_since_epoch()).count());
+
+    unsigned int b = 0;
+    for(const Channel &channel : sample.channels){
+        publisher.block(b++) = channel.peak_wavelengths;
+        publisher.block(b++) = channel.peak_powers;
+        if(channel.strains.size() == channel.num_gratings)
+            publisher.block(b++) = channel.strains;
+        else
+            publisher.block(b++).setZero();
+    }
+    for(const Sensor &sensor : sample.sensors){
+        publisher.block(b++) = sensor.kappa;
+        publisher.block(b++) = sensor.phi;
+        publisher.block(b++) = sensor.shape;
+        publisher.block(b++) = sensor.arc_length;
+        publisher.block(b++) << sensor.tip_position, sensor.tip_velocity, sensor.tip_acceleration;
+    }
+
+    publisher.endWrite();
+}
+
+
+void ShapeSensingInterface::storeSample(const Sample &sample)
+{
+    FBGS_INSTRUMENT_STAGE(STORE);
+
+    if(m_control->isRecording()){
+        //  The recording continues into the spill file, from this frame on
+        if(not m_spill_active and not recordSample(sample) and m_spill_capture){
+            m_spill_active = true;
+
+            std::cerr << "[FBGS] the recording continues into the spill file " << m_memory_account.getBudget().spill_file << std::endl;
+        }
+
+        if(m_spill_active)
+            m_spill_capture->append(std::chrono::duration_cast<std::chrono::nanoseconds>(m_frame_time_stamp.time_since_epoch()).count(),
+                                    m_frame.data(), m_frame.size());
+    }
+
+    if(m_sample_callback)
+        m_sample_callback( sample );
+}
+
+
+
+bool ShapeSensingInterface::enableRawCapture(const std::string &t_file_name,
+                                             const RawCaptureConfig &t_config)
+{
+    m_raw_capture = std::make_unique<RawCaptureWriter>(t_file_name, t_config);
+
+    if(not m_raw_capture->isOpen()){
+        m_raw_capture.reset();
+        return false;
+    }
+
+    return true;
+}
+
+
+void ShapeSensingInterface::captureFrame()
+{
+    if(m_control->isRecording())
+        m_raw_capture->append(std::chrono::duration_cast<std::chrono::nanoseconds>(m_frame_time_stamp.time_since_epoch()).count(),
+                              m_frame.data(), m_frame.size());
+}
+
+
+void ShapeSensingInterface::loadSamples(std::vector<Sample> &t_samples)
+{
+    if(m_samples_stack.empty() and not t_samples.empty())
+        m_start = t_samples.front().time_stamp;
+
+    for(Sample &sample : t_samples){
+        processSample(sample);
+        recordSample(sample);
+    }
+}
+
+
+bool ShapeSensingInterface::recordSample(const Sample &sample)
+{
+    if(m_memory_account.isExhausted())
+        return false;
+
+    m_samples_stack.push_back(sample);
+
+    if(m_memory_account.add(sizeof(Sample) + sampleBytes(m_samples_stack.back())))
+        return true;
+
+    m_samples_stack.pop_back();
+
+    return false;
+}
+
+
+void ShapeSensingInterface::setMemoryBudget(const MemoryBudget &t_memory_budget)
+{
+    m_memory_account.setBudget(t_memory_budget);
+
+    m_spill_capture.reset();
+    m_spill_active = false;
+    m_memory_account.setFixedBytes(0);
+    if(t_memory_budget.spill_file.empty() or t_memory_budget.max_bytes == 0 or m_raw_capture)
+        return;
+
+    //  A small part of the budget, but blocks far larger than a frame
+    RawCaptureConfig config;
+    config.block_size = std::clamp<std::size_t>(t_memory_budget.max_bytes/(16*config.num_blocks), 1 << 20, config.block_size);
+
+    m_spill_capture = std::make_unique<RawCaptureWriter>(t_memory_budget.spill_file, config);
+    if(not m_spill_capture->isOpen()){
+        std::cerr << "[FBGS] cannot open the spill file " << t_memory_budget.spill_file << std::endl;
+        m_spill_capture.reset();
+        return;
+    }
+
+    m_memory_account.setFixedBytes(m_spill_capture->getMemoryFootprint().fixed_bytes);
+}
+
+
+
+std::size_t ShapeSensingInterface::sampleBytes(const Sample &sample)
+{
+    std::size_t bytes = allocatedBytes(sample.channels) + allocatedBytes(sample.sensors);
+
+    for(const Channel &channel : sample.channels)
+        bytes += allocatedBytes(channel.peak_wavelengths) + allocatedBytes(channel.peak_powers) + allocatedBytes(channel.strains);
+
+    for(const Sensor &sensor : sample.sensors)
+        bytes += allocatedBytes(sensor.kappa) + allocatedBytes(sensor.phi) + allocatedBytes(sensor.shape) + allocatedBytes(sensor.arc_length);
+
+    return bytes;
+}
+
+
+void ShapeSensingInterface::estimateTipStates(Sample &sample)
+{
+    //  One estimator per sensor, only allocated at the first sample
+    if(m_tip_estimators.size() != sample.sensors.size())
+        m_tip_estimators.assign(sample.sensors.size(), TipStateEstimator(m_tip_estimator_gains(0),
+                                                                         m_tip_estimator_gains(1),
+                                                                         m_tip_estimator_gains(2),
+                                                                         m_frequency > 0 ? 1.0/m_frequency : 0));
+
+    for(unsigned int i=0; i<sample.sensors.size(); i++){
+        auto &sensor = sample.sensors[i];
+
+        if(sensor.num_shape_points == 0)
+            continue;
+
+        const auto &state = m_tip_estimators[i].update(sample.sample_number,
+                                                       sensor.shape.row(sensor.num_shape_points-1).transpose());
+
+        sensor.tip_position = state.position;
+        sensor.tip_velocity = state.velocity;
+        sensor.tip_acceleration = state.acceleration;
+    }
+}
+
+
 void ShapeSensingInterface::extracted(Sample const &sample,
                                       Eigen::VectorXd &sample_data,
                                       unsigned int &index) const {
@@ -354,16 +901,18 @@ void ShapeSensingInterface::extracted(Sample const &sample,
 
         index += sensor_shape_points;
 
-        //  Curvature
-        sample_data.block(index, 0, sensor_shape_points, 1)
-            << sensor.kappa;
+        //  Curvature and curvature angle, given at the curvature points only: the rows
+        //  reserved for them (one per shape point) are padded with zeros
+        const unsigned int curvature_points = std::min<unsigned int>(sensor.kappa.size(), sensor_shape_points);
+
+        sample_data.segment(index, sensor_shape_points).setZero();
+        sample_data.segment(index, curvature_points) = sensor.kappa.head(curvature_points);
 
         index += sensor_shape_points;
 
 
-        //  Curvature angle
-        sample_data.block(index, 0, sensor_shape_points, 1)
-            << sensor.phi;
+        sample_data.segment(index, sensor_shape_points).setZero();
+        sample_data.segment(index, curvature_points) = sensor.phi.head(curvature_points);
 
         index += sensor_shape_points;
 
@@ -380,6 +929,7 @@ void ShapeSensingInterface::extracted(Sample const &sample,
 
 void ShapeSensingInterface::getSamplesData(YAML::Node &t_FBGS_node, Eigen::MatrixXd &t_FBGS_data)const
 {
+    FBGS_INSTRUMENT_STAGE(EXPORT);
 
     /*
     data_order:
@@ -419,7 +969,7 @@ void ShapeSensingInterface::getSamplesData(YAML::Node &t_FBGS_node, Eigen::Matri
     std::chrono::high_resolution_clock::duration time_since_start;
     for(unsigned int col=0; const auto& sample : m_samples_stack){
 
-        time_since_start = sample.time_stamp - m_start;
+        time_since_start = sample.synchronised_time_stamp - m_start;
 
 
         Eigen::VectorXd sample_data(number_of_rows);
@@ -450,9 +1000,15 @@ void ShapeSensingInterface::getSamplesData(YAML::Node &t_FBGS_node, Eigen::Matri
 
     t_FBGS_node["number_of_snapshots"] = m_samples_stack.size();
     t_FBGS_node["frequency"] = m_frequency;
-    t_FBGS_node["duration"] = std::chrono::duration<double>(m_samples_stack[m_samples_stack.size()-1].time_stamp - m_start).count();
+    t_FBGS_node["duration"] = std::chrono::duration<double>(m_samples_stack[m_samples_stack.size()-1].synchronised_time_stamp - m_start).count();
     t_FBGS_node["number_of_sensors"] = m_samples_stack[0].num_sensors;
 
+    const SampleSequenceMonitor::Statistics sequence_statistics = m_sequence_monitor.getStatistics();
+    t_FBGS_node["dropped_samples"] = sequence_statistics.dropped;
+    t_FBGS_node["duplicated_samples"] = sequence_statistics.duplicates;
+    t_FBGS_node["reordered_samples"] = sequence_statistics.reordered;
+
+    t_FBGS_node["synchronised_time_stamps"] = m_clock_synchronizer != nullptr;
     t_FBGS_node["data_storage"] = "colmajor";
 
 
@@ -469,6 +1025,8 @@ void ShapeSensingInterface::getSamplesData(YAML::Node &t_FBGS_node, Eigen::Matri
 
     YAML::Node sensors_data;
     sensors_data.push_back("arc_length_coordinates");
+    sensors_data.push_back("curvature");
+    sensors_data.push_back("curvature_angle");
     sensors_data.push_back("x_positions");
     sensors_data.push_back("y_positions");
     sensors_data.push_back("z_positions");
@@ -478,3 +1036,124 @@ void ShapeSensingInterface::getSamplesData(YAML::Node &t_FBGS_node, Eigen::Matri
     t_FBGS_node["data_order"] = order;
 
 }
+
+
+
+
+void ShapeSensingInterface::getSamplesModalData(YAML::Node &t_FBGS_node,
+                                                Eigen::MatrixXd &t_FBGS_data,
+                                                ModalShapeCodec &t_codec)const
+{
+    FBGS_INSTRUMENT_STAGE(EXPORT);
+
+    /*
+    data_order:
+        0: sample_number
+        1: time_stamp
+        2: number_of_sensors
+        number_of_points_per_sensors:
+          - number_of_datapoints
+        sensors_data:
+          - number_of_modes
+          - modal_coefficients      max_modes x 3 colmajor, zero after number_of_modes
+     */
+
+
+    const unsigned int max_modes = t_codec.getMaxModes();
+
+    unsigned int number_of_rows = 3;
+
+    for([[maybe_unused]] const auto& sensor : m_samples_stack[0].sensors){
+        //  Add row for sensor number of points
+        number_of_rows++;
+
+        // Add rows for number of modes and x, y and z coefficients
+        number_of_rows += 1 + max_modes*3;
+    }
+
+    unsigned int number_of_columns = m_samples_stack.size();
+
+
+    t_FBGS_data = Eigen::MatrixXd::Zero(number_of_rows, number_of_columns);
+
+    ModalShapeCodec::ModalShape modal_shape;
+    unsigned int not_within_bound = 0;
+
+    std::chrono::high_resolution_clock::duration time_since_start;
+    for(unsigned int col=0; const auto& sample : m_samples_stack){
+
+        time_since_start = sample.synchronised_time_stamp - m_start;
+
+        unsigned int index = 0;
+        t_FBGS_data.block<3, 1>(index, col) << sample.sample_number,
+                                               time_since_start.count() / 1e9,
+                                               sample.num_sensors;
+        index += 3;
+
+        for(const auto& sensor : sample.sensors)
+            t_FBGS_data(index++, col) = sensor.num_shape_points;
+
+        for(const auto& sensor : sample.sensors){
+            if(not t_codec.encode(sensor.shape, modal_shape))
+                not_within_bound++;
+
+            t_FBGS_data(index++, col) = modal_shape.num_modes;
+
+            for(unsigned int axis=0; axis<3; axis++)
+                t_FBGS_data.block(index + axis*max_modes, col, modal_shape.num_modes, 1) = modal_shape.coefficients.col(axis);
+
+            index += max_modes*3;
+        }
+
+        col++;
+    }
+
+    if(not_within_bound > 0)
+        std::cerr << not_within_bound << " shapes exceed the error bound with " << max_modes << " modes" << std::endl;
+
+
+
+
+    t_FBGS_node["number_of_snapshots"] = m_samples_stack.size();
+    t_FBGS_node["frequency"] = m_frequency;
+    t_FBGS_node["duration"] = std::chrono::duration<double>(m_samples_stack[m_samples_stack.size()-1].synchronised_time_stamp - m_start).count();
+    t_FBGS_node["number_of_sensors"] = m_samples_stack[0].num_sensors;
+
+    const SampleSequenceMonitor::Statistics sequence_statistics = m_sequence_monitor.getStatistics();
+    t_FBGS_node["dropped_samples"] = sequence_statistics.dropped;
+    t_FBGS_node["duplicated_samples"] = sequence_statistics.duplicates;
+    t_FBGS_node["reordered_samples"] = sequence_statistics.reordered;
+
+    t_FBGS_node["synchronised_time_stamps"] = m_clock_synchronizer != nullptr;
+    t_FBGS_node["data_storage"] = "colmajor";
+
+
+    YAML::Node modal_basis;
+    modal_basis["type"] = "discrete_orthonormal_legendre";
+    modal_basis["max_modes"] = max_modes;
+    modal_basis["max_error"] = t_codec.getMaxError();
+    t_FBGS_node["modal_basis"] = modal_basis;
+
+
+    YAML::Node order;
+    order.push_back("sample_number");
+    order.push_back("time_stamp");
+    order.push_back("number_of_sensors");
+
+    YAML::Node number_of_points_per_sensors;
+    number_of_points_per_sensors.push_back("number_of_datapoints");
+
+    order["number_of_points_per_sensors"] = number_of_points_per_sensors;
+
+
+    YAML::Node sensors_data;
+    sensors_data.push_back("number_of_modes");
+    sensors_data.push_back("x_coefficients");
+    sensors_data.push_back("y_coefficients");
+    sensors_data.push_back("z_coefficients");
+
+    order["sensors_data"] = sensors_data;
+
+    t_FBGS_node["data_order"] = order;
+
+}
@@ -0,0 +1,142 @@
+/*
+This code implements a simulation of the stream of the FBGS Shape Sensing interrogator
+*/
+
+#include "fbgs-sensing/shape_sensing_simulator.h"
+#include "fbgs-sensing/frame.h"
+
+#include <cmath>
+#include <ctime>
+#include <algorithm>
+
+
+namespace
+{
+
+//  Outer cores 120 degrees apart, the central core is not strained by bending
+constexpr int CHANNELS_PER_SENSOR { 4 };
+
+double coreAngle(const int t_core)
+{
+    return 2*M_PI*t_core/3;
+}
+
+double coreDistance(const int t_core, const double t_distance)
+{
+    return t_core < 3 ? t_distance : 0;
+}
+
+}
+
+
+
+
+ShapeSensingSimulator::ShapeSensingSimulator(const Config &t_config) :
+    m_config(t_config)
+{
+    //  The sensors move alike with a phase shift, and their length follows the shape points
+    for(int i=0; i<m_config.num_sensors; i++){
+        FiberMotion::Parameters parameters = m_config.motion;
+        parameters.length = 0.001*std::max(1, m_config.num_shape_points - 1);
+        parameters.curvature_amplitude *= 1 - 0.2*i/std::max(1, m_config.num_sensors);
+
+        m_motions.emplace_back(parameters);
+    }
+
+    char date[16];
+    const std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y/%m/%d", std::localtime(&now));
+    m_date = date;
+}
+
+
+
+bool ShapeSensingSimulator::nextFrame(std::vector<char> &t_frame,
+                                      double &t_time)
+{
+    if(m_config.num_samples > 0 and m_sample_number >= m_config.num_samples)
+        return false;
+
+    t_time = m_sample_number/m_config.frequency;
+
+    //  Each sensor is a quarter period ahead of the previous one
+    auto time = [&](const int t_sensor){ return t_time + 0.25*t_sensor/std::max(1e-9, m_config.motion.bending_frequency); };
+
+
+    beginFrame(t_frame);
+
+    appendText(t_frame, m_date);
+
+    appendClock(t_frame, t_time);
+
+    appendInteger(t_frame, static_cast<std::int64_t>(m_sample_number));
+    appendInteger(t_frame, CHANNELS_PER_SENSOR*m_config.num_sensors);
+
+
+    for(int i=0; i<m_config.num_sensors; i++){
+        const FiberMotion &motion = m_motions[i];
+        const double length = motion.getParameters().length;
+
+        for(int core=0; core<CHANNELS_PER_SENSOR; core++){
+            appendInteger(t_frame, CHANNELS_PER_SENSOR*i + core + 1);
+            appendInteger(t_frame, m_config.num_gratings);
+
+            //  Error status
+            for(int k=0; k<4; k++)
+                appendInteger(t_frame, 0);
+
+            for(int j=0; j<m_config.num_gratings; j++){
+                const double s = length*(j + 0.5)/m_config.num_gratings;
+                const double strain = motion.coreStrain(s, time(i), coreAngle(core), coreDistance(core, motion.getParameters().core_distance));
+
+                appendDecimal(t_frame, getReferenceWavelength(j)*(1 + m_config.gauge_factor*strain), 5);
+            }
+
+            for(int j=0; j<m_config.num_gratings; j++)
+                appendDecimal(t_frame, 20 + 0.5*((j + core) % 5), 2);
+        }
+    }
+
+
+    for(int i=0; i<m_config.num_sensors; i++){
+        const FiberMotion &motion = m_motions[i];
+        const double length = motion.getParameters().length;
+
+        //  The interface expects 1/cm, rad and cm
+        appendText(t_frame, "Curvature [1/cm]");
+        for(int j=0; j<m_config.num_gratings; j++)
+            appendDecimal(t_frame, 0.01*std::abs(motion.curvature(length*(j + 0.5)/m_config.num_gratings, time(i))), 6);
+
+        //  A negative curvature is a bend in the opposite direction
+        appendText(t_frame, "Curvature angle [rad]");
+        for(int j=0; j<m_config.num_gratings; j++){
+            const double s = length*(j + 0.5)/m_config.num_gratings;
+            const double angle = motion.angle(s, time(i)) + (motion.curvature(s, time(i)) < 0 ? M_PI : 0);
+            appendDecimal(t_frame, std::remainder(angle, 2*M_PI), 6);
+        }
+
+        motion.shape(time(i), m_config.num_shape_points, 0.001, m_shape);
+
+        const char *axes[3] = { "Shape x [cm]", "Shape y [cm]", "Shape z [cm]" };
+        for(int k=0; k<3; k++){
+            appendText(t_frame, axes[k]);
+            appendInteger(t_frame, m_config.num_shape_points);
+            for(int j=0; j<m_config.num_shape_points; j++)
+                appendDecimal(t_frame, 100*m_shape(j, k), 4);
+        }
+    }
+
+    endFrame(t_frame);
+
+    m_sample_number++;
+
+    return true;
+}
+
+
+
+double ShapeSensingSimulator::getReferenceWavelength(const int t_grating) const
+{
+    //  Spread over the C band
+    return 1525 + 40.0*(t_grating + 0.5)/std::max(1, m_config.num_gratings);
+}
@@ -0,0 +1,379 @@
+/*
+This code implements the publication of the samples to other processes through shared memory
+*/
+
+#include "fbgs-sensing/shared_memory_ring.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <iostream>
+
+
+using namespace shared_memory;
+
+
+namespace
+{
+
+std::string segmentName(const std::string &t_name)
+{
+    return t_name.starts_with('/') ? t_name : "/" + t_name;
+}
+
+
+inline std::uint64_t publishedSequence(const std::uint64_t t_index)
+{
+    return 2*(t_index + 1);
+}
+
+
+inline std::size_t roundUp(const std::size_t t_size, const std::size_t t_alignment)
+{
+    return (t_size + t_alignment - 1) / t_alignment * t_alignment;
+}
+
+
+inline const char *slotAddress(const Header *t_header, const std::uint64_t t_index)
+{
+    const char *first = reinterpret_cast<const char*>(t_header) + roundUp(sizeof(Header), 64);
+    return first + (t_index % t_header->num_slots) * t_header->slot_stride;
+}
+
+
+inline const double *payload(const SlotHeader *t_slot)
+{
+    return reinterpret_cast<const double*>(reinterpret_cast<const char*>(t_slot) + sizeof(SlotHeader));
+}
+
+}
+
+
+
+
+SharedMemoryPublisher::SharedMemoryPublisher(const std::string &t_name,
+                                             const unsigned int t_num_slots) :
+    m_name(segmentName(t_name)),
+    m_num_slots(std::max(t_num_slots, 2u))
+{
+}
+
+
+SharedMemoryPublisher::~SharedMemoryPublisher()
+{
+    if(m_header != nullptr)
+        munmap(m_header, m_size);
+
+    if(m_fd >= 0){
+        close(m_fd);
+        shm_unlink(m_name.c_str());
+    }
+}
+
+
+
+bool SharedMemoryPublisher::create(const std::vector<Block> &t_blocks)
+{
+    if(m_header != nullptr)
+        return false;
+
+    if(t_blocks.size() > MAX_BLOCKS){
+        std::cerr << "[SharedMemoryPublisher] too many blocks : " << t_blocks.size() << std::endl;
+        return false;
+    }
+
+
+    std::uint64_t payload_size = 0;
+    for(const auto &block : t_blocks)
+        payload_size += block.rows*block.cols;
+
+    const std::size_t slot_stride = roundUp(sizeof(SlotHeader) + payload_size*sizeof(double), 64);
+    m_size = roundUp(sizeof(Header), 64) + m_num_slots*slot_stride;
+
+
+    //  A previous segment left by a crashed process is replaced
+    shm_unlink(m_name.c_str());
+
+    m_fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if(m_fd < 0){
+        std::cerr << "[SharedMemoryPublisher] shm_open " << m_name << " : " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    if(ftruncate(m_fd, static_cast<off_t>(m_size)) != 0){
+        std::cerr << "[SharedMemoryPublisher] ftruncate : " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    void *address = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, 0);
+    if(address == MAP_FAILED){
+        std::cerr << "[SharedMemoryPublisher] mmap : " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+
+    //  Fill the header, the magic number goes last so that readers never see a partial header
+    Header *header = static_cast<Header*>(address);
+    header->version = VERSION;
+    header->num_slots = m_num_slots;
+    header->slot_stride = slot_stride;
+    header->payload_size = payload_size;
+    header->num_blocks = static_cast<std::uint32_t>(t_blocks.size());
+
+    std::uint64_t offset = 0;
+    for(unsigned int i=0; i<t_blocks.size(); i++){
+        BlockDescriptor &descriptor = header->blocks[i];
+        std::strncpy(descriptor.name, t_blocks[i].name.c_str(), NAME_SIZE-1);
+        descriptor.name[NAME_SIZE-1] = '\0';
+        descriptor.rows = t_blocks[i].rows;
+        descriptor.cols = t_blocks[i].cols;
+        descriptor.offset = offset;
+
+        offset += t_blocks[i].rows*t_blocks[i].cols;
+    }
+
+    new (&header->write_count) std::atomic<std::uint64_t>(0);
+    for(unsigned int i=0; i<m_num_slots; i++){
+        SlotHeader *slot = reinterpret_cast<SlotHeader*>(const_cast<char*>(slotAddress(header, i)));
+        new (&slot->sequence) std::atomic<std::uint64_t>(0);
+    }
+
+    std::atomic_thread_fence(std::memory_order_release);
+    reinterpret_cast<std::atomic<std::uint64_t>*>(&header->magic)->store(MAGIC, std::memory_order_release);
+
+    m_header = header;
+    m_index = 0;
+
+    return true;
+}
+
+
+bool SharedMemoryPublisher::matches(const std::vector<Block> &t_blocks) const
+{
+    if(m_header == nullptr or t_blocks.size() != m_header->num_blocks)
+        return false;
+
+    for(unsigned int i=0; i<t_blocks.size(); i++)
+        if(t_blocks[i].rows != m_header->blocks[i].rows or t_blocks[i].cols != m_header->blocks[i].cols)
+            return false;
+
+    return true;
+}
+
+
+
+
+void SharedMemoryPublisher::beginWrite(const std::int64_t t_sample_number,
+                                       const std::int64_t t_time_stamp_ns)
+{
+    m_slot = reinterpret_cast<SlotHeader*>(const_cast<char*>(slotAddress(m_header, m_index)));
+
+    m_slot->sequence.store(publishedSequence(m_index) - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    m_slot->sample_number = t_sample_number;
+    m_slot->time_stamp_ns = t_time_stamp_ns;
+}
+
+
+Eigen::Map<Eigen::MatrixXd> SharedMemoryPublisher::block(const unsigned int t_block)
+{
+    const BlockDescriptor &descriptor = m_header->blocks[t_block];
+    double *data = const_cast<double*>(payload(m_slot)) + descriptor.offset;
+
+    return Eigen::Map<Eigen::MatrixXd>(data, descriptor.rows, descriptor.cols);
+}
+
+
+void SharedMemoryPublisher::endWrite()
+{
+    m_slot->sequence.store(publishedSequence(m_index), std::memory_order_release);
+
+    m_index++;
+    m_header->write_count.store(m_index, std::memory_order_release);
+}
+
+
+MemoryFootprint SharedMemoryPublisher::getMemoryFootprint() const
+{
+    MemoryFootprint footprint;
+    footprint.samples = m_header ? m_header->write_count.load(std::memory_order_relaxed) : 0;
+    footprint.fixed_bytes = m_size;
+    footprint.resident_bytes = residentBytes();
+
+    return footprint;
+}
+
+
+
+
+Eigen::Map<const Eigen::MatrixXd> SharedMemoryReader::View::block(const unsigned int t_block) const
+{
+    const BlockDescriptor &descriptor = m_header->blocks[t_block];
+
+    return Eigen::Map<const Eigen::MatrixXd>(payload(m_slot) + descriptor.offset, descriptor.rows, descriptor.cols);
+}
+
+
+
+
+SharedMemoryReader::SharedMemoryReader(const std::string &t_name) :
+    m_name(segmentName(t_name))
+{
+}
+
+
+SharedMemoryReader::~SharedMemoryReader()
+{
+    if(m_header != nullptr)
+        munmap(const_cast<Header*>(m_header), m_size);
+
+    if(m_fd >= 0)
+        close(m_fd);
+}
+
+
+
+bool SharedMemoryReader::open()
+{
+    if(m_header != nullptr)
+        return true;
+
+    m_fd = shm_open(m_name.c_str(), O_RDONLY, 0);
+    if(m_fd < 0)
+        return false;
+
+    //  The header is checked before mapping: touching a page beyond the end of the segment raises SIGBUS
+    m_size = checkedSegmentSize();
+    if(m_size == 0){
+        close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    void *address = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_fd, 0);
+    if(address == MAP_FAILED){
+        std::cerr << "[SharedMemoryReader] mmap : " << std::strerror(errno) << std::endl;
+        close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    m_header = static_cast<const Header*>(address);
+
+    return true;
+}
+
+
+std::size_t SharedMemoryReader::checkedSegmentSize() const
+{
+    struct stat status;
+    if(fstat(m_fd, &status) != 0 or static_cast<std::size_t>(status.st_size) < sizeof(Header))
+        return 0;
+
+    //  The magic number (first field) is written last, the rest of the header is only read once it is there
+    std::uint64_t magic = 0;
+    if(pread(m_fd, &magic, sizeof(magic), 0) != sizeof(magic) or magic != MAGIC)
+        return 0;
+
+    alignas(Header) unsigned char buffer[sizeof(Header)];
+    if(pread(m_fd, buffer, sizeof(Header), 0) != static_cast<ssize_t>(sizeof(Header)))
+        return 0;
+
+    const Header *header = reinterpret_cast<const Header*>(buffer);
+
+    if(header->version != VERSION){
+        std::cerr << "[SharedMemoryReader] " << m_name << " has version " << header->version << ", expected " << VERSION << std::endl;
+        return 0;
+    }
+
+    bool consistent = header->num_slots > 0 and header->num_blocks <= MAX_BLOCKS
+                      and header->slot_stride >= sizeof(SlotHeader) + header->payload_size*sizeof(double);
+    for(unsigned int i=0; consistent and i<header->num_blocks; i++)
+        consistent = header->blocks[i].offset + std::uint64_t(header->blocks[i].rows)*header->blocks[i].cols <= header->payload_size;
+
+    const std::size_t size = roundUp(sizeof(Header), 64) + header->num_slots*header->slot_stride;
+
+    if(not consistent or static_cast<std::size_t>(status.st_size) < size){
+        std::cerr << "[SharedMemoryReader] " << m_name << " is inconsistent with its header, " << status.st_size
+                  << " bytes for a ring of " << size << std::endl;
+        return 0;
+    }
+
+    return size;
+}
+
+
+
+
+std::uint64_t SharedMemoryReader::getWriteCount() const
+{
+    return m_header ? m_header->write_count.load(std::memory_order_acquire) : 0;
+}
+
+
+bool SharedMemoryReader::latest(View &t_view) const
+{
+    const std::uint64_t count = getWriteCount();
+    if(count == 0)
+        return false;
+
+    return at(count - 1, t_view);
+}
+
+
+bool SharedMemoryReader::at(const std::uint64_t t_index, View &t_view) const
+{
+    if(m_header == nullptr)
+        return false;
+
+    const SlotHeader *slot = reinterpret_cast<const SlotHeader*>(slotAddress(m_header, t_index));
+
+    const std::uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+    if(sequence != publishedSequence(t_index))
+        return false;
+
+    t_view.index = t_index;
+    t_view.sample_number = slot->sample_number;
+    t_view.time_stamp_ns = slot->time_stamp_ns;
+    t_view.m_header = m_header;
+    t_view.m_slot = slot;
+    t_view.m_sequence = sequence;
+
+    return isValid(t_view);
+}
+
+
+bool SharedMemoryReader::isValid(const View &t_view) const
+{
+    if(t_view.m_slot == nullptr)
+        return false;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return t_view.m_slot->sequence.load(std::memory_order_relaxed) == t_view.m_sequence;
+}
+
+
+
+
+std::string SharedMemoryReader::getBlockName(const unsigned int t_block) const
+{
+    if(m_header == nullptr or t_block >= m_header->num_blocks)
+        return "";
+
+    return std::string(m_header->blocks[t_block].name);
+}
+
+
+int SharedMemoryReader::findBlock(const std::string &t_name) const
+{
+    for(unsigned int i=0; i<getNumberOfBlocks(); i++)
+        if(t_name == m_header->blocks[i].name)
+            return static_cast<int>(i);
+
+    return -1;
+}
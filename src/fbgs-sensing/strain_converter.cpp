@@ -0,0 +1,125 @@
+/*
+This code implements the conversion of FBG peak wavelengths into strains
+*/
+
+#include "fbgs-sensing/strain_converter.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+
+StrainConverter::StrainConverter(const double t_gauge_factor) :
+    m_gauge_factor(t_gauge_factor)
+{
+}
+
+
+
+void StrainConverter::setTopology(const std::vector<int> &t_num_gratings)
+{
+    m_num_gratings = t_num_gratings;
+
+    m_offsets.clear();
+    m_total_gratings = 0;
+    for(const auto num_gratings : m_num_gratings){
+        m_offsets.push_back(m_total_gratings);
+        m_total_gratings += num_gratings;
+    }
+
+    //  A reference of a different size is meaningless, a new tare is needed
+    if(m_reference_wavelengths.size() != m_total_gratings){
+        if(m_has_reference.load(std::memory_order_relaxed))
+            std::cerr << "[StrainConverter] topology changed, the reference wavelengths are discarded" << std::endl;
+
+        m_reference_wavelengths = Eigen::VectorXd::Zero(m_total_gratings);
+        m_has_reference.store(false, std::memory_order_release);
+    }
+
+    if(m_gauge_factors.size() != m_total_gratings)
+        m_gauge_factors = Eigen::VectorXd::Constant(m_total_gratings, m_gauge_factor);
+
+    m_scales = Eigen::VectorXd::Zero(m_total_gratings);
+    m_tare_sum = Eigen::VectorXd::Zero(m_total_gratings);
+
+    updateScales();
+}
+
+
+
+void StrainConverter::setReferenceWavelengths(const Eigen::VectorXd &t_reference_wavelengths)
+{
+    checkSize(t_reference_wavelengths, m_gauge_factors);
+
+    m_reference_wavelengths = t_reference_wavelengths;
+
+    updateScales();
+
+    m_has_reference.store(true, std::memory_order_release);
+}
+
+
+void StrainConverter::setGaugeFactors(const Eigen::VectorXd &t_gauge_factors)
+{
+    checkSize(t_gauge_factors, m_reference_wavelengths);
+
+    m_gauge_factors = t_gauge_factors;
+
+    updateScales();
+}
+
+
+
+void StrainConverter::startTare(const unsigned int t_number_of_samples)
+{
+    if(t_number_of_samples == 0)
+        return;
+
+    m_tare_completed.store(false, std::memory_order_release);
+    m_tare_request.store(t_number_of_samples, std::memory_order_release);
+}
+
+
+
+
+void StrainConverter::checkSize(const Eigen::VectorXd &t_vector, const Eigen::VectorXd &t_other) const
+{
+    //  Before the first sample the topology is unknown, the vectors must only agree with each other
+    const Eigen::Index expected = m_num_gratings.empty() ? t_other.size() : m_total_gratings;
+
+    if(expected > 0 and t_vector.size() != expected)
+        throw std::invalid_argument("[StrainConverter] " + std::to_string(t_vector.size()) + " values given for "
+                                    + std::to_string(expected) + " gratings");
+}
+
+
+void StrainConverter::updateScales()
+{
+    if(m_reference_wavelengths.size() != m_gauge_factors.size())
+        return;
+
+    m_scales = 1e6 * ( m_gauge_factors.array() * m_reference_wavelengths.array() ).inverse();
+}
+
+
+
+void StrainConverter::beginTare(const unsigned int t_number_of_samples)
+{
+    m_tare_target = t_number_of_samples;
+    m_tare_count = 0;
+    m_tare_sum.setZero();
+}
+
+
+void StrainConverter::completeTare()
+{
+    m_reference_wavelengths = m_tare_sum / static_cast<double>(m_tare_count);
+
+    updateScales();
+
+    m_tare_target = 0;
+    m_tare_count = 0;
+
+    m_has_reference.store(true, std::memory_order_release);
+    m_tare_completed.store(true, std::memory_order_release);
+}
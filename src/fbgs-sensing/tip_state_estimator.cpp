@@ -0,0 +1,92 @@
+/*
+This code implements an online estimator of the sensor tip kinematics
+*/
+
+#include "fbgs-sensing/tip_state_estimator.h"
+
+
+TipStateEstimator::TipStateEstimator(const double t_alpha,
+                                     const double t_beta,
+                                     const double t_gamma,
+                                     const double t_period) :
+    m_alpha(t_alpha),
+    m_beta(t_beta),
+    m_gamma(t_gamma),
+    m_period(t_period)
+{
+}
+
+
+void TipStateEstimator::setGains(const double t_alpha,
+                                 const double t_beta,
+                                 const double t_gamma)
+{
+    m_alpha = t_alpha;
+    m_beta = t_beta;
+    m_gamma = t_gamma;
+}
+
+
+void TipStateEstimator::setPeriod(const double t_period)
+{
+    m_period = t_period;
+}
+
+
+void TipStateEstimator::reset()
+{
+    m_state = State();
+    m_number_of_updates = 0;
+}
+
+
+
+const TipStateEstimator::State &TipStateEstimator::update(const std::int64_t t_sample_number,
+                                                          const Eigen::Vector3d &t_position)
+{
+    //  Interrogator restarted (or sample late), the previous state cannot be continued
+    if(m_number_of_updates > 0 and t_sample_number < m_last_sample_number)
+        reset();
+
+    //  First measurement, only the position is known
+    if(m_number_of_updates == 0){
+        m_state.position = t_position;
+        m_last_sample_number = t_sample_number;
+        m_number_of_updates++;
+        return m_state;
+    }
+
+    //  Duplicate, nothing can be estimated
+    if(t_sample_number == m_last_sample_number or m_period <= 0)
+        return m_state;
+
+    const double dt = static_cast<double>(t_sample_number - m_last_sample_number)*m_period;
+    m_last_sample_number = t_sample_number;
+
+
+    //  Second measurement, initialise the velocity with a finite difference
+    if(m_number_of_updates == 1){
+        m_state.velocity = (t_position - m_state.position) / dt;
+        m_state.position = t_position;
+        m_number_of_updates++;
+        return m_state;
+    }
+
+
+    //  Predict with constant acceleration
+    const Eigen::Vector3d predicted_position = m_state.position
+                                               + m_state.velocity*dt
+                                               + 0.5*m_state.acceleration*dt*dt;
+    const Eigen::Vector3d predicted_velocity = m_state.velocity + m_state.acceleration*dt;
+
+    //  Correct with the residual
+    const Eigen::Vector3d residual = t_position - predicted_position;
+
+    m_state.position = predicted_position + m_alpha*residual;
+    m_state.velocity = predicted_velocity + (m_beta/dt)*residual;
+    m_state.acceleration += (2.0*m_gamma/(dt*dt))*residual;
+
+    m_number_of_updates++;
+
+    return m_state;
+}
@@ -0,0 +1,280 @@
+/*
+This code implements the strategies used by the acquisition threads to wait for the next frame
+*/
+
+#include "fbgs-sensing/wait_policy.h"
+#include "fbgs-sensing/acquisition_control.h"
+
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
+
+#include <cerrno>
+#include <cmath>
+#include <bit>
+#include <algorithm>
+
+
+namespace
+{
+
+std::int64_t toNs(const timespec &t_time)
+{
+    return static_cast<std::int64_t>(t_time.tv_sec)*1000000000 + t_time.tv_nsec;
+}
+
+}
+
+
+
+
+void SocketWaiter::configureSocket(const int t_fd,
+                                   const int t_readable_threshold)
+{
+    if(m_first_wall_ns < 0)
+        startMeasurement();
+
+    AcquisitionControl::setReadableThreshold(t_fd, t_readable_threshold);
+
+    if(not m_policy.measure_wake_latency)
+        return;
+
+    //  Software time stamps taken by the kernel when the packet is received
+    const int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    setsockopt(t_fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags));
+}
+
+
+
+bool SocketWaiter::wait(const int t_fd,
+                        const int t_event_fd,
+                        const int t_timeout_ms)
+{
+    if(m_first_wall_ns < 0)
+        startMeasurement();
+
+    const std::int64_t start_cpu_ns = threadCpuTimeNs();
+
+
+    //  Data already there, no wake-up to measure
+    int ready = poll(t_fd, t_event_fd, 0);
+
+    if(ready == 0)
+        m_immediate.store(m_immediate.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    else if(ready < 0){
+        bool spun = false;
+
+        if(m_policy.strategy != WaitPolicy::Strategy::BLOCK){
+            const std::int64_t deadline_ns = t_timeout_ms < 0 ? -1 : monotonicTimeNs() + std::int64_t(t_timeout_ms)*1000000;
+
+            const bool forever = m_policy.strategy == WaitPolicy::Strategy::SPIN;
+            for(unsigned int i=0; ready < 0 and (forever or i < m_policy.spin_iterations); i++){
+                ready = poll(t_fd, t_event_fd, 0);
+
+                //  The deadline is not checked at every iteration, reading the clock would cost as much as the poll
+                if(ready < 0 and deadline_ns >= 0 and (i & 63) == 63 and monotonicTimeNs() >= deadline_ns)
+                    break;
+            }
+
+            spun = ready == 0;
+        }
+
+        if(ready < 0 and m_policy.strategy != WaitPolicy::Strategy::SPIN)
+            ready = poll(t_fd, t_event_fd, t_timeout_ms);
+
+        if(ready == 0){
+            if(m_policy.measure_wake_latency)
+                recordWakeLatency(t_fd);
+
+            m_wake_ups.store(m_wake_ups.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            if(spun)
+                m_spin_wake_ups.store(m_spin_wake_ups.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+        else if(ready < 0)
+            m_timeouts.store(m_timeouts.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+
+    const std::int64_t end_cpu_ns = threadCpuTimeNs();
+    m_wait_cpu_ns.store(m_wait_cpu_ns.load(std::memory_order_relaxed) + end_cpu_ns - start_cpu_ns, std::memory_order_relaxed);
+    m_cpu_ns.store(end_cpu_ns - m_first_cpu_ns, std::memory_order_relaxed);
+    m_wall_ns.store(monotonicTimeNs() - m_first_wall_ns, std::memory_order_relaxed);
+
+    return ready == 0;
+}
+
+
+
+int SocketWaiter::poll(const int t_fd,
+                       const int t_event_fd,
+                       const int t_timeout_ms)
+{
+    pollfd fds[2];
+    fds[0] = { t_fd, POLLIN, 0 };
+    fds[1] = { t_event_fd, POLLIN, 0 };
+
+    const nfds_t count = t_event_fd >= 0 ? 2 : 1;
+
+    int ready;
+    do {
+        ready = ::poll(fds, count, t_timeout_ms);
+    } while(ready < 0 and errno == EINTR);
+
+    if(ready <= 0)
+        return -1;
+
+    //  Errors and hang up are reported as readable, the following read will fail and tell why
+    if(fds[0].revents & (POLLIN | POLLERR | POLLHUP))
+        return 0;
+
+    if(count == 2 and (fds[1].revents & POLLIN))
+        AcquisitionControl::clearEvents(t_event_fd);
+
+    return 1;
+}
+
+
+
+void SocketWaiter::recordWakeLatency(const int t_fd)
+{
+    //  The time stamp of the first unread byte is delivered with it, peeked so the stream is untouched
+    char byte;
+    iovec io { &byte, 1 };
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(scm_timestamping))];
+
+    msghdr message {};
+    message.msg_iov = &io;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    if(recvmsg(t_fd, &message, MSG_PEEK | MSG_DONTWAIT) <= 0)
+        return;
+
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    for(cmsghdr *header = CMSG_FIRSTHDR(&message); header != nullptr; header = CMSG_NXTHDR(&message, header)){
+        if(header->cmsg_level != SOL_SOCKET or header->cmsg_type != SO_TIMESTAMPING)
+            continue;
+
+        const scm_timestamping *time_stamps = reinterpret_cast<const scm_timestamping*>(CMSG_DATA(header));
+        if(time_stamps->ts[0].tv_sec == 0 and time_stamps->ts[0].tv_nsec == 0)
+            return;
+
+        const std::int64_t latency_ns = std::max<std::int64_t>(1, toNs(now) - toNs(time_stamps->ts[0]));
+
+        const unsigned int bucket = std::min<unsigned int>(LATENCY_BUCKETS - 1, std::bit_width(static_cast<std::uint64_t>(latency_ns)) - 1);
+        m_latency_histogram[bucket].store(m_latency_histogram[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        m_latency_count.store(m_latency_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        m_latency_sum_ns.store(m_latency_sum_ns.load(std::memory_order_relaxed) + latency_ns, std::memory_order_relaxed);
+        if(latency_ns > m_latency_max_ns.load(std::memory_order_relaxed))
+            m_latency_max_ns.store(latency_ns, std::memory_order_relaxed);
+
+        return;
+    }
+}
+
+
+
+
+void SocketWaiter::startMeasurement()
+{
+    m_first_wall_ns = monotonicTimeNs();
+    m_first_cpu_ns = threadCpuTimeNs();
+
+    //  The clock of this thread, readable from the others
+    if(pthread_getcpuclockid(pthread_self(), &m_cpu_clock) != 0)
+        m_cpu_clock = CLOCK_THREAD_CPUTIME_ID;
+
+    m_measuring.store(m_cpu_clock != CLOCK_THREAD_CPUTIME_ID, std::memory_order_release);
+}
+
+
+SocketWaiter::Statistics SocketWaiter::getStatistics() const
+{
+    Statistics statistics;
+
+    statistics.wake_ups = m_wake_ups.load(std::memory_order_relaxed);
+    statistics.spin_wake_ups = m_spin_wake_ups.load(std::memory_order_relaxed);
+    statistics.immediate = m_immediate.load(std::memory_order_relaxed);
+    statistics.timeouts = m_timeouts.load(std::memory_order_relaxed);
+
+    statistics.wall_time = 1e-9*m_wall_ns.load(std::memory_order_relaxed);
+    statistics.cpu_time = 1e-9*m_cpu_ns.load(std::memory_order_relaxed);
+
+    //  Up to now while the thread runs, its clock is invalid once it ended
+    timespec cpu_time;
+    if(m_measuring.load(std::memory_order_acquire) and clock_gettime(m_cpu_clock, &cpu_time) == 0){
+        statistics.wall_time = 1e-9*(monotonicTimeNs() - m_first_wall_ns);
+        statistics.cpu_time = 1e-9*(toNs(cpu_time) - m_first_cpu_ns);
+    }
+
+    statistics.wait_cpu_time = 1e-9*m_wait_cpu_ns.load(std::memory_order_relaxed);
+    if(statistics.wall_time > 0)
+        statistics.cpu_load = statistics.cpu_time/statistics.wall_time;
+
+
+    statistics.latency_count = m_latency_count.load(std::memory_order_relaxed);
+    if(statistics.latency_count == 0)
+        return statistics;
+
+    statistics.latency_mean = 1e-3*m_latency_sum_ns.load(std::memory_order_relaxed)/statistics.latency_count;
+    statistics.latency_max = 1e-3*m_latency_max_ns.load(std::memory_order_relaxed);
+
+    const std::uint64_t rank = (99*statistics.latency_count + 99)/100;
+    std::uint64_t count = 0;
+    for(unsigned int i=0; i<LATENCY_BUCKETS; i++){
+        count += m_latency_histogram[i].load(std::memory_order_relaxed);
+        if(count >= rank){
+            statistics.latency_p99 = std::min(statistics.latency_max, 1e-3*std::ldexp(1.0, i + 1));
+            break;
+        }
+    }
+
+    return statistics;
+}
+
+
+void SocketWaiter::reset()
+{
+    m_wake_ups.store(0, std::memory_order_relaxed);
+    m_spin_wake_ups.store(0, std::memory_order_relaxed);
+    m_immediate.store(0, std::memory_order_relaxed);
+    m_timeouts.store(0, std::memory_order_relaxed);
+
+    m_measuring.store(false, std::memory_order_relaxed);
+    m_first_wall_ns = -1;
+    m_wall_ns.store(0, std::memory_order_relaxed);
+    m_cpu_ns.store(0, std::memory_order_relaxed);
+    m_wait_cpu_ns.store(0, std::memory_order_relaxed);
+
+    for(auto &bucket : m_latency_histogram)
+        bucket.store(0, std::memory_order_relaxed);
+    m_latency_count.store(0, std::memory_order_relaxed);
+    m_latency_sum_ns.store(0, std::memory_order_relaxed);
+    m_latency_max_ns.store(0, std::memory_order_relaxed);
+}
+
+
+
+
+std::int64_t SocketWaiter::threadCpuTimeNs()
+{
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return toNs(time);
+}
+
+
+std::int64_t SocketWaiter::monotonicTimeNs()
+{
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return toNs(time);
+}
@@ -0,0 +1,152 @@
+
+//includes
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include <yaml-cpp/yaml.h>
+
+#include "fbgs-sensing/shape_sensing_interface.h"
+#include "fbgs-sensing/illumisense_interface.h"
+#include "fbgs-sensing/raw_capture.h"
+
+
+
+// Parses a raw capture (see enableRawCapture()) offline on all the cores and exports the samples in the
+// format of read_and_save_data, the YAML description and the CSV matrix of getSamplesData():
+//      fbgs_parse_capture capture.raw --device illumisense
+// writes capture.yaml and capture.csv
+
+
+
+void printUsage()
+{
+    std::cout << "Usage: fbgs_parse_capture <capture.raw> [options]\n"
+                 "  --device <shape|illumisense> interrogator of the capture (shape)\n"
+                 "  --threads <n>                parsing threads, 0 for all the cores (0)\n"
+                 "  --frequency <Hz>             sample rate written in the description (100)\n"
+                 "  --output <name>              name of the exported files, without extension (name of the capture)\n";
+}
+
+
+
+template<typename Interface>
+bool exportCapture(const std::string &t_capture,
+                   const std::string &t_output,
+                   const unsigned int t_num_threads,
+                   const double t_frequency)
+{
+    Interface interface(nullptr, t_frequency);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<typename Interface::Sample> samples;
+    const std::size_t records = parseRawCapture(t_capture, interface, samples, t_num_threads);
+
+    const double parse_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << records << " frames, " << samples.size() << " samples parsed in " << parse_time << " s ("
+              << samples.size()/std::max(parse_time, 1e-9) << " samples/s)" << std::endl;
+
+    if(samples.empty())
+        return false;
+
+
+    interface.loadSamples(samples);
+
+    YAML::Node FBGS_node;
+    Eigen::MatrixXd FBGS_data;
+
+    interface.getSamplesData(FBGS_node, FBGS_data);
+
+
+    std::ofstream yaml_file(t_output + ".yaml");
+    yaml_file << FBGS_node;
+
+    std::ofstream csv_file(t_output + ".csv");
+    csv_file << FBGS_data.format(Eigen::IOFormat(16, 0, ","));
+
+    if(not yaml_file or not csv_file){
+        std::cerr << "cannot write " << t_output << ".yaml and .csv" << std::endl;
+        return false;
+    }
+
+    std::cout << "Saved " << t_output << ".yaml and " << t_output << ".csv" << std::endl;
+
+    return true;
+}
+
+
+
+
+int main(int argc, char **argv)
+{
+    std::string capture;
+    std::string device = "shape";
+    std::string output;
+    unsigned int num_threads = 0;
+    double frequency = 100;
+
+    for(int i=1; i<argc; i++){
+        const std::string option = argv[i];
+
+        if(option == "--help" or option == "-h"){
+            printUsage();
+            return 0;
+        }
+
+        if(option.rfind("--", 0) != 0){
+            capture = option;
+            continue;
+        }
+
+        if(i + 1 >= argc){
+            std::cerr << "missing value for " << option << std::endl;
+            printUsage();
+            return 1;
+        }
+
+        const std::string value = argv[++i];
+
+        if(option == "--device")                    device = value;
+        else if(option == "--threads")              num_threads = static_cast<unsigned int>(std::stoul(value));
+        else if(option == "--frequency")            frequency = std::stod(value);
+        else if(option == "--output")               output = value;
+        else {
+            std::cerr << "unknown option " << option << std::endl;
+            printUsage();
+            return 1;
+        }
+    }
+
+    if(capture.empty()){
+        printUsage();
+        return 1;
+    }
+
+    if(not RawCaptureReader(capture).isOpen()){
+        std::cerr << capture << " is not a raw capture" << std::endl;
+        return 1;
+    }
+
+    if(output.empty())
+        output = capture.ends_with(".raw") ? capture.substr(0, capture.size() - 4) : capture;
+
+
+
+    bool exported = false;
+
+    if(device == "shape")
+        exported = exportCapture<ShapeSensingInterface>(capture, output, num_threads, frequency);
+    else if(device == "illumisense")
+        exported = exportCapture<IllumiSenseInterface>(capture, output, num_threads, frequency);
+    else {
+        std::cerr << "unknown device " << device << std::endl;
+        printUsage();
+        return 1;
+    }
+
+    return exported ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+
+//includes
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <csignal>
+
+#include "fbgs-sensing/frame_server.h"
+#include "fbgs-sensing/recording_replay.h"
+
+
+
+// Replays a recorded session as the stream of the interrogator, at its original timing or faster:
+//      fbgs_replay capture.raw --speed 10
+//      fbgs_replay simulation_results_5s.yaml FBGS_data.csv --loop
+// then connect the interface of the device to 127.0.0.1 (port 5001 for Shape Sensing, 2055 for IllumiSense)
+
+
+
+std::shared_ptr<AcquisitionControl> control =
+    std::make_shared<AcquisitionControl>();
+
+
+
+
+void my_handler(int)
+{
+    control->shutdown();
+}
+
+
+
+void printUsage()
+{
+    std::cout << "Usage: fbgs_replay <capture.raw> [options]\n"
+                 "       fbgs_replay <description.yaml> <data.csv> [options]\n"
+                 "  --address <ip>               address to listen on (127.0.0.1)\n"
+                 "  --port <port>                port to listen on (the port of the recorded device, 5001 for a raw capture)\n"
+                 "  --speed <factor>             1 at the recorded timing, N times faster, 0 as fast as the client reads (1)\n"
+                 "  --fast                       same as --speed 0\n"
+                 "  --loop                       repeats the recording endlessly\n"
+                 "  --curvature-points <n>       curvature points per channel of a Shape Sensing recording (0)\n";
+}
+
+
+
+
+int main(int argc, char **argv)
+{
+    // make sure we catch the ctrl+c signal to kill the application properly.
+    struct sigaction sigIntHandler;
+    sigIntHandler.sa_handler = my_handler;
+    sigemptyset(&sigIntHandler.sa_mask);
+    sigIntHandler.sa_flags = 0;
+    sigaction(SIGINT, &sigIntHandler, NULL);
+
+
+
+    std::vector<std::string> files;
+    std::string address = "127.0.0.1";
+    int port = -1;
+    double speed = 1;
+    bool loop = false;
+    int num_curvature_points = 0;
+
+    for(int i=1; i<argc; i++){
+        const std::string option = argv[i];
+
+        if(option == "--help" or option == "-h"){
+            printUsage();
+            return 0;
+        }
+
+        if(option == "--fast"){
+            speed = 0;
+            continue;
+        }
+
+        if(option == "--loop"){
+            loop = true;
+            continue;
+        }
+
+        if(option.rfind("--", 0) != 0){
+            files.push_back(option);
+            continue;
+        }
+
+        if(i + 1 >= argc){
+            std::cerr << "missing value for " << option << std::endl;
+            printUsage();
+            return 1;
+        }
+
+        const std::string value = argv[++i];
+
+        if(option == "--address")                   address = value;
+        else if(option == "--port")                 port = std::stoi(value);
+        else if(option == "--speed")                speed = std::stod(value);
+        else if(option == "--curvature-points")     num_curvature_points = std::stoi(value);
+        else {
+            std::cerr << "unknown option " << option << std::endl;
+            printUsage();
+            return 1;
+        }
+    }
+
+    if(speed < 0){
+        std::cerr << "the speed cannot be negative" << std::endl;
+        return 1;
+    }
+
+
+
+    std::shared_ptr<FrameSource> source;
+    std::string description;
+
+    if(files.size() == 1){
+        auto replay = std::make_shared<RawCaptureReplay>(files[0], loop);
+        if(not replay->isOpen())
+            return 1;
+
+        source = replay;
+        description = "raw capture " + files[0];
+        port = port < 0 ? 5001 : port;
+    }
+    else if(files.size() == 2){
+        auto replay = std::make_shared<RecordedSamplesReplay>(files[0], files[1], loop, num_curvature_points);
+        if(not replay->isOpen())
+            return 1;
+
+        source = replay;
+        description = (replay->getDevice() == RecordedSamplesReplay::Device::SHAPE_SENSING ? "Shape Sensing" : "IllumiSense")
+                      + std::string(" recording ") + files[1] + " (" + std::to_string(replay->getNumberOfSamples()) + " samples)";
+        port = port < 0 ? replay->getDefaultPort() : port;
+    }
+    else {
+        printUsage();
+        return 1;
+    }
+
+
+    FrameServer server(source, address, static_cast<unsigned short>(port), control);
+    server.setSpeed(speed);
+
+    if(not server.start())
+        return 1;
+
+    std::cout << "Replaying the " << description << " on " << address << ":" << server.getPort() << std::endl;
+
+
+    while(server.isRunning()){
+        std::cout << "clients : " << server.getNumberOfClients()
+                  << ", samples sent : " << server.getNumberOfFramesSent()
+                  << ", MB sent : " << server.getNumberOfBytesSent()/1000000 << "    \r";
+        std::cout.flush();
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+
+    server.wait();
+
+    std::cout << "\nsamples sent : " << server.getNumberOfFramesSent() << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,186 @@
+
+//includes
+#include <iostream>
+#include <string>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <csignal>
+
+#include "fbgs-sensing/frame_server.h"
+#include "fbgs-sensing/shape_sensing_simulator.h"
+#include "fbgs-sensing/illumisense_simulator.h"
+
+
+
+// Stands in for the interrogators on localhost, so that the interfaces can be run, tested and benchmarked
+// without the hardware:
+//      fbgs_simulator --rate 1000 --sensors 2 --gratings 20 --points 300
+// then connect a ShapeSensingInterface to 127.0.0.1:5001, or
+//      fbgs_simulator --device illumisense --rate 1000 --cores 6 --twist 2 --spin 300
+// then connect an IllumiSenseInterface to 127.0.0.1:2055
+
+
+
+std::shared_ptr<AcquisitionControl> control =
+    std::make_shared<AcquisitionControl>();
+
+
+
+
+void my_handler(int)
+{
+    control->shutdown();
+}
+
+
+
+void printUsage()
+{
+    std::cout << "Usage: fbgs_simulator [options]\n"
+                 "  --device <shape|illumisense> interrogator to simulate (shape)\n"
+                 "  --address <ip>               address to listen on (127.0.0.1)\n"
+                 "  --port <port>                port to listen on (5001, 2055 for illumisense)\n"
+                 "  --rate <Hz>                  sample rate, 100 Hz to 10 kHz (100)\n"
+                 "  --speed <factor>             1 in real time, 0 as fast as the client reads (1)\n"
+                 "  --samples <n>                samples to send, 0 for an endless stream (0)\n"
+                 "  --gratings <n>               gratings per channel (10)\n"
+                 "  --curvature <1/m>            amplitude of the curvature (10)\n"
+                 "  --bending-frequency <Hz>     frequency of the bending (0.5)\n"
+                 "  --rotation-frequency <Hz>    rotation of the bending plane (0.1)\n"
+                 "  --twist <rad/m>              amplitude of the twist (0)\n"
+                 "  --elongation <m/m>           amplitude of the axial strain (0)\n"
+                 "  --spin <rad/m>               winding of the outer cores (0)\n"
+                 "Shape Sensing:\n"
+                 "  --sensors <n>                number of sensors, 4 channels each (1)\n"
+                 "  --points <n>                 shape points per sensor, 1 mm apart (200)\n"
+                 "IllumiSense:\n"
+                 "  --cores <n>                  outer cores, one channel each (3)\n"
+                 "  --central-core <0|1>         adds the central core as the last channel (1)\n"
+                 "  --length <m>                 length of the fiber (0.2)\n"
+                 "  --noise <microstrain>        standard deviation of the strain noise (0)\n";
+}
+
+
+
+
+int main(int argc, char **argv)
+{
+    // make sure we catch the ctrl+c signal to kill the application properly.
+    struct sigaction sigIntHandler;
+    sigIntHandler.sa_handler = my_handler;
+    sigemptyset(&sigIntHandler.sa_mask);
+    sigIntHandler.sa_flags = 0;
+    sigaction(SIGINT, &sigIntHandler, NULL);
+
+
+
+    std::string device = "shape";
+    std::string address = "127.0.0.1";
+    int port = -1;
+    double speed = 1;
+
+    ShapeSensingSimulator::Config config;
+    IllumiSenseSimulator::Config illumisense_config;
+
+    for(int i=1; i<argc; i++){
+        const std::string option = argv[i];
+
+        if(option == "--help" or option == "-h"){
+            printUsage();
+            return 0;
+        }
+
+        if(i + 1 >= argc){
+            std::cerr << "missing value for " << option << std::endl;
+            printUsage();
+            return 1;
+        }
+
+        const std::string value = argv[++i];
+
+        if(option == "--device")                    device = value;
+        else if(option == "--address")              address = value;
+        else if(option == "--port")                 port = std::stoi(value);
+        else if(option == "--rate")                 config.frequency = std::stod(value);
+        else if(option == "--speed")                speed = std::stod(value);
+        else if(option == "--samples")              config.num_samples = std::stoull(value);
+        else if(option == "--gratings")             config.num_gratings = std::stoi(value);
+        else if(option == "--curvature")            config.motion.curvature_amplitude = std::stod(value);
+        else if(option == "--bending-frequency")    config.motion.bending_frequency = std::stod(value);
+        else if(option == "--rotation-frequency")   config.motion.rotation_frequency = std::stod(value);
+        else if(option == "--twist")                config.motion.twist_amplitude = std::stod(value);
+        else if(option == "--elongation")           config.motion.elongation_amplitude = std::stod(value);
+        else if(option == "--spin")                 config.motion.spin_rate = std::stod(value);
+        else if(option == "--sensors")              config.num_sensors = std::stoi(value);
+        else if(option == "--points")               config.num_shape_points = std::stoi(value);
+        else if(option == "--cores")                illumisense_config.num_outer_cores = std::stoi(value);
+        else if(option == "--central-core")         illumisense_config.central_core = std::stoi(value) != 0;
+        else if(option == "--length")               illumisense_config.motion.length = std::stod(value);
+        else if(option == "--noise")                illumisense_config.strain_noise = std::stod(value);
+        else {
+            std::cerr << "unknown option " << option << std::endl;
+            printUsage();
+            return 1;
+        }
+    }
+
+    if(config.frequency <= 0 or config.num_sensors < 1 or config.num_gratings < 1 or config.num_shape_points < 1
+       or illumisense_config.num_outer_cores < 1 or illumisense_config.motion.length <= 0){
+        std::cerr << "the rate, sensors, gratings, points, cores and length must be positive" << std::endl;
+        return 1;
+    }
+
+
+
+    std::shared_ptr<FrameSource> source;
+
+    if(device == "shape"){
+        source = std::make_shared<ShapeSensingSimulator>(config);
+        port = port < 0 ? 5001 : port;
+    }
+    else if(device == "illumisense"){
+        //  The options shared by both devices
+        const double length = illumisense_config.motion.length;
+        illumisense_config.motion = config.motion;
+        illumisense_config.motion.length = length;
+        illumisense_config.frequency = config.frequency;
+        illumisense_config.num_samples = config.num_samples;
+        illumisense_config.num_gratings = config.num_gratings;
+
+        source = std::make_shared<IllumiSenseSimulator>(illumisense_config);
+        port = port < 0 ? 2055 : port;
+    }
+    else {
+        std::cerr << "unknown device " << device << std::endl;
+        printUsage();
+        return 1;
+    }
+
+
+    FrameServer server(source, address, static_cast<unsigned short>(port), control);
+    server.setSpeed(speed);
+
+    if(not server.start())
+        return 1;
+
+    std::cout << "Simulating the " << (device == "shape" ? "Shape Sensing" : "IllumiSense") << " interrogator on " << address << ":" << server.getPort()
+              << " at " << config.frequency << " Hz" << std::endl;
+
+
+    while(server.isRunning()){
+        std::cout << "clients : " << server.getNumberOfClients()
+                  << ", samples sent : " << server.getNumberOfFramesSent()
+                  << ", MB sent : " << server.getNumberOfBytesSent()/1000000 << "    \r";
+        std::cout.flush();
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+
+    server.wait();
+
+    std::cout << "\nsamples sent : " << server.getNumberOfFramesSent() << std::endl;
+
+    return 0;
+}
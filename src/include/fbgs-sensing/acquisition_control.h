@@ -0,0 +1,78 @@
+/*
+This code implements the control of the acquisition threads of the interfaces
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+
+
+// This class replaces the shared boolean flags used to start, stop and shutdown the acquisition.
+// The state is atomic and every change is notified on an eventfd per listener, so that an acquisition
+// thread can sleep in poll() on its socket and on its eventfd at the same time: it wakes up as soon as
+// either data arrives or the state changes, and costs no CPU otherwise.
+//
+// startRecording(), stopRecording() and shutdown() only use atomics and write(), they are
+// async-signal-safe and can be called from a signal handler.
+class AcquisitionControl
+{
+public:
+
+    enum class State
+    {
+        IDLE,
+        RECORDING,
+        SHUTDOWN
+    };
+
+
+    AcquisitionControl();
+
+    ~AcquisitionControl();
+
+    AcquisitionControl(const AcquisitionControl&) = delete;
+    AcquisitionControl &operator=(const AcquisitionControl&) = delete;
+
+
+    void startRecording();
+    void stopRecording();
+    void shutdown();
+
+    State getState() const { return m_state.load(std::memory_order_acquire); }
+
+    bool isRecording() const { return getState() == State::RECORDING; }
+    bool isShutdown() const { return getState() == State::SHUTDOWN; }
+
+
+    // Every listener gets its own eventfd, readable after any state change. Returns -1 on failure
+    int addListener();
+    void removeListener(const int t_event_fd);
+
+    // Resets the eventfd of a listener once the change has been handled
+    static void clearEvents(const int t_event_fd);
+
+
+    // Sleeps until t_fd is readable, the state changes or the timeout (in ms, -1 for none) expires.
+    // Returns true only if t_fd is readable
+    static bool waitReadable(const int t_fd,
+                             const int t_event_fd,
+                             const int t_timeout_ms=-1);
+
+    // Number of bytes queued before a socket is readable (SO_RCVLOWAT), e.g. FRAME_HEADER_SIZE so that a
+    // partial header does not wake the thread up, only to find that the frame cannot be read yet.
+    // A closed connection is readable whatever the threshold
+    static bool setReadableThreshold(const int t_fd,
+                                     const int t_bytes);
+
+
+private:
+
+    void notifyListeners();
+
+    static constexpr unsigned int MAX_LISTENERS { 32 };
+
+    std::atomic<State> m_state { State::IDLE };
+
+    std::array<std::atomic<int>, MAX_LISTENERS> m_listeners;
+};
@@ -0,0 +1,95 @@
+/*
+This code implements the acquisition of several FBGS devices from a single thread
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <functional>
+#include <utility>
+
+#include <boost/asio.hpp>
+
+#include "fbgs-sensing/acquisition_control.h"
+#include "fbgs-sensing/shape_sensing_interface.h"
+#include "fbgs-sensing/illumisense_interface.h"
+
+
+// This class multiplexes the connections to several interrogators (or several streams of the same one)
+// on a single io_context. All the devices are read with asynchronous operations and served by one
+// thread blocked in epoll, or by a small pool. Every device keeps its own samples and sample callback.
+//
+// Example:
+//      AcquisitionManager manager;
+//      auto shape_sensing = manager.addShapeSensing("192.168.1.11", "5001");
+//      auto illumisense = manager.addIllumiSense("192.168.1.11", "2055");
+//      shape_sensing->setSampleCallback([](const ShapeSensingInterface::Sample &sample){ ... });
+//      manager.connect();
+//      manager.start();
+//      manager.startRecording();
+//      ...
+//      manager.stop();
+class AcquisitionManager
+{
+public:
+
+    AcquisitionManager(const unsigned int t_number_of_threads=1,
+                       std::shared_ptr<AcquisitionControl> t_control=nullptr);
+
+    ~AcquisitionManager();
+
+
+    std::shared_ptr<ShapeSensingInterface> addShapeSensing(const std::string &t_ip_address,
+                                                           const std::string &t_port_number="5001",
+                                                           const double t_frequency=100);
+
+    std::shared_ptr<IllumiSenseInterface> addIllumiSense(const std::string &t_ip_address,
+                                                         const std::string &t_port_number="2055",
+                                                         const double t_frequency=100);
+
+
+    // Connects all the devices, false if any of them failed
+    bool connect();
+
+    // Starts the asynchronous acquisition of all the devices and the threads running the io_context
+    void start();
+
+    // Shuts the acquisition down and waits for the threads
+    void stop();
+
+
+    void startRecording() { m_control->startRecording(); }
+    void stopRecording() { m_control->stopRecording(); }
+
+
+    std::shared_ptr<boost::asio::io_context> getIoContext() const { return m_io_context; }
+    std::shared_ptr<AcquisitionControl> getControl() const { return m_control; }
+
+
+private:
+
+    struct Device
+    {
+        std::function<bool()> connect;
+        std::function<void()> start;
+    };
+
+
+    unsigned int m_number_of_threads { 1 };
+
+    std::shared_ptr<AcquisitionControl> m_control { nullptr };
+    std::shared_ptr<boost::asio::io_context> m_io_context { nullptr };
+
+    //  Keeps the io_context running while no operation is pending
+    std::unique_ptr<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> m_work_guard;
+
+    std::vector<Device> m_devices;
+
+    //  The interfaces must outlive the threads running their handlers
+    std::vector<std::shared_ptr<void>> m_interfaces;
+
+    std::vector<std::thread> m_threads;
+};
@@ -0,0 +1,99 @@
+/*
+This code implements the synchronisation of the interrogator clock with the host clock
+*/
+
+#pragma once
+
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+
+// This class estimates the host time of every sample from its sample number. The interrogator
+// increments the sample number with its own clock, so the host arrival time is a linear function of it
+// plus the network and scheduling jitter: host_time = offset + period*sample_number + jitter.
+// The offset and period are tracked by an exponentially weighted recursive least squares regression
+// (the forgetting factor follows the slow drift of the clocks), and the synchronised time stamp of a
+// sample is the regression line evaluated at its sample number, without the jitter.
+//
+// The regression runs on coordinates centered on the weighted means, so it stays accurate whatever the
+// magnitude of the sample numbers. Samples arriving far from the line (a stalled connection flushing
+// its backlog) are left out of the regression, as well as isolated late samples (reordered by the network).
+// The estimator restarts if the sample number goes far backward, beyond the window of the regression, or
+// backward several times in a row (interrogator restarted), or if the line is lost.
+class ClockSynchronizer
+{
+public:
+
+    typedef std::chrono::high_resolution_clock::time_point TimePoint;
+
+
+    // The nominal frequency of the interrogator is only used to report the drift
+    ClockSynchronizer(const double t_forgetting_factor=0.999,
+                      const double t_nominal_frequency=0,
+                      const double t_outlier_threshold=5);
+
+
+    void reset();
+
+
+    // Includes the arrival time of a new sample and returns its synchronised time stamp.
+    // Until two samples are known, the arrival time is returned
+    TimePoint update(const std::int64_t t_sample_number,
+                     const TimePoint &t_arrival_time);
+
+    // Synchronised time stamp of any sample number with the current estimate
+    TimePoint synchronise(const std::int64_t t_sample_number) const;
+
+
+    bool isInitialised() const;
+
+    // Host time of sample number 0
+    TimePoint getOffset() const;
+
+    // Period of the samples measured with the host clock [s]
+    double getPeriod() const;
+
+    // Relative difference between the measured and nominal periods [ppm], 0 without nominal frequency
+    double getDriftPpm() const;
+
+    // Standard deviation of the arrival times around the regression [s]
+    double getJitter() const;
+
+    unsigned int getNumberOfResets() const;
+
+
+private:
+
+    TimePoint evaluate(const std::int64_t t_sample_number) const;
+
+    void restart(const std::int64_t t_sample_number,
+                 const TimePoint &t_arrival_time);
+
+
+    double m_forgetting_factor { 0.999 };
+    double m_nominal_period { 0 };
+    double m_outlier_threshold { 5 };
+
+    //  Origin of the centered coordinates
+    std::int64_t m_origin_sample_number { 0 };
+    TimePoint m_origin_time;
+
+    //  Exponentially weighted statistics, x is the sample number and y the arrival time [s]
+    double m_weight { 0 };
+    double m_mean_x { 0 };
+    double m_mean_y { 0 };
+    double m_covariance_xx { 0 };
+    double m_covariance_xy { 0 };
+    double m_residual_variance { 0 };
+
+    double m_period { 0 };
+
+    std::int64_t m_last_sample_number { 0 };
+    unsigned int m_number_of_updates { 0 };
+    unsigned int m_consecutive_outliers { 0 };
+    unsigned int m_consecutive_late { 0 };
+    unsigned int m_number_of_resets { 0 };
+
+    mutable std::mutex m_mutex;
+};
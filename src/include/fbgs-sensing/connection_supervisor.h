@@ -0,0 +1,107 @@
+/*
+This code implements the supervision of the connection to the interrogator
+*/
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <utility>
+
+#include <boost/asio.hpp>
+
+#include "fbgs-sensing/acquisition_control.h"
+
+
+struct ReconnectPolicy
+{
+    bool enabled { false };
+
+    //  Delay before the first attempt, doubled after every failure up to the maximum
+    std::chrono::milliseconds initial_backoff { 100 };
+    std::chrono::milliseconds max_backoff { 5000 };
+
+    std::chrono::milliseconds connect_timeout { 2000 };
+
+    //  Without data for this long the connection is considered lost, it should be
+    //  several sample periods. Also used for the TCP keepalive of the socket
+    std::chrono::milliseconds stall_timeout { 2000 };
+
+    //  0 to retry until the shutdown
+    unsigned int max_attempts { 0 };
+};
+
+
+
+// This class keeps the socket of an interface connected. When the link drops (interrogator rebooted,
+// cable unplugged) it reconnects with non-blocking connects and an exponential backoff, and every wait
+// is interrupted by the shutdown of the AcquisitionControl, so the acquisition thread can always be
+// joined. A dead peer that sends neither data nor FIN is detected with the stall timeout and TCP keepalive.
+class ConnectionSupervisor
+{
+public:
+
+    ConnectionSupervisor(std::shared_ptr<AcquisitionControl> t_control);
+
+    ~ConnectionSupervisor();
+
+
+    void setPolicy(const ReconnectPolicy &t_policy) { m_policy = t_policy; }
+    const ReconnectPolicy &getPolicy() const { return m_policy; }
+
+    bool isEnabled() const { return m_policy.enabled; }
+
+
+    // Single non-blocking connection attempt to every endpoint of the address, within the connect timeout
+    bool connect(boost::asio::ip::tcp::socket &t_socket,
+                 const std::string &t_ip_address,
+                 const std::string &t_port_number);
+
+    // Closes the socket and connects again with exponential backoff,
+    // false after the maximum number of attempts or at the shutdown
+    bool reconnect(boost::asio::ip::tcp::socket &t_socket,
+                   const std::string &t_ip_address,
+                   const std::string &t_port_number);
+
+    // Same as reconnect() with asynchronous operations on the executor of the socket,
+    // t_handler is called with the result
+    void asyncReconnect(boost::asio::ip::tcp::socket &t_socket,
+                        const std::string &t_ip_address,
+                        const std::string &t_port_number,
+                        std::function<void(bool)> t_handler);
+
+
+    // Waits until t_size bytes can be read from the socket,
+    // false if the connection is closed, stalls or at the shutdown
+    bool waitForBytes(boost::asio::ip::tcp::socket &t_socket,
+                      const std::size_t t_size);
+
+
+    unsigned int getNumberOfReconnections() const { return m_reconnections.load(std::memory_order_relaxed); }
+
+
+private:
+
+    void configureSocket(boost::asio::ip::tcp::socket &t_socket) const;
+
+    // Sleeps for t_duration unless the acquisition is shut down, false at the shutdown
+    bool sleepFor(const std::chrono::milliseconds t_duration) const;
+
+    std::chrono::milliseconds nextBackoff(const std::chrono::milliseconds t_backoff) const;
+
+
+    std::shared_ptr<AcquisitionControl> m_control;
+    int m_control_event_fd { -1 };
+
+    ReconnectPolicy m_policy;
+
+    std::atomic<unsigned int> m_reconnections { 0 };
+
+    //  State of the asynchronous reconnection
+    std::unique_ptr<boost::asio::steady_timer> m_timer;
+    std::chrono::milliseconds m_backoff { 0 };
+    unsigned int m_attempts { 0 };
+};
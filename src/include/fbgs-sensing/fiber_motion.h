@@ -0,0 +1,100 @@
+/*
+This code implements a synthetic motion of a multi-core fiber, used to simulate the interrogators
+*/
+
+#pragma once
+
+#include <Eigen/Dense>
+
+
+// This class describes a fiber bending and twisting over time. The curvature oscillates and decreases
+// linearly from the base to the tip, the bending plane rotates over time, and the fiber can be twisted
+// about its axis. From this motion the class gives the reference shape and the strains seen by the cores,
+// so that a simulated stream can be checked against the ground truth.
+//
+// The angles are measured in the cross section of the fiber, from the first outer core.
+class FiberMotion
+{
+public:
+
+    struct Parameters
+    {
+        double length { 0.2 };                  //  m
+
+        double curvature_amplitude { 10 };      //  1/m, at the base
+        double bending_frequency { 0.5 };       //  Hz
+        double rotation_frequency { 0.1 };      //  Hz, of the bending plane
+
+        double twist_amplitude { 0 };           //  rad/m
+        double twist_frequency { 0.2 };         //  Hz
+
+        double core_distance { 35e-6 };         //  m, from the center of the fiber to the outer cores
+
+        //  Winding of the outer cores around the axis (spun fiber), 0 for straight cores
+        double spin_rate { 0 };                 //  rad/m
+
+        double elongation_amplitude { 0 };      //  m/m, axial strain of the whole fiber
+        double elongation_frequency { 0.3 };    //  Hz
+    };
+
+
+    FiberMotion() = default;
+
+    explicit FiberMotion(const Parameters &t_parameters) : m_parameters(t_parameters) {}
+
+    const Parameters &getParameters() const { return m_parameters; }
+
+
+    // Curvature (1/m) and direction of the bending (rad) at the arc length t_s (m) and the time t_time (s)
+    double curvature(const double t_s, const double t_time) const;
+    double angle(const double t_s, const double t_time) const;
+
+    // Twist rate (rad/m), uniform along the fiber
+    double twist(const double t_time) const;
+
+
+    // Axial strain (m/m) of the fiber
+    double elongation(const double t_time) const;
+
+
+    // Angle (rad) at the arc length t_s of a core starting at t_core_angle at the base, following the spin
+    double coreAngle(const double t_s,
+                     const double t_core_angle) const;
+
+
+    // Bending strain (m/m) of a core at t_core_angle (rad) and t_core_distance (m) from the center.
+    // Positive in elongation, the cores on the inner side of the bend are compressed
+    double bendingStrain(const double t_s,
+                         const double t_time,
+                         const double t_core_angle,
+                         const double t_core_distance) const;
+
+
+    // Total strain (m/m) of a core, as measured by its gratings:
+    //
+    //      strain = elongation - curvature * d * cos(angle - core_angle(s)) + d^2 * spin_rate * twist
+    //
+    // where d is the distance of the core from the center. The last term is the stretching of the helical
+    // outer cores of a spun fiber when it is twisted, the central core only sees the elongation
+    double coreStrain(const double t_s,
+                      const double t_time,
+                      const double t_core_angle,
+                      const double t_core_distance) const;
+
+
+    // Positions of t_num_points points t_spacing (m) apart from the base, which is at the origin and
+    // tangent to z. Integrated along the fiber with the curvature and twist, one row per point
+    void shape(const double t_time,
+               const int t_num_points,
+               const double t_spacing,
+               Eigen::MatrixXd &t_shape) const;
+
+
+private:
+
+    //  Decrease of the curvature from the base (1) to the tip (0.5)
+    double taper(const double t_s) const;
+
+
+    Parameters m_parameters;
+};
@@ -0,0 +1,145 @@
+/*
+This code implements the utilities shared by the interfaces to handle the frames of the FBGS protocol
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <streambuf>
+#include <vector>
+#include <string_view>
+#include <charconv>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+
+// Every frame sent by the interrogator is a 4 bytes big endian length followed by that many bytes
+// of tab separated ASCII text
+constexpr std::size_t FRAME_HEADER_SIZE { 4 };
+
+//  Far above the frames of any topology, a larger size comes from a corrupted or desynchronised stream
+constexpr std::size_t MAX_FRAME_SIZE { 4 << 20 };
+
+
+inline std::uint32_t decodeFrameSize(const char *t_header)
+{
+    return std::uint32_t((unsigned char)(t_header[0])) << 24 |
+           std::uint32_t((unsigned char)(t_header[1])) << 16 |
+           std::uint32_t((unsigned char)(t_header[2])) << 8 |
+           std::uint32_t((unsigned char)(t_header[3]));
+}
+
+
+//  The stream cannot be read further after an invalid size, the connection has to be restarted
+inline bool isValidFrameSize(const std::uint32_t t_size)
+{
+    return t_size > 0 and t_size <= MAX_FRAME_SIZE;
+}
+
+
+inline void encodeFrameSize(const std::uint32_t t_size, char *t_header)
+{
+    t_header[0] = static_cast<char>((t_size >> 24) & 0xFF);
+    t_header[1] = static_cast<char>((t_size >> 16) & 0xFF);
+    t_header[2] = static_cast<char>((t_size >> 8) & 0xFF);
+    t_header[3] = static_cast<char>(t_size & 0xFF);
+}
+
+
+
+// Read only stream buffer over the bytes of a frame, to parse it with an std::istream without copies
+class FrameBuffer : public std::streambuf
+{
+public:
+    FrameBuffer(const char *t_data, const std::size_t t_size)
+    {
+        char *begin = const_cast<char*>(t_data);
+        setg(begin, begin, begin + t_size);
+    }
+};
+
+
+
+// Writers of the fields of a frame, used to generate streams (simulators, replay). Every field is followed
+// by a tab and the frame ends with a new line, endFrame() fills in the header once the size is known
+inline void beginFrame(std::vector<char> &t_frame)
+{
+    t_frame.resize(FRAME_HEADER_SIZE);
+}
+
+
+inline void appendText(std::vector<char> &t_frame, const std::string_view t_text)
+{
+    t_frame.insert(t_frame.end(), t_text.begin(), t_text.end());
+    t_frame.push_back('\t');
+}
+
+
+inline void appendInteger(std::vector<char> &t_frame, const std::int64_t t_value)
+{
+    char buffer[24];
+    const std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), t_value);
+    t_frame.insert(t_frame.end(), buffer, result.ptr);
+    t_frame.push_back('\t');
+}
+
+
+inline void appendDecimal(std::vector<char> &t_frame, const double t_value, const int t_precision)
+{
+    constexpr std::int64_t POWERS_OF_TEN[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+
+    char buffer[64];
+    char *end = buffer;
+
+    //  Formatted as a scaled integer, several times faster than std::to_chars with a precision
+    const double scaled = t_value*POWERS_OF_TEN[std::clamp(t_precision, 0, 9)];
+    if(t_precision >= 0 and t_precision <= 9 and std::abs(scaled) < 1e18){
+        const std::int64_t power = POWERS_OF_TEN[t_precision];
+        const std::int64_t rounded = std::llround(scaled);
+        const std::uint64_t magnitude = static_cast<std::uint64_t>(rounded < 0 ? -rounded : rounded);
+
+        if(rounded < 0)
+            *end++ = '-';
+        end = std::to_chars(end, buffer + sizeof(buffer), magnitude/power).ptr;
+
+        if(t_precision > 0){
+            *end++ = '.';
+            char *fraction = end;
+            end += t_precision;
+            std::uint64_t digits = magnitude % power;
+            for(char *digit = end - 1; digit >= fraction; digit--){
+                *digit = static_cast<char>('0' + digits % 10);
+                digits /= 10;
+            }
+        }
+    }
+    else
+        end = std::to_chars(buffer, buffer + sizeof(buffer), t_value, std::chars_format::fixed, t_precision).ptr;
+
+    t_frame.insert(t_frame.end(), buffer, end);
+    t_frame.push_back('\t');
+}
+
+
+// Time of the day as written by the interrogator (hh:mm:ss.mmm), from a time in s
+inline void appendClock(std::vector<char> &t_frame, const double t_time)
+{
+    //  Wrapped to a day, negative times included
+    constexpr std::int64_t DAY { 86400000 };
+    const std::int64_t milliseconds = (static_cast<std::int64_t>(std::floor(1000*t_time)) % DAY + DAY) % DAY;
+
+    char clock[32];
+    std::snprintf(clock, sizeof(clock), "%02d:%02d:%02d.%03d",
+                  int(milliseconds/3600000), int(milliseconds/60000 % 60), int(milliseconds/1000 % 60), int(milliseconds % 1000));
+
+    appendText(t_frame, clock);
+}
+
+
+inline void endFrame(std::vector<char> &t_frame)
+{
+    t_frame.push_back('\n');
+    encodeFrameSize(static_cast<std::uint32_t>(t_frame.size() - FRAME_HEADER_SIZE), t_frame.data());
+}
@@ -0,0 +1,117 @@
+/*
+This code implements a TCP server streaming frames of the FBGS protocol, used to stand in for the interrogator
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+#include "fbgs-sensing/acquisition_control.h"
+
+
+// A stream of frames served by a FrameServer: simulated devices, recordings...
+class FrameSource
+{
+public:
+
+    virtual ~FrameSource() = default;
+
+    // Writes the next frame, its 4 bytes header included, in t_frame (reused between calls), and the time
+    // in s at which it is sent, relative to any origin. False at the end of the stream
+    virtual bool nextFrame(std::vector<char> &t_frame,
+                           double &t_time) = 0;
+
+    // Called when a new client connects
+    virtual void reset() {}
+
+    // Called just before a frame is sent, e.g. to record its send time
+    virtual void onSend(const std::vector<char> &) {}
+};
+
+
+
+// This class serves the frames of a FrameSource on a TCP port, like the interrogator does: one client at a time,
+// the stream continues with the next client after a disconnection. The frames are sent at the times given by
+// the source, scaled by the speed, on an absolute schedule so that a late frame does not delay the following ones.
+// The server runs in its own thread and stops at the shutdown of its AcquisitionControl or at the end of the source.
+//
+// Example, a simulated interrogator on localhost for the interfaces:
+//      FrameServer server(std::make_shared<ShapeSensingSimulator>(config), "127.0.0.1", 5001);
+//      server.start();
+class FrameServer
+{
+public:
+
+    FrameServer(std::shared_ptr<FrameSource> t_source,
+                const std::string &t_address="127.0.0.1",
+                const unsigned short t_port=5001,
+                std::shared_ptr<AcquisitionControl> t_control=nullptr);
+
+    ~FrameServer();
+
+    FrameServer(const FrameServer&) = delete;
+    FrameServer &operator=(const FrameServer&) = delete;
+
+
+    // 1 for the timing of the source, N for N times faster, 0 as fast as the client reads
+    void setSpeed(const double t_speed) { m_speed = t_speed; }
+
+
+    // Binds the port and starts serving, false if the port cannot be bound
+    bool start();
+
+    void stop();
+
+    // Blocks until the server stops
+    void wait();
+
+
+    // The port actually bound, useful with port 0 (any free port)
+    unsigned short getPort() const { return m_port; }
+
+    bool isRunning() const { return m_running.load(std::memory_order_acquire); }
+
+    std::uint64_t getNumberOfFramesSent() const { return m_frames_sent.load(std::memory_order_relaxed); }
+    std::uint64_t getNumberOfBytesSent() const { return m_bytes_sent.load(std::memory_order_relaxed); }
+    unsigned int getNumberOfClients() const { return m_clients.load(std::memory_order_relaxed); }
+
+
+private:
+
+    void serve();
+
+    // Streams the frames to a client until it disconnects (true) or the server stops (false)
+    bool stream(const int t_client_fd);
+
+    bool sendAll(const int t_client_fd,
+                 const char *t_data,
+                 std::size_t t_size);
+
+    // Sleeps until t_deadline_ns (CLOCK_MONOTONIC), false at the shutdown
+    bool sleepUntil(const std::int64_t t_deadline_ns);
+
+
+    std::shared_ptr<FrameSource> m_source;
+
+    std::string m_address;
+    unsigned short m_port;
+
+    std::shared_ptr<AcquisitionControl> m_control;
+    int m_control_event_fd { -1 };
+
+    int m_listen_fd { -1 };
+
+    double m_speed { 1 };
+
+    std::thread m_thread;
+    std::atomic<bool> m_running { false };
+
+    std::atomic<std::uint64_t> m_frames_sent { 0 };
+    std::atomic<std::uint64_t> m_bytes_sent { 0 };
+    std::atomic<unsigned int> m_clients { 0 };
+};
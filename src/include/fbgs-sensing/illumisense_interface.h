@@ -11,13 +11,20 @@ Copyright (C) 2022 Sven Lilge, Continuum Robotics Laboratory, University of Toro
 #include <vector>
 #include <Eigen/Dense>
 
+#include <utility>
+#include <optional>
+
 #include <boost/array.hpp>
 #include <boost/asio.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/use_awaitable.hpp>
 
 
 #include <deque>
 
 #include <memory>
+#include <functional>
+#include <array>
 
 #include <real_time_tools/timer.hpp>
 #include <real_time_tools/spinner.hpp>
@@ -26,14 +33,27 @@ Copyright (C) 2022 Sven Lilge, Continuum Robotics Laboratory, University of Toro
 
 #include <yaml-cpp/yaml.h>
 
+#include "fbgs-sensing/acquisition_control.h"
+#include "fbgs-sensing/connection_supervisor.h"
+#include "fbgs-sensing/wait_policy.h"
+#include "fbgs-sensing/real_time_config.h"
+#include "fbgs-sensing/strain_converter.h"
+#include "fbgs-sensing/clock_synchronizer.h"
+#include "fbgs-sensing/sample_sequence_monitor.h"
+#include "fbgs-sensing/shared_memory_ring.h"
+#include "fbgs-sensing/raw_capture.h"
+#include "fbgs-sensing/instrumentation.h"
+#include "fbgs-sensing/memory_footprint.h"
+
 // This class implements a simple interface to the FBGS sensing system utilizing TCP sockets
 class IllumiSenseInterface
 {
 public:
-    // Constructor
-    IllumiSenseInterface(std::shared_ptr<const bool> t_stop_demos,
-                                               std::shared_ptr<const bool> t_start_recording,
-                                               const double t_frequency);
+    // Constructor, the control and the io_context can be shared among several interfaces
+    // (see AcquisitionManager), new ones are created if not given
+    IllumiSenseInterface(std::shared_ptr<AcquisitionControl> t_control=nullptr,
+                         const double t_frequency=100,
+                         std::shared_ptr<boost::asio::io_context> t_io_context=nullptr);
 	
 	// Simple destructor
 	~IllumiSenseInterface();
@@ -53,26 +73,187 @@ public:
 		
 		
 		int sample_number;
+        //  Samples lost between the previous sample and this one
+        unsigned int missed_since_previous { 0 };
 		int num_channels;
 
 
         int number_of_engineered_values;
         std::chrono::high_resolution_clock::time_point time_stamp;
+        //  Time stamp without the transport jitter, equal to time_stamp without a ClockSynchronizer
+        std::chrono::high_resolution_clock::time_point synchronised_time_stamp;
+        //  Stages of the acquisition of the sample, with time_stamp (frame read): the frame started to be read
+        //  (the socket was readable, or the previous frame done) and the frame was parsed
+        std::chrono::high_resolution_clock::time_point readable_time_stamp;
+        std::chrono::high_resolution_clock::time_point parsed_time_stamp;
 		std::vector<Channel> channels;
 	};
 	
 	
+    void setAddress(const std::string &t_ip_address, const std::string &t_port_number)
+    {
+        m_ip_address = t_ip_address;
+        m_port_number = t_port_number;
+    }
+
 	bool connect();
 
 
     void startRecordinLoop();
 
 
+    //  Reads the stream with asynchronous operations on the io_context, which must be run by the caller.
+    //  Alternative to startRecordinLoop() to serve several devices from the same thread
+    void startAsyncAcquisition();
+
+    //  Coroutine alternative to startAsyncAcquisition(), the two must not be used together.
+    //  The next sample of the stream, empty once the stream ended (closed without reconnection or shutdown).
+    //  The sample goes through the same processing and recording as with the other acquisition modes.
+    //  Example, with several devices on the same io_context (see SampleStream on testing a co_await):
+    //      boost::asio::co_spawn(*io_context, [&]() -> boost::asio::awaitable<void> {
+    //          while(std::optional<Sample> sample = co_await interface.next()){
+    //              ...
+    //          }
+    //      }, boost::asio::detached);
+    boost::asio::awaitable<std::optional<Sample>> next();
+
+    //  Same as next() but reuses t_sample, false once the stream ended
+    boost::asio::awaitable<bool> next(Sample &t_sample);
+
+
+    //  Called from the acquisition thread for every new sample
+    void setSampleCallback(std::function<void(const Sample&)> t_sample_callback)
+    {
+        m_sample_callback = t_sample_callback;
+    }
+
+
+    //  Polling alternative to the acquisition modes: a frame is ready to be read, then read, parsed and processed (not recorded)
+    bool nextSampleReady();
+    bool readNextSample(Sample &sample);
+
+
+    //  Parses a raw frame (without the 4 bytes size), the time stamp is left to the caller
+    bool parseFrame(const char *t_data,
+                    const std::size_t t_size,
+                    Sample &sample) const;
+
+
+    //  Wake the acquisition thread immediately, see AcquisitionControl
+    void startRecording() { m_control->startRecording(); }
+    void stopRecording() { m_control->stopRecording(); }
+
+    //  Also waits for the acquisition thread to finish, so the samples can be safely read afterwards.
+    //  From a signal handler use getControl()->shutdown() instead
+    void shutdown()
+    {
+        m_control->shutdown();
+
+        joinRecordingThread();
 
+        if(m_raw_capture)
+            m_raw_capture->close();
+        if(m_spill_capture)
+            m_spill_capture->close();
+    }
 
 
+    //  Scheduling, affinity and memory settings of the thread started by startRecordinLoop()
+    void setRealTimeConfig(const RealTimeConfig &t_real_time_config)
+    {
+        m_real_time_config = t_real_time_config;
+    }
 
+    std::shared_ptr<AcquisitionControl> getControl() const { return m_control; }
+
+
+    //  Reconnects automatically when the link drops, the recording continues after the gap
+    void setReconnectPolicy(const ReconnectPolicy &t_reconnect_policy)
+    {
+        m_connection_supervisor.setPolicy(t_reconnect_policy);
+    }
+
+    unsigned int getNumberOfReconnections() const { return m_connection_supervisor.getNumberOfReconnections(); }
+
+
+    //  How the thread started by startRecordinLoop() waits for the frames, to be set before it starts
+    void setWaitPolicy(const WaitPolicy &t_wait_policy)
+    {
+        m_socket_waiter.setPolicy(t_wait_policy);
+    }
+
+    //  CPU time and wake-up latency of the acquisition thread, to choose the wait policy
+    SocketWaiter::Statistics getWaitStatistics() const { return m_socket_waiter.getStatistics(); }
+
+
+
+
+
+
+    //  The time stamps are the synchronised ones, without the jitter when a ClockSynchronizer is set
     void getSamplesData(YAML::Node &t_FBGS_node, Eigen::MatrixXd &t_FBGS_data)const;
+
+
+    //  Drops, duplicates and reorders of the stream since the connection, can be called at any time
+    SampleSequenceMonitor::Statistics getSequenceStatistics() const
+    {
+        return m_sequence_monitor.getStatistics();
+    }
+
+
+    //  Estimates the time stamps of the samples from their sample numbers
+    void setClockSynchronizer(std::shared_ptr<ClockSynchronizer> t_clock_synchronizer)
+    {
+        m_clock_synchronizer = t_clock_synchronizer;
+    }
+
+
+    //  Computes the strains from the peak wavelengths instead of using the engineered values
+    void setStrainConverter(std::shared_ptr<StrainConverter> t_strain_converter)
+    {
+        m_strain_converter = t_strain_converter;
+    }
+
+
+    //  Publishes every new sample in a shared memory ring, read by other processes with a SharedMemoryReader.
+    //  The segment is created at the first sample, with the blocks "channel<i>/wavelengths",
+    //  "channel<i>/powers" and "channel<i>/strains" (num_gratings x 1)
+    void enableSharedMemoryPublisher(const std::string &t_name,
+                                     const unsigned int t_num_slots=64)
+    {
+        m_shared_memory_publisher = std::make_unique<SharedMemoryPublisher>(t_name, t_num_slots);
+    }
+
+
+    //  Raw capture mode, the cheapest acquisition: while recording, the thread started by startRecordinLoop() and
+    //  the asynchronous acquisition append the frames with their receive times to a raw capture instead of parsing
+    //  them, so there are no samples, callbacks nor processing (next() parses and captures). The capture is parsed offline
+    //  with parseRawCapture() and loadSamples(), see fbgs_parse_capture. The file is complete after shutdown()
+    bool enableRawCapture(const std::string &t_file_name,
+                          const RawCaptureConfig &t_config=RawCaptureConfig());
+
+    RawCaptureWriter::Statistics getRawCaptureStatistics() const
+    {
+        return m_raw_capture ? m_raw_capture->getStatistics() : RawCaptureWriter::Statistics();
+    }
+
+    //  Adds samples parsed offline to the recorded ones, through the online processing, to export them with
+    //  getSamplesData(). The times are counted from the first sample
+    void loadSamples(std::vector<Sample> &t_samples);
+
+
+    //  Memory of the recorded samples (bytes per sample, total, projection), can be called at any time
+    MemoryFootprint getMemoryFootprint() const { return m_memory_account.getFootprint(); }
+
+    //  Limits the memory of the recorded samples, to warn or spill to a raw capture before it runs out.
+    //  The spill file continues the recording of the thread started by startRecordinLoop(), of the asynchronous
+    //  acquisition and of next(), from the frame that does not fit, while the samples are still parsed and
+    //  processed. It is created here, with blocks sized from the budget and counted in it, so that nothing is
+    //  allocated when the memory runs out
+    void setMemoryBudget(const MemoryBudget &t_memory_budget);
+
+    //  Bytes of a recorded sample, with the allocator overhead of its buffers
+    static std::size_t sampleBytes(const Sample &sample);
 	
 
 private:
@@ -82,10 +263,21 @@ private:
 	bool m_connected;
 	double m_radius;
 			
-	boost::asio::io_context m_io_context;
+    std::shared_ptr<boost::asio::io_context> m_io_context;
 	boost::asio::ip::tcp::resolver m_resolver;
 	boost::asio::ip::tcp::socket m_socket;
 
+    //  Last frame received, reused to avoid allocations
+    std::vector<char> m_frame;
+    std::chrono::high_resolution_clock::time_point m_frame_time_stamp;
+    std::chrono::high_resolution_clock::time_point m_readable_time_stamp;
+
+    //  State of the asynchronous acquisition
+    std::array<char, 4> m_async_header;
+    Sample m_async_sample;
+
+    std::function<void(const Sample&)> m_sample_callback { nullptr };
+
 
 
 
@@ -95,13 +287,62 @@ private:
 
 
 
-    std::shared_ptr<const bool> m_stop_demos { nullptr };
+    std::shared_ptr<AcquisitionControl> m_control { nullptr };
+
+    //  Readable whenever the state of the control changes
+    int m_control_event_fd { -1 };
 
-    std::shared_ptr<const bool> m_start_recording { nullptr };
+    ConnectionSupervisor m_connection_supervisor;
+
+    SocketWaiter m_socket_waiter;
+
+
+    SampleSequenceMonitor m_sequence_monitor;
+
+    std::shared_ptr<ClockSynchronizer> m_clock_synchronizer { nullptr };
+
+    std::shared_ptr<StrainConverter> m_strain_converter { nullptr };
+
+    std::unique_ptr<SharedMemoryPublisher> m_shared_memory_publisher { nullptr };
+
+    std::unique_ptr<RawCaptureWriter> m_raw_capture { nullptr };
+
+    //  Receives the frames recorded once the memory budget is exhausted
+    std::unique_ptr<RawCaptureWriter> m_spill_capture { nullptr };
+    bool m_spill_active { false };
+
+    //  Appends the last frame read to the raw capture if recording
+    void captureFrame();
+
+    //  Keeps the sample in the recorded samples within the memory budget, false if it does not fit
+    bool recordSample(const Sample &sample);
+
+    SampleMemoryAccount m_memory_account;
 
 
 
     std::thread thread;
+
+    RealTimeConfig m_real_time_config;
+    real_time_tools::RealTimeThread m_real_time_thread;
+    bool m_real_time_thread_running { false };
+
+    static void *recordingLoopHelper(void *t_interface)
+    {
+        static_cast<IllumiSenseInterface*>(t_interface)->recordingLoop();
+        return nullptr;
+    }
+
+    void joinRecordingThread()
+    {
+        if(thread.joinable() and thread.get_id() != std::this_thread::get_id())
+            thread.join();
+
+        if(m_real_time_thread_running){
+            m_real_time_thread.join();
+            m_real_time_thread_running = false;
+        }
+    }
     std::chrono::high_resolution_clock::time_point m_start;
 
 
@@ -110,8 +351,16 @@ private:
 
 
     void recordingLoop();
-    bool nextSampleReady();
-    bool readNextSample(Sample &sample);
+
+    //  The steps of readNextSample()
+    bool readFrame();
+    void processSample(Sample &sample);
+    void publishSample(const Sample &sample);
+    void storeSample(const Sample &sample);
+
+    void asyncReadFrame();
+    void onAsyncReadError(const boost::system::error_code &t_error);
+    boost::asio::awaitable<bool> awaitReconnection();
 
 
     void extracted(Sample const &sample,
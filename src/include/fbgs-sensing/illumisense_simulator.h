@@ -0,0 +1,93 @@
+/*
+This code implements a simulation of the stream of the FBGS IllumiSense interrogator
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <random>
+#include <cstdint>
+
+#include "fbgs-sensing/frame_server.h"
+#include "fbgs-sensing/fiber_motion.h"
+
+
+// This class generates the frames of the IllumiSense interrogator, in the exact format parsed by
+// IllumiSenseInterface, for a multi-core fiber following a FiberMotion. Every channel is a core: the outer
+// cores are evenly spread around the center, optionally followed by the central core. The gratings are evenly
+// spread along the fiber, their peak wavelengths follow the strains of FiberMotion::coreStrain()
+//
+//      lambda = lambda_0 * ( 1 + k * strain )
+//
+// and the engineered values are the same strains in microstrain, as computed by the interrogator.
+// The ground truth is available from the motion and the geometry, to check a reconstruction offline.
+class IllumiSenseSimulator : public FrameSource
+{
+public:
+
+    struct Config
+    {
+        double frequency { 100 };               //  Hz
+
+        int num_outer_cores { 3 };
+        bool central_core { true };
+        int num_gratings { 10 };                //  per core
+
+        //  0 for an endless stream
+        std::uint64_t num_samples { 0 };
+
+        FiberMotion::Parameters motion;
+
+        double gauge_factor { 0.78 };
+
+        //  Standard deviation of the noise added to the strains, microstrain
+        double strain_noise { 0 };
+    };
+
+
+    explicit IllumiSenseSimulator(const Config &t_config);
+
+
+    bool nextFrame(std::vector<char> &t_frame,
+                   double &t_time) override;
+
+
+    const Config &getConfig() const { return m_config; }
+
+    const FiberMotion &getMotion() const { return m_motion; }
+
+    int getNumberOfChannels() const { return m_config.num_outer_cores + (m_config.central_core ? 1 : 0); }
+
+    // Geometry of the cores (channels) and of the gratings
+    double getCoreAngle(const int t_channel) const;
+    double getCoreDistance(const int t_channel) const;
+    double getGratingPosition(const int t_grating) const;
+
+    // Unstrained wavelength (nm) of a grating, the cores are interleaved in the spectrum
+    double getReferenceWavelength(const int t_channel,
+                                  const int t_grating) const;
+
+    // Strain (microstrain) of a grating at the time of a sample, without noise
+    double getStrain(const int t_channel,
+                     const int t_grating,
+                     const std::uint64_t t_sample_number) const;
+
+
+private:
+
+    Config m_config;
+
+    FiberMotion m_motion;
+
+    //  The interrogator keeps counting when the client reconnects
+    std::uint64_t m_sample_number { 0 };
+
+    std::string m_date;
+
+    //  Reused between frames
+    std::vector<double> m_strains;
+
+    std::mt19937 m_generator;
+    std::normal_distribution<double> m_noise;
+};
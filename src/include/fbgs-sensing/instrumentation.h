@@ -0,0 +1,172 @@
+/*
+This code implements the timing of the stages of the acquisition
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+
+// Times the stages of the acquisition: read (readFrame(), the blocking reads), parse (parseFrame()), process (processSample()),
+// store (storeSample(), with the sample callback) and export (getSamplesData(), getSamplesModalData()).
+// The stages are timed with the time stamp counter of the CPU (steady_clock elsewhere) and kept in histograms
+// owned by the thread that runs them, written without locks nor read-modify-write operations; getStats()
+// merges the histograms of all the threads, from any thread, during the acquisition.
+//
+// The timers are only compiled with the CMake option FBGS_ENABLE_INSTRUMENTATION (which defines the macro
+// of the same name), otherwise FBGS_INSTRUMENT_STAGE expands to nothing and getStats() reports no samples.
+//
+// Example, printing the stages every 5 s:
+//      Instrumentation::startPeriodicDump(std::chrono::seconds(5));
+//      ...
+//      Instrumentation::stopPeriodicDump();
+class Instrumentation
+{
+public:
+
+    enum Stage
+    {
+        READ,
+        PARSE,
+        PROCESS,
+        STORE,
+        EXPORT,
+        NUM_STAGES
+    };
+
+    struct StageStats
+    {
+        const char *name { "" };
+        std::uint64_t count { 0 };
+        double mean { 0 };      //  µs
+        double p50 { 0 };       //  µs, upper bound of the bucket
+        double p99 { 0 };       //  µs, upper bound of the bucket
+        double p999 { 0 };      //  µs, upper bound of the bucket
+        double max { 0 };       //  µs
+        double total { 0 };     //  s, spent in the stage by all the threads
+    };
+
+    using Stats = std::array<StageStats, NUM_STAGES>;
+
+
+    static constexpr bool isEnabled()
+    {
+#ifdef FBGS_ENABLE_INSTRUMENTATION
+        return true;
+#else
+        return false;
+#endif
+    }
+
+
+    //  Time stamp counter, in ticks
+    static std::uint64_t ticks()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+
+    //  Adds a duration to the histogram of the stage of the calling thread
+    static void record(const Stage t_stage,
+                       const std::uint64_t t_ticks);
+
+
+    //  Merged over all the threads, since the start of the process
+    static Stats getStats();
+
+    static void printStats(std::ostream &t_output);
+
+    //  Prints the stats every period on the standard output, from a thread of its own
+    static void startPeriodicDump(const std::chrono::milliseconds t_period);
+    //  To be called before the end of the program
+    static void stopPeriodicDump();
+
+
+    //  Times the scope it lives in
+    class ScopedTimer
+    {
+    public:
+
+        explicit ScopedTimer(const Stage t_stage) :
+            m_stage(t_stage),
+            m_start(ticks())
+        {}
+
+        ~ScopedTimer()
+        {
+            record(m_stage, ticks() - m_start);
+        }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer &operator=(const ScopedTimer&) = delete;
+
+    private:
+
+        Stage m_stage;
+        std::uint64_t m_start;
+    };
+
+
+    //  Log-linear buckets of ticks: 4 per power of two, the first 8 hold one value each
+    static constexpr unsigned int SUB_BUCKETS { 4 };
+    static constexpr unsigned int BUCKETS { 8 + SUB_BUCKETS*61 };
+
+    struct Histogram
+    {
+        std::array<std::atomic<std::uint64_t>, BUCKETS> buckets {};
+        std::atomic<std::uint64_t> sum { 0 };
+        std::atomic<std::uint64_t> max { 0 };
+    };
+
+    //  One per thread, written by it only, kept after the thread exits
+    struct ThreadHistograms
+    {
+        std::array<Histogram, NUM_STAGES> stages;
+        ThreadHistograms *next { nullptr };
+    };
+
+
+private:
+
+    static unsigned int bucket(const std::uint64_t t_ticks);
+    static std::uint64_t bucketUpperBound(const unsigned int t_bucket);
+
+    static ThreadHistograms &threadHistograms();
+
+    //  Nanoseconds per tick, measured against steady_clock since the start of the process
+    static double nanosecondsPerTick();
+
+
+    //  Lock free list of the histograms of all the threads, only prepended
+    static std::atomic<ThreadHistograms*> m_threads;
+
+    static std::mutex m_dump_mutex;
+    static std::condition_variable m_dump_condition;
+    static std::thread m_dump_thread;
+    static bool m_dump_running;
+};
+
+
+
+#ifdef FBGS_ENABLE_INSTRUMENTATION
+#define FBGS_INSTRUMENT_CONCAT_(a, b) a##b
+#define FBGS_INSTRUMENT_CONCAT(a, b) FBGS_INSTRUMENT_CONCAT_(a, b)
+#define FBGS_INSTRUMENT_STAGE(stage) \
+    const Instrumentation::ScopedTimer FBGS_INSTRUMENT_CONCAT(instrumentation_timer_, __LINE__)(Instrumentation::stage)
+#else
+#define FBGS_INSTRUMENT_STAGE(stage) static_cast<void>(0)
+#endif
@@ -0,0 +1,110 @@
+/*
+This code implements the statistics of the arrival times of the samples of a stream
+*/
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+
+
+// This class follows the inter-arrival times of the samples of a stream and the steps of their sample numbers.
+// The inter-arrival times are kept in µs in a log-linear histogram with a relative precision better than 1%
+// (exact below 256 µs) from 1 µs to days, the mean and the standard deviation are computed online
+// (Welford), so the memory does not grow with the duration. The steps of the sample numbers (1 when no sample
+// is lost) are counted by value.
+//
+// The analyzer takes the samples of either interface, e.g. from the sample callback:
+//      JitterAnalyzer analyzer;
+//      interface.setSampleCallback([&](const ShapeSensingInterface::Sample &t_sample){ analyzer.update(t_sample); });
+//      ...
+//      analyzer.writeReport("jitter.yaml");
+//
+// It is updated and read by the same thread, or read once the acquisition stopped.
+class JitterAnalyzer
+{
+public:
+
+    struct Statistics
+    {
+        std::uint64_t samples { 0 };
+        double duration { 0 };          //  s, from the first to the last sample
+
+        //  Inter-arrival times, µs
+        std::uint64_t intervals { 0 };
+        double mean { 0 };
+        double standard_deviation { 0 };
+        double min { 0 };
+        double max { 0 };
+        double p50 { 0 };
+        double p90 { 0 };
+        double p99 { 0 };
+        double p999 { 0 };
+
+        //  Steps of the sample numbers
+        std::uint64_t gaps { 0 };               //  steps larger than 1
+        std::uint64_t missed { 0 };             //  samples missing in the gaps
+        std::uint64_t repeated { 0 };           //  steps of 0 or backward
+        std::int64_t largest_step { 0 };
+    };
+
+
+    void update(const std::int64_t t_sample_number,
+                const std::chrono::high_resolution_clock::time_point t_time_stamp);
+
+    //  Sample of ShapeSensingInterface or IllumiSenseInterface, with the time the frame was read
+    template<typename Sample>
+    void update(const Sample &t_sample)
+    {
+        update(t_sample.sample_number, t_sample.time_stamp);
+    }
+
+    void reset();
+
+
+    Statistics getStatistics() const;
+
+    //  Inter-arrival time in µs below which a fraction of the intervals are
+    double percentile(const double t_fraction) const;
+
+    //  Number of steps of each value of the sample numbers
+    const std::map<std::int64_t, std::uint64_t> &getSampleNumberSteps() const { return m_steps; }
+
+
+    //  YAML report: the statistics, the non empty buckets of the histogram as [lower bound (µs), count]
+    //  and the steps of the sample numbers as [step, count], to be plotted offline
+    bool writeReport(const std::string &t_file_name) const;
+
+
+    //  Histogram buckets of µs: exact below 2 SUB_BUCKETS, then SUB_BUCKETS per power of two up to 2^42
+    static constexpr unsigned int SUB_BUCKET_BITS { 7 };
+    static constexpr std::uint64_t SUB_BUCKETS { 1 << SUB_BUCKET_BITS };
+    static constexpr unsigned int BUCKETS { 2*SUB_BUCKETS + SUB_BUCKETS*(42 - SUB_BUCKET_BITS - 1) };
+
+    static unsigned int bucket(const std::uint64_t t_value);
+    static std::uint64_t bucketLowerBound(const unsigned int t_bucket);
+    static std::uint64_t bucketUpperBound(const unsigned int t_bucket);
+
+
+private:
+
+    std::uint64_t m_samples { 0 };
+
+    std::chrono::high_resolution_clock::time_point m_first_time_stamp;
+    std::chrono::high_resolution_clock::time_point m_last_time_stamp;
+    std::int64_t m_last_sample_number { 0 };
+
+    //  Welford
+    std::uint64_t m_intervals { 0 };
+    double m_mean { 0 };
+    double m_m2 { 0 };
+    double m_min { 0 };
+    double m_max { 0 };
+
+    std::array<std::uint64_t, BUCKETS> m_histogram {};
+
+    std::map<std::int64_t, std::uint64_t> m_steps;
+};
@@ -0,0 +1,122 @@
+/*
+This code implements the accounting of the memory used by the storages of the samples
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+
+// Memory held by a storage of the samples (the recorded samples of the interfaces, a RawCaptureWriter, a
+// SharedMemoryPublisher), reported the same way by all of them: a fixed part, allocated up front, and a part
+// growing with every sample. The heap allocations are counted with what the allocator really reserves
+// (malloc_usable_size() and the chunk header), so that a sample made of many small Eigen vectors costs what
+// it costs. The resident memory of the whole process is given for comparison.
+struct MemoryFootprint
+{
+    std::uint64_t samples { 0 };            //  stored, or written through the storage
+    std::uint64_t fixed_bytes { 0 };        //  independent of the number of samples
+    std::uint64_t sample_bytes { 0 };       //  held by the samples stored
+    double bytes_per_sample { 0 };          //  mean, 0 when the samples are not kept in memory
+    std::uint64_t resident_bytes { 0 };     //  of the process
+
+    std::uint64_t totalBytes() const { return fixed_bytes + sample_bytes; }
+
+    //  Memory of the storage after a recording of the given duration (s) and frequency (Hz)
+    double projectedBytes(const double t_duration,
+                          const double t_frequency) const
+    {
+        return fixed_bytes + bytes_per_sample*t_duration*t_frequency;
+    }
+};
+
+
+
+// Limit of the memory of the recorded samples of an interface. A warning is printed once when the samples reach
+// the warning fraction of the limit, with the time left at the current rate. At the limit the samples are no
+// longer kept in memory: with a spill file, the recording continues into a raw capture (see enableRawCapture()),
+// otherwise it stops with an error message; the samples already recorded are kept in both cases. The spill file
+// is created with the budget, its blocks are counted in it.
+struct MemoryBudget
+{
+    std::uint64_t max_bytes { 0 };          //  of the recorded samples, 0 for no limit
+    double warning_fraction { 0.8 };
+    std::string spill_file;
+};
+
+
+
+// Accounts the samples recorded by an interface against its MemoryBudget. Updated by the thread that records
+// the samples, the footprint can be read from any thread.
+class SampleMemoryAccount
+{
+public:
+
+    void setBudget(const MemoryBudget &t_budget) { m_budget = t_budget; }
+    const MemoryBudget &getBudget() const { return m_budget; }
+
+    //  Memory allocated up front for the samples, counted in the budget before the first one (the blocks of the
+    //  spill file)
+    void setFixedBytes(const std::uint64_t t_bytes) { m_fixed_bytes = t_bytes; }
+
+
+    // Accounts a sample of t_bytes if it fits in the budget, false otherwise (the sample must then be dropped and
+    // the budget is exhausted). The time left in the warning is given at the rate the samples were added
+    bool add(const std::size_t t_bytes);
+
+    bool isExhausted() const { return m_exhausted; }
+
+
+    MemoryFootprint getFootprint() const;
+
+
+private:
+
+    MemoryBudget m_budget;
+
+    std::uint64_t m_fixed_bytes { 0 };
+
+    std::atomic<std::uint64_t> m_samples { 0 };
+    std::atomic<std::uint64_t> m_bytes { 0 };
+
+    std::chrono::steady_clock::time_point m_first_sample;
+
+    bool m_warned { false };
+    bool m_exhausted { false };
+};
+
+
+
+// Bytes reserved by the allocator for a block returned by malloc, new or std::allocator, 0 for nullptr
+std::size_t allocatedBytes(const void *t_pointer);
+
+template<typename T>
+std::size_t allocatedBytes(const std::vector<T> &t_vector)
+{
+    return t_vector.capacity() > 0 ? allocatedBytes(static_cast<const void*>(t_vector.data())) : 0;
+}
+
+template<typename Derived>
+std::size_t allocatedBytes(const Eigen::PlainObjectBase<Derived> &t_matrix)
+{
+    if(t_matrix.size() == 0 or Derived::SizeAtCompileTime != Eigen::Dynamic)
+        return 0;
+
+#if EIGEN_MALLOC_ALREADY_ALIGNED
+    return allocatedBytes(static_cast<const void*>(t_matrix.data()));
+#else
+    //  Eigen shifts the block returned by malloc to align it, the size is then estimated
+    return t_matrix.size()*sizeof(typename Derived::Scalar) + EIGEN_DEFAULT_ALIGN_BYTES + sizeof(std::size_t);
+#endif
+}
+
+
+// Resident memory of the process (/proc/self/statm), in bytes
+std::uint64_t residentBytes();
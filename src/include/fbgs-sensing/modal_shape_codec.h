@@ -0,0 +1,65 @@
+/*
+This code implements the compression of the shapes on a reduced polynomial basis
+*/
+
+#pragma once
+
+#include <Eigen/Dense>
+
+
+// This class encodes a shape (num_points x 3) as the coefficients of a few modes and decodes it back.
+// The modes are the Legendre polynomials over the arc length, orthonormalised on the discrete grid of
+// the shape points. Thanks to the orthonormality the coefficients of the first k modes are the same
+// whatever k is: encoding computes all of them once and keeps the smallest number of modes for which
+// every point of the reconstructed shape is within the error bound.
+//
+// Encoder and decoder only need to agree on the number of points and on the maximum number of modes.
+class ModalShapeCodec
+{
+public:
+
+    struct ModalShape
+    {
+        int num_shape_points { 0 };
+        int num_modes { 0 };
+        Eigen::MatrixXd coefficients;   //num_modes x 3 matrix
+        double max_error { 0 };         //largest point distance between the shape and its reconstruction
+    };
+
+
+    // Error bound in meters on the position of every point
+    ModalShapeCodec(const double t_max_error=1e-4,
+                    const int t_max_modes=16);
+
+
+    void setMaxError(const double t_max_error) { m_max_error = t_max_error; }
+
+    double getMaxError() const { return m_max_error; }
+    int getMaxModes() const { return m_max_modes; }
+
+
+    // Builds the basis, called automatically when the number of points changes
+    void setNumberOfPoints(const int t_num_points);
+
+    const Eigen::MatrixXd &getBasis() const { return m_basis; }
+
+
+    // Returns false if the error bound could not be met with the maximum number of modes,
+    // the modal shape contains all of them in that case
+    bool encode(const Eigen::MatrixXd &t_shape, ModalShape &t_modal_shape);
+
+    // NOTE: the basis is built if needed, so decoding shapes of a new size is not thread safe
+    void decode(const ModalShape &t_modal_shape, Eigen::MatrixXd &t_shape);
+
+
+private:
+
+    double m_max_error { 1e-4 };
+    int m_max_modes { 16 };
+
+    int m_num_points { 0 };
+    Eigen::MatrixXd m_basis;        //num_points x modes matrix with orthonormal columns
+
+    Eigen::MatrixXd m_coefficients; //modes x 3 matrix
+    Eigen::MatrixXd m_residual;     //num_points x 3 matrix
+};
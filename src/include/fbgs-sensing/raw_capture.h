@@ -0,0 +1,223 @@
+/*
+This code implements the file format of the raw captures of the streams of the interrogators
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <algorithm>
+#include <chrono>
+
+#include "fbgs-sensing/memory_footprint.h"
+
+
+// A raw capture keeps the frames exactly as received, so that a session can be parsed again or replayed later.
+// The file starts with the 8 bytes "FBGSRAW1", followed by one record per frame, all integers little endian:
+//
+//      [uint64 receive time, ns][uint32 size][size bytes of the frame, without its 4 bytes length]
+//
+// The receive time is the time stamp of the sample (std::chrono::high_resolution_clock since its epoch).
+constexpr char RAW_CAPTURE_MAGIC[8] { 'F', 'B', 'G', 'S', 'R', 'A', 'W', '1' };
+
+constexpr std::size_t RAW_CAPTURE_RECORD_HEADER_SIZE { 12 };
+
+
+
+// Buffering of a RawCaptureWriter
+struct RawCaptureConfig
+{
+    std::size_t block_size { 8 << 20 };     //  bytes
+    unsigned int num_blocks { 4 };          //  at least 2
+};
+
+
+
+// Appends the frames to a raw capture with one copy per frame, for the cheapest possible acquisition.
+// The records are gathered in large preallocated blocks, a full block is handed to a writer thread which
+// writes it to the file. The acquisition thread never waits for the disk: if the writer falls behind and no
+// block is free, the frame is dropped and counted.
+class RawCaptureWriter
+{
+public:
+
+    struct Statistics
+    {
+        std::uint64_t frames_written { 0 };     //  appended, written once their block is flushed
+        std::uint64_t bytes_written { 0 };
+        std::uint64_t frames_dropped { 0 };     //  no free block, or larger than a block
+        std::uint64_t blocks_written { 0 };
+    };
+
+
+    explicit RawCaptureWriter(const std::string &t_file_name,
+                              const RawCaptureConfig &t_config=RawCaptureConfig());
+
+    // Writes the records left and closes the file
+    ~RawCaptureWriter();
+
+
+    bool isOpen() const { return m_fd >= 0; }
+
+
+    // From a single thread, the frame without its 4 bytes length. False if the frame is dropped
+    bool append(const std::int64_t t_time_ns,
+                const char *t_data,
+                const std::size_t t_size);
+
+    // From the thread calling append(), hands the current block to the writer thread
+    void flush();
+
+    // Once append() is no longer called: flushes, waits until everything is written and closes the file
+    void close();
+
+
+    Statistics getStatistics() const;
+
+    // The blocks, allocated up front: the memory does not grow with the frames written
+    MemoryFootprint getMemoryFootprint() const;
+
+
+private:
+
+    struct Block
+    {
+        std::vector<char> data;
+        std::size_t size { 0 };
+    };
+
+    void writingLoop();
+
+    bool nextBlock();
+
+
+    int m_fd { -1 };
+
+    std::vector<Block> m_blocks;
+    std::size_t m_blocks_bytes { 0 };
+
+    //  Filled by append()
+    Block *m_current { nullptr };
+
+    //  Handed between the two threads
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<Block*> m_full_blocks;
+    std::deque<Block*> m_free_blocks;
+    bool m_closing { false };
+
+    std::thread m_thread;
+
+    std::atomic<std::uint64_t> m_frames_written { 0 };
+    std::atomic<std::uint64_t> m_bytes_written { 0 };
+    std::atomic<std::uint64_t> m_frames_dropped { 0 };
+    std::atomic<std::uint64_t> m_blocks_written { 0 };
+};
+
+
+
+// Reads the records of a raw capture one after the other
+class RawCaptureReader
+{
+public:
+
+    struct Record
+    {
+        std::int64_t time_ns;
+        std::size_t offset;                     //  of the frame in the data
+        std::size_t size;
+    };
+
+
+    explicit RawCaptureReader(const std::string &t_file_name);
+
+
+    // False if the file cannot be opened or is not a raw capture
+    bool isOpen() const { return m_open; }
+
+
+    // Next record, false at the end of the file or if the last record is truncated
+    bool read(std::int64_t &t_time_ns,
+              std::vector<char> &t_frame);
+
+    // All the records left at once, the frames stay in place in t_data (a truncated last record is ignored)
+    std::size_t readAll(std::vector<char> &t_data,
+                        std::vector<Record> &t_records);
+
+    // Back to the first record
+    void rewind();
+
+
+    std::uint64_t getNumberOfRecordsRead() const { return m_records_read; }
+
+
+private:
+
+    std::ifstream m_file;
+    bool m_open { false };
+
+    std::uint64_t m_records_read { 0 };
+};
+
+
+
+// Parses the frames of a raw capture into samples on several threads (all the hardware threads with 0),
+// with the parseFrame() of an interface (ShapeSensingInterface or IllumiSenseInterface). The samples are in
+// the order of the capture and time stamped with the receive times, the frames that cannot be parsed are
+// skipped. Returns the number of records read, to compare with the number of samples.
+template<typename Interface>
+std::size_t parseRawCapture(const std::string &t_file_name,
+                            const Interface &t_interface,
+                            std::vector<typename Interface::Sample> &t_samples,
+                            unsigned int t_num_threads=0)
+{
+    RawCaptureReader reader(t_file_name);
+
+    std::vector<char> data;
+    std::vector<RawCaptureReader::Record> records;
+    reader.readAll(data, records);
+
+    t_samples.resize(records.size());
+    std::vector<char> parsed(records.size(), 0);
+
+    if(t_num_threads == 0)
+        t_num_threads = std::max(1u, std::thread::hardware_concurrency());
+    t_num_threads = static_cast<unsigned int>(std::clamp<std::size_t>(records.size(), 1, t_num_threads));
+
+    //  Contiguous ranges of records, one per thread
+    std::vector<std::thread> threads;
+    for(unsigned int k=0; k<t_num_threads; k++)
+        threads.emplace_back([&, k](){
+            const std::size_t begin = records.size()*k/t_num_threads;
+            const std::size_t end = records.size()*(k + 1)/t_num_threads;
+
+            for(std::size_t i=begin; i<end; i++){
+                const RawCaptureReader::Record &record = records[i];
+                parsed[i] = t_interface.parseFrame(data.data() + record.offset, record.size, t_samples[i]);
+                t_samples[i].time_stamp = std::chrono::high_resolution_clock::time_point(
+                    std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(std::chrono::nanoseconds(record.time_ns)));
+            }
+        });
+
+    for(std::thread &thread : threads)
+        thread.join();
+
+
+    std::size_t n = 0;
+    for(std::size_t i=0; i<records.size(); i++)
+        if(parsed[i]){
+            if(n != i)
+                t_samples[n] = std::move(t_samples[i]);
+            n++;
+        }
+    t_samples.resize(n);
+
+    return records.size();
+}
@@ -0,0 +1,46 @@
+/*
+This code implements the real time configuration of the acquisition threads
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include <real_time_tools/thread.hpp>
+
+
+// Scheduling and memory settings of an acquisition thread. When enabled the thread is created with
+// real_time_tools::RealTimeThread (SCHED_FIFO with the given priority, pinned to the given CPUs and
+// with the memory locked), and pre-faults its stack and heap before reading the stream, so that
+// neither page faults nor preemption add jitter to the acquisition.
+struct RealTimeConfig
+{
+    bool enabled { false };
+
+    int priority { 80 };
+
+    //  CPUs the thread can run on, all of them if empty. Ideally an isolated core (isolcpus)
+    std::vector<int> cpu_ids;
+
+    //  mlockall(MCL_CURRENT | MCL_FUTURE)
+    bool lock_memory { true };
+
+    //  Heap reserved and touched upfront, it should cover the samples stored during the recording.
+    //  NOTE: it disables the trimming of the heap for the whole process
+    std::size_t prefault_heap_bytes { 0 };
+
+    std::size_t prefault_stack_bytes { 256*1024 };
+};
+
+
+
+// Copies the configuration into the parameters of a RealTimeThread before its creation
+void configureRealTimeThread(const RealTimeConfig &t_config,
+                             const std::string &t_keyword,
+                             real_time_tools::RealTimeThreadParameters &t_parameters);
+
+
+// To be called from the acquisition thread itself before entering its loop
+void prefaultMemory(const RealTimeConfig &t_config);
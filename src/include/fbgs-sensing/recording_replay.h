@@ -0,0 +1,152 @@
+/*
+This code implements the replay of recorded sessions as streams of the interrogators
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <cstdint>
+
+#include <Eigen/Dense>
+
+#include "fbgs-sensing/frame_server.h"
+#include "fbgs-sensing/raw_capture.h"
+
+
+namespace YAML
+{
+class Node;
+}
+
+
+// These classes turn a recording back into the stream of the interrogator, to be served by a FrameServer.
+// The frames are sent at their recorded receive times, so the field jitter and bursts are reproduced against
+// the real client code; FrameServer::setSpeed() replays N times faster, or as fast as possible with 0.
+// A new client gets the recording from the start. With loop, the recording is repeated endlessly, shifted
+// in time by its duration (the sample numbers repeat).
+//
+// Example, replaying a session 10 times faster:
+//      auto replay = std::make_shared<RecordedSamplesReplay>("simulation_results_5s.yaml", "FBGS_data.csv");
+//      FrameServer server(replay, "127.0.0.1", replay->getDefaultPort());
+//      server.setSpeed(10);
+//      server.start();
+
+
+
+// Replays a raw capture, the frames are sent exactly as they were received
+class RawCaptureReplay : public FrameSource
+{
+public:
+
+    explicit RawCaptureReplay(const std::string &t_file_name,
+                              const bool t_loop=false);
+
+    bool isOpen() const { return m_reader.isOpen(); }
+
+
+    bool nextFrame(std::vector<char> &t_frame,
+                   double &t_time) override;
+
+    void reset() override;
+
+
+private:
+
+    RawCaptureReader m_reader;
+    bool m_loop;
+
+    std::vector<char> m_payload;
+
+    //  Receive times of the first and last records, and shift of the current repetition
+    std::int64_t m_first_time_ns { -1 };
+    std::int64_t m_last_time_ns { 0 };
+    std::int64_t m_offset_ns { 0 };
+};
+
+
+
+// Replays the files written from getSamplesData() (the YAML description and the CSV matrix, one column per sample)
+// of either interface, the device is recognised from the YAML. The frames are regenerated from the recorded values:
+// the IllumiSense frames are complete, while the Shape Sensing recordings have no wavelengths (the channels are sent
+// with zero wavelengths and powers) and do not tell the number of curvature points, which must then be given
+// (without it the curvature is not replayed). The rows of the Shape Sensing sensors follow data_order.sensors_data
+// (arc length, curvature, curvature angle and x, y, z positions, the shape being required); a recording with
+// another layout is rejected.
+class RecordedSamplesReplay : public FrameSource
+{
+public:
+
+    enum class Device
+    {
+        UNKNOWN,
+        SHAPE_SENSING,
+        ILLUMISENSE
+    };
+
+
+    RecordedSamplesReplay(const std::string &t_yaml_file_name,
+                          const std::string &t_csv_file_name,
+                          const bool t_loop=false,
+                          const int t_num_curvature_points=0);
+
+
+    bool isOpen() const { return m_device != Device::UNKNOWN and m_data.cols() > 0; }
+
+    Device getDevice() const { return m_device; }
+
+    // Port of the interrogator for the device (5001 or 2055)
+    unsigned short getDefaultPort() const { return m_device == Device::ILLUMISENSE ? 2055 : 5001; }
+
+    std::size_t getNumberOfSamples() const { return m_data.cols(); }
+
+
+    bool nextFrame(std::vector<char> &t_frame,
+                   double &t_time) override;
+
+    void reset() override;
+
+
+private:
+
+    //  Quantities of the rows of a Shape Sensing sensor, num_shape_points rows each
+    enum SensorData
+    {
+        ARC_LENGTH,
+        CURVATURE,
+        CURVATURE_ANGLE,
+        X_POSITIONS,
+        Y_POSITIONS,
+        Z_POSITIONS,
+        SENSOR_DATA_COUNT
+    };
+
+    bool readSensorsDataOrder(const YAML::Node &t_sensors_data);
+
+    //  True if the rows of the recording match the layout of the sensors
+    bool checkShapeSensingRows();
+
+    //  True if the rows of the recording match the gratings of the channels of every sample
+    bool checkIllumiSenseRows() const;
+
+    bool readCsv(const std::string &t_file_name);
+
+    void writeShapeSensingFrame(const Eigen::Index t_column, std::vector<char> &t_frame) const;
+    void writeIllumiSenseFrame(const Eigen::Index t_column, std::vector<char> &t_frame) const;
+
+
+    Device m_device { Device::UNKNOWN };
+
+    bool m_loop;
+    int m_num_curvature_points;
+
+    //  Order of the quantities of every sensor in the rows, as described by data_order.sensors_data
+    std::vector<SensorData> m_sensors_data;
+
+    //  One column per sample, as written by getSamplesData()
+    Eigen::MatrixXd m_data;
+
+    Eigen::Index m_next_column { 0 };
+    double m_offset { 0 };
+};
@@ -0,0 +1,336 @@
+/*
+This code implements the distribution of the samples to processing stages running in their own threads
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+
+// This class forwards every sample of an interface to a set of processing stages (filters, reconstruction,
+// loggers, publishers...). Every stage receives every sample through its own bounded queue and runs its
+// callback in its own thread, so a slow stage only delays itself: when its queue is full the sample is
+// handled by the overflow policy of the stage, the acquisition thread never waits (except with BLOCK).
+//
+// The queues are single producer rings of preallocated samples. A sample is copied into a slot by the
+// acquisition thread and swapped out by the stage, so once the slots have the topology of the stream the
+// pipeline allocates nothing. Idle stages sleep on a futex (C++20 atomic wait), without polling.
+//
+// Example:
+//      SamplePipeline<ShapeSensingInterface::Sample> pipeline;
+//      pipeline.addStage("logger", [&](const auto &sample){ logger.write(sample); }, 1024, OverflowPolicy::BLOCK);
+//      pipeline.addStage("controller", [&](const auto &sample){ controller.update(sample); }, 4);
+//      pipeline.start();
+//      interface.setSampleCallback([&](const auto &sample){ pipeline.push(sample); });
+enum class OverflowPolicy
+{
+    DROP_OLDEST,        //  the oldest sample of the queue is discarded, the stage always gets the latest ones
+    BLOCK,              //  the acquisition waits for the stage, no sample is lost
+    COUNT_AND_SKIP      //  the new sample is discarded and counted
+};
+
+
+
+template<typename Sample>
+class SamplePipeline
+{
+public:
+
+    struct StageStatistics
+    {
+        std::string name;
+        std::size_t capacity { 0 };
+        std::uint64_t received { 0 };
+        std::uint64_t processed { 0 };
+        std::uint64_t dropped { 0 };        //  discarded by DROP_OLDEST
+        std::uint64_t skipped { 0 };        //  discarded by COUNT_AND_SKIP
+        std::uint64_t blocked { 0 };        //  waits of the acquisition with BLOCK
+        std::size_t max_queue_size { 0 };
+    };
+
+
+    SamplePipeline() = default;
+
+    ~SamplePipeline() { stop(); }
+
+    SamplePipeline(const SamplePipeline&) = delete;
+    SamplePipeline &operator=(const SamplePipeline&) = delete;
+
+
+    // Stages are added before start(), the capacity is rounded up to a power of two
+    void addStage(const std::string &t_name,
+                  std::function<void(const Sample&)> t_callback,
+                  const std::size_t t_capacity=64,
+                  const OverflowPolicy t_policy=OverflowPolicy::DROP_OLDEST)
+    {
+        if(m_running)
+            return;
+
+        m_stages.push_back(std::make_unique<Stage>(t_name, std::move(t_callback), t_capacity, t_policy));
+    }
+
+
+    void start()
+    {
+        if(m_running)
+            return;
+
+        for(auto &stage : m_stages)
+            stage->start();
+
+        m_running = true;
+    }
+
+
+    // The samples already queued are processed before the threads finish, to be called once nothing is pushed anymore
+    void stop()
+    {
+        if(not m_running)
+            return;
+
+        for(auto &stage : m_stages)
+            stage->stop();
+
+        m_running = false;
+    }
+
+
+    // To be called by a single thread, usually from the sample callback of the interface
+    void push(const Sample &t_sample)
+    {
+        for(auto &stage : m_stages)
+            stage->push(t_sample);
+    }
+
+
+    std::size_t getNumberOfStages() const { return m_stages.size(); }
+
+    std::vector<StageStatistics> getStatistics() const
+    {
+        std::vector<StageStatistics> statistics;
+        for(const auto &stage : m_stages)
+            statistics.push_back(stage->getStatistics());
+
+        return statistics;
+    }
+
+
+private:
+
+    class Stage
+    {
+    public:
+
+        Stage(const std::string &t_name,
+              std::function<void(const Sample&)> t_callback,
+              const std::size_t t_capacity,
+              const OverflowPolicy t_policy) :
+            m_name(t_name),
+            m_callback(std::move(t_callback)),
+            m_policy(t_policy),
+            m_slots(roundCapacity(t_capacity)),
+            m_mask(m_slots.size() - 1)
+        {
+            for(std::size_t i=0; i<m_slots.size(); i++)
+                m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+
+        void start()
+        {
+            m_stopping.store(false, std::memory_order_relaxed);
+            m_thread = std::thread([this](){ run(); });
+        }
+
+
+        void stop()
+        {
+            m_stopping.store(true, std::memory_order_release);
+            signal(m_data_signal);
+            signal(m_space_signal);
+
+            if(m_thread.joinable())
+                m_thread.join();
+        }
+
+
+        void push(const Sample &t_sample)
+        {
+            m_received.fetch_add(1, std::memory_order_relaxed);
+
+            while(not tryPush(t_sample)){
+                if(m_policy == OverflowPolicy::COUNT_AND_SKIP){
+                    m_skipped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+
+                if(m_policy == OverflowPolicy::DROP_OLDEST){
+                    if(pop(nullptr))
+                        m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+
+                //  BLOCK, the signal is read before trying again so that no wake up is missed
+                const std::uint32_t space = m_space_signal.load(std::memory_order_acquire);
+                if(tryPush(t_sample))
+                    break;
+                if(m_stopping.load(std::memory_order_acquire))
+                    return;
+
+                m_blocked.fetch_add(1, std::memory_order_relaxed);
+                m_space_signal.wait(space, std::memory_order_acquire);
+            }
+
+            signal(m_data_signal);
+        }
+
+
+        StageStatistics getStatistics() const
+        {
+            StageStatistics statistics;
+            statistics.name = m_name;
+            statistics.capacity = m_slots.size();
+            statistics.received = m_received.load(std::memory_order_relaxed);
+            statistics.processed = m_processed.load(std::memory_order_relaxed);
+            statistics.dropped = m_dropped.load(std::memory_order_relaxed);
+            statistics.skipped = m_skipped.load(std::memory_order_relaxed);
+            statistics.blocked = m_blocked.load(std::memory_order_relaxed);
+            statistics.max_queue_size = m_max_queue_size.load(std::memory_order_relaxed);
+
+            return statistics;
+        }
+
+
+    private:
+
+        struct alignas(64) Slot
+        {
+            std::atomic<std::size_t> sequence { 0 };
+            Sample sample;
+        };
+
+
+        static std::size_t roundCapacity(const std::size_t t_capacity)
+        {
+            std::size_t capacity = 2;
+            while(capacity < t_capacity)
+                capacity *= 2;
+
+            return capacity;
+        }
+
+
+        void run()
+        {
+            Sample sample;
+
+            while(true){
+                const std::uint32_t data = m_data_signal.load(std::memory_order_acquire);
+
+                if(pop(&sample)){
+                    signal(m_space_signal);
+
+                    m_callback(sample);
+                    m_processed.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+
+                //  The queue is empty, it was drained before stopping
+                if(m_stopping.load(std::memory_order_acquire))
+                    break;
+
+                m_data_signal.wait(data, std::memory_order_acquire);
+            }
+        }
+
+
+        //  Only called by the producer
+        bool tryPush(const Sample &t_sample)
+        {
+            const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+            Slot &slot = m_slots[tail & m_mask];
+
+            if(slot.sequence.load(std::memory_order_acquire) != tail)
+                return false;
+
+            slot.sample = t_sample;
+            slot.sequence.store(tail + 1, std::memory_order_release);
+            m_tail.store(tail + 1, std::memory_order_relaxed);
+
+            const std::size_t size = tail + 1 - m_head.load(std::memory_order_relaxed);
+            if(size > m_max_queue_size.load(std::memory_order_relaxed))
+                m_max_queue_size.store(size, std::memory_order_relaxed);
+
+            return true;
+        }
+
+
+        //  Called by the stage, and by the producer to drop the oldest sample (t_sample is then null)
+        bool pop(Sample *t_sample)
+        {
+            std::size_t head = m_head.load(std::memory_order_relaxed);
+
+            while(true){
+                Slot &slot = m_slots[head & m_mask];
+                const std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+
+                if(sequence != head + 1)
+                    return false;
+
+                if(m_head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)){
+                    //  Swapped instead of copied, the slot gets back buffers of the right size
+                    if(t_sample != nullptr)
+                        std::swap(*t_sample, slot.sample);
+
+                    slot.sequence.store(head + m_slots.size(), std::memory_order_release);
+                    return true;
+                }
+            }
+        }
+
+
+        static void signal(std::atomic<std::uint32_t> &t_signal)
+        {
+            t_signal.fetch_add(1, std::memory_order_release);
+            t_signal.notify_one();
+        }
+
+
+        std::string m_name;
+        std::function<void(const Sample&)> m_callback;
+        OverflowPolicy m_policy;
+
+        std::vector<Slot> m_slots;
+        std::size_t m_mask { 0 };
+
+        alignas(64) std::atomic<std::size_t> m_head { 0 };
+        alignas(64) std::atomic<std::size_t> m_tail { 0 };
+
+        //  Incremented at every push and pop, the threads sleep on them
+        alignas(64) std::atomic<std::uint32_t> m_data_signal { 0 };
+        alignas(64) std::atomic<std::uint32_t> m_space_signal { 0 };
+
+        std::atomic<bool> m_stopping { false };
+
+        std::atomic<std::uint64_t> m_received { 0 };
+        std::atomic<std::uint64_t> m_processed { 0 };
+        std::atomic<std::uint64_t> m_dropped { 0 };
+        std::atomic<std::uint64_t> m_skipped { 0 };
+        std::atomic<std::uint64_t> m_blocked { 0 };
+        std::atomic<std::size_t> m_max_queue_size { 0 };
+
+        std::thread m_thread;
+    };
+
+
+    std::vector<std::unique_ptr<Stage>> m_stages;
+    bool m_running { false };
+};
@@ -0,0 +1,73 @@
+/*
+This code implements the online detection of the samples lost by the acquisition
+*/
+
+#pragma once
+
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+
+
+// This class follows the sample numbers of a stream as the samples arrive. The interrogator numbers
+// its samples consecutively, so a jump of the sample number means that samples were missed (overwritten
+// in the interrogator or lost by a reconnection). The last REORDER_WINDOW sample numbers received are
+// remembered, so that a smaller sample number is either a duplicate or a sample arriving late, which is
+// then no longer counted as dropped. Any other step backward is an interrogator restart.
+//
+// The monitor is updated by the acquisition thread only; the counters are atomics so that they can be
+// read from any thread during the acquisition.
+class SampleSequenceMonitor
+{
+public:
+
+    struct Statistics
+    {
+        std::uint64_t received { 0 };
+        std::uint64_t dropped { 0 };     //  samples missing from the stream
+        std::uint64_t gaps { 0 };        //  number of jumps of the sample number
+        std::uint64_t duplicates { 0 };
+        std::uint64_t reordered { 0 };
+        std::uint64_t restarts { 0 };
+        std::uint64_t largest_gap { 0 };
+        std::int64_t last_sample_number { -1 };
+    };
+
+
+    static constexpr std::int64_t REORDER_WINDOW { 1024 };
+
+
+    // Not to be called during the acquisition
+    void reset();
+
+    // Returns the number of samples missed between the previous sample and this one
+    unsigned int update(const std::int64_t t_sample_number);
+
+    Statistics getStatistics() const;
+
+
+private:
+
+    static std::size_t index(const std::int64_t t_sample_number)
+    {
+        return static_cast<std::size_t>(((t_sample_number % REORDER_WINDOW) + REORDER_WINDOW) % REORDER_WINDOW);
+    }
+
+    void restart(const std::int64_t t_sample_number);
+
+
+    bool m_started { false };
+    std::int64_t m_first_sample_number { 0 };
+
+    //  Indexed by sample_number % REORDER_WINDOW
+    std::bitset<REORDER_WINDOW> m_received_window;
+
+    std::atomic<std::uint64_t> m_received { 0 };
+    std::atomic<std::uint64_t> m_dropped { 0 };
+    std::atomic<std::uint64_t> m_gaps { 0 };
+    std::atomic<std::uint64_t> m_duplicates { 0 };
+    std::atomic<std::uint64_t> m_reordered { 0 };
+    std::atomic<std::uint64_t> m_restarts { 0 };
+    std::atomic<std::uint64_t> m_largest_gap { 0 };
+    std::atomic<std::int64_t> m_last_sample_number { -1 };
+};
@@ -0,0 +1,90 @@
+/*
+This code implements a coroutine stream over the samples of an interface
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <utility>
+
+#include <boost/asio.hpp>
+#include <boost/asio/awaitable.hpp>
+
+
+// This class turns an interface (ShapeSensingInterface or IllumiSenseInterface) into a stream of samples
+// consumed from a coroutine running on the io_context of the interface. The sample is owned by the stream
+// and reused, and the parsers reuse its channels and sensors, so reading the stream allocates nothing
+// once the topology is known.
+// Boost.Asio 1.74 has no asynchronous generator, the stream is pulled with next() instead.
+//
+// Here as in the interfaces, a co_await is never the whole condition of an if or a while: its result is
+// declared in the condition or named before. GCC 12.2 builds coroutines that crash at run time, at -O0 as
+// at -O2, when a coroutine without local variables tests a co_await directly. With Boost.Asio 1.74:
+//      awaitable<bool> yes() { co_return true; }
+//      awaitable<int> f() { if(co_await yes()) co_return 1; co_return 0; }                 // crashes
+//      awaitable<int> f() { const bool b = co_await yes(); if(b) co_return 1; co_return 0; } // works
+//
+// Example, processing two devices on one thread without callbacks:
+//      boost::asio::co_spawn(*manager.getIoContext(), [&]() -> boost::asio::awaitable<void> {
+//          SampleStream stream(*shape_sensing);
+//          while(const auto *sample = co_await stream.next())
+//              controller.update(*sample);
+//      }, boost::asio::detached);
+//      boost::asio::co_spawn(*manager.getIoContext(), [&]() -> boost::asio::awaitable<void> {
+//          SampleStream stream(*illumisense);
+//          co_await stream.forEach([&](const auto &sample){ logger.write(sample); });
+//      }, boost::asio::detached);
+template<typename Interface>
+class SampleStream
+{
+public:
+
+    typedef typename Interface::Sample Sample;
+
+
+    explicit SampleStream(Interface &t_interface) :
+        m_interface(t_interface)
+    {
+    }
+
+
+    // The next sample, valid until the following call. nullptr once the stream ended
+    boost::asio::awaitable<const Sample*> next()
+    {
+        if(m_ended)
+            co_return nullptr;
+
+        const bool received = co_await m_interface.next(m_sample);
+        if(received){
+            m_number_of_samples++;
+            co_return &m_sample;
+        }
+
+        m_ended = true;
+        co_return nullptr;
+    }
+
+
+    // Calls t_handler with every sample until the end of the stream
+    template<typename Handler>
+    boost::asio::awaitable<void> forEach(Handler t_handler)
+    {
+        while(const Sample *sample = co_await next())
+            t_handler(*sample);
+    }
+
+
+    bool hasEnded() const { return m_ended; }
+
+    std::size_t getNumberOfSamples() const { return m_number_of_samples; }
+
+
+private:
+
+    Interface &m_interface;
+
+    Sample m_sample;
+
+    bool m_ended { false };
+    std::size_t m_number_of_samples { 0 };
+};
@@ -0,0 +1,164 @@
+/*
+This code implements the interpolation of the shapes at arbitrary time instants
+*/
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <Eigen/Dense>
+#include <Eigen/Geometry>
+
+
+// This class keeps a short history of shapes and serves time-indexed queries, for instance to run a
+// 1 kHz controller on a 100 Hz sensor. The acquisition thread pushes the samples in a ring of slots,
+// each protected by a sequence number. A query never waits nor retries: it copies the slots it needs
+// and checks that none of them has been overwritten meanwhile, which could only happen if the query
+// lasted more than t_guard sample periods. In that case it returns false.
+//
+// The output has the same layout as Sensor::shape. As interpolation needs a sample after the requested
+// time, queries should lag the newest sample by at least one period (see ShapePredictor for the present).
+class ShapeInterpolator
+{
+public:
+
+    typedef std::chrono::high_resolution_clock::time_point TimePoint;
+
+    enum class Interpolation
+    {
+        LINEAR,
+        CUBIC
+    };
+
+
+    ShapeInterpolator(const unsigned int t_history=8,
+                      const unsigned int t_guard=8);
+
+
+    // The tip orientation is the minimal rotation bringing this direction to the tip tangent
+    void setReferenceDirection(const Eigen::Vector3d &t_direction) { m_reference_direction = t_direction.normalized(); }
+
+
+    // Writer side, only one thread can push. The topology is fixed at the first sample, the samples with
+    // another topology are rejected (reported once, then counted)
+    template<typename Sensor>
+    void push(const TimePoint &t_time_stamp,
+              const std::vector<Sensor> &t_sensors);
+
+
+    // Reader side, any number of threads. Returns false if t_time is out of the history
+    // (the closest sample is then returned) or if the slots were overwritten during the query
+    bool shapeAt(const unsigned int t_sensor,
+                 const TimePoint &t_time,
+                 Eigen::MatrixXd &t_shape,
+                 const Interpolation t_interpolation=Interpolation::LINEAR) const;
+
+    bool tipOrientationAt(const unsigned int t_sensor,
+                          const TimePoint &t_time,
+                          Eigen::Quaterniond &t_orientation) const;
+
+
+    // Time stamps of the oldest and newest samples available
+    bool getTimeRange(TimePoint &t_oldest, TimePoint &t_newest) const;
+
+    std::uint64_t getNumberOfRejectedSamples() const { return m_rejected.load(std::memory_order_relaxed); }
+
+
+private:
+
+    struct Slot
+    {
+        std::atomic<std::uint64_t> sequence { 0 };
+        TimePoint time_stamp;
+        std::vector<Eigen::MatrixXd> shapes;
+        std::vector<Eigen::Quaterniond> tip_orientations;
+    };
+
+
+    //  Indices (in number of pushes) of the samples around t_time and interpolation parameter
+    struct Bracket
+    {
+        std::uint64_t before;
+        std::uint64_t after;
+        double u;
+        bool inside;
+    };
+
+
+    void allocate(const std::vector<Eigen::Index> &t_num_points);
+
+    Eigen::Quaterniond tipOrientation(const Eigen::MatrixXd &t_shape) const;
+
+    bool findBracket(const TimePoint &t_time, Bracket &t_bracket) const;
+
+    const Slot &slot(const std::uint64_t t_index) const { return m_slots[t_index % m_capacity]; }
+    Slot &slot(const std::uint64_t t_index) { return m_slots[t_index % m_capacity]; }
+
+    //  Sequence of a slot holding the sample t_index once it is completely written
+    static std::uint64_t publishedSequence(const std::uint64_t t_index) { return 2*(t_index + 1); }
+
+    bool isValid(const std::uint64_t t_index) const;
+
+
+    unsigned int m_history { 8 };
+    unsigned int m_capacity { 16 };
+
+    std::unique_ptr<Slot[]> m_slots;
+
+    //  Number of samples pushed so far, the newest is at m_count-1
+    std::atomic<std::uint64_t> m_count { 0 };
+
+    std::vector<Eigen::Index> m_num_points;
+
+    //  Samples of another topology, only written by the pushing thread
+    std::atomic<std::uint64_t> m_rejected { 0 };
+
+    Eigen::Vector3d m_reference_direction { Eigen::Vector3d::UnitZ() };
+};
+
+
+
+
+template<typename Sensor>
+void ShapeInterpolator::push(const TimePoint &t_time_stamp,
+                             const std::vector<Sensor> &t_sensors)
+{
+    std::vector<Eigen::Index> num_points;
+    if(m_num_points.empty()){
+        for(const auto &sensor : t_sensors)
+            num_points.push_back(sensor.shape.rows());
+        allocate(num_points);
+    }
+
+    bool topology_changed = t_sensors.size() != m_num_points.size();
+    for(unsigned int i=0; not topology_changed and i<t_sensors.size(); i++)
+        topology_changed = t_sensors[i].shape.rows() != m_num_points[i];
+
+    if(topology_changed){
+        const std::uint64_t rejected = m_rejected.load(std::memory_order_relaxed);
+        if(rejected == 0)
+            std::cerr << "[ShapeInterpolator] the topology of the sensors changed, the samples are ignored" << std::endl;
+        m_rejected.store(rejected + 1, std::memory_order_relaxed);
+        return;
+    }
+
+
+    const std::uint64_t index = m_count.load(std::memory_order_relaxed);
+    Slot &current = slot(index);
+
+    //  Odd sequence while writing
+    current.sequence.store(publishedSequence(index) - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    current.time_stamp = t_time_stamp;
+    for(unsigned int i=0; i<t_sensors.size(); i++){
+        current.shapes[i] = t_sensors[i].shape;
+        current.tip_orientations[i] = tipOrientation(current.shapes[i]);
+    }
+
+    current.sequence.store(publishedSequence(index), std::memory_order_release);
+    m_count.store(index + 1, std::memory_order_release);
+}
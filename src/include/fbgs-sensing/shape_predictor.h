@@ -0,0 +1,140 @@
+/*
+This code implements a predictor compensating the latency of the shape measurements
+*/
+
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <Eigen/Dense>
+
+
+// This class extrapolates the shapes of the sensors to any time instant with a constant acceleration
+// Kalman filter. Every coordinate of every shape point (tip included) is a [position, velocity, acceleration]
+// state. All of them share the same model, time step and noise, so they also share the same covariance
+// and gain: the filter costs one 3x3 covariance update plus a few vectorised operations on the shapes.
+//
+// A measurement is considered taken at the time stamp of the sample minus the measurement latency
+// (interrogator processing and transport). The latency cannot be observed from the stream: the time stamps
+// only date the arrival of the samples, it has to be calibrated and configured (0 by default). The
+// synchronised time stamp of a ClockSynchronizer removes the jitter of the arrivals, not the latency.
+// The prediction horizon of a query is its distance from the measurement time.
+class ShapePredictor
+{
+public:
+
+    typedef std::chrono::high_resolution_clock::time_point TimePoint;
+
+
+    // Process noise as jerk spectral density [m^2/s^5], measurement noise as variance [m^2],
+    // measurement latency
+    ShapePredictor(const double t_process_noise=1.0,
+                   const double t_measurement_noise=1e-8,
+                   const std::chrono::microseconds t_latency=std::chrono::microseconds(0));
+
+
+    void setLatency(const std::chrono::microseconds t_latency);
+
+    void reset();
+
+
+    // Include a new sample, to be called by the acquisition thread with its (synchronised) time stamp.
+    // Works with any sensor type exposing a num_points x 3 shape matrix
+    template<typename Sensor>
+    void update(const TimePoint &t_time_stamp,
+                const std::vector<Sensor> &t_sensors);
+
+
+    // Shape of the given sensor extrapolated at t_time, t_shape keeps the same layout as Sensor::shape
+    bool predictShape(const unsigned int t_sensor,
+                      const TimePoint &t_time,
+                      Eigen::MatrixXd &t_shape) const;
+
+    bool predictTip(const unsigned int t_sensor,
+                    const TimePoint &t_time,
+                    Eigen::Vector3d &t_tip) const;
+
+
+    // Age of the last measurement at t_time, in seconds
+    double getSampleAge(const TimePoint &t_time) const;
+
+
+private:
+
+    struct Filter
+    {
+        Eigen::MatrixXd position;       //num_points x 3 matrix
+        Eigen::MatrixXd velocity;       //num_points x 3 matrix
+        Eigen::MatrixXd acceleration;   //num_points x 3 matrix
+    };
+
+
+    void initialiseFilter(Filter &t_filter, const Eigen::MatrixXd &t_shape) const;
+
+    void predictCovariance(const double t_dt);
+
+    void correctFilter(Filter &t_filter,
+                       const double t_dt,
+                       const Eigen::MatrixXd &t_shape) const;
+
+    double horizon(const TimePoint &t_time) const;
+
+
+    double m_process_noise { 1.0 };
+    double m_measurement_noise { 1e-8 };
+    std::chrono::microseconds m_latency { 0 };
+
+    //  Shared by all the coordinates, as well as the gain
+    Eigen::Matrix3d m_covariance;
+    Eigen::Vector3d m_gain;
+
+    std::vector<Filter> m_filters;
+
+    TimePoint m_measurement_time;
+    bool m_initialised { false };
+
+    //  Held only for the few microseconds of an update or of a query
+    mutable std::mutex m_mutex;
+};
+
+
+
+
+template<typename Sensor>
+void ShapePredictor::update(const TimePoint &t_time_stamp,
+                            const std::vector<Sensor> &t_sensors)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const TimePoint measurement_time = t_time_stamp - m_latency;
+
+
+    bool topology_changed = m_filters.size() != t_sensors.size();
+    for(unsigned int i=0; not topology_changed and i<t_sensors.size(); i++)
+        topology_changed = m_filters[i].position.rows() != t_sensors[i].shape.rows();
+
+
+    if(not m_initialised or topology_changed){
+        m_filters.resize(t_sensors.size());
+        for(unsigned int i=0; i<t_sensors.size(); i++)
+            initialiseFilter(m_filters[i], t_sensors[i].shape);
+
+        m_covariance = Eigen::Vector3d(m_measurement_noise, 1.0, 100.0).asDiagonal();
+        m_measurement_time = measurement_time;
+        m_initialised = true;
+        return;
+    }
+
+
+    const double dt = std::chrono::duration<double>(measurement_time - m_measurement_time).count();
+    if(dt <= 0)
+        return;
+
+    predictCovariance(dt);
+
+    for(unsigned int i=0; i<t_sensors.size(); i++)
+        correctFilter(m_filters[i], dt, t_sensors[i].shape);
+
+    m_measurement_time = measurement_time;
+}
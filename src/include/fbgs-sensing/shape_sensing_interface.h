@@ -11,8 +11,13 @@ Copyright (C) 2022 Sven Lilge, Continuum Robotics Laboratory, University of Toro
 #include <vector>
 #include <Eigen/Dense>
 
+#include <utility>
+#include <optional>
+
 #include <boost/array.hpp>
 #include <boost/asio.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/use_awaitable.hpp>
 
 #include <memory>
 
@@ -22,12 +27,30 @@ Copyright (C) 2022 Sven Lilge, Continuum Robotics Laboratory, University of Toro
 #include <time_series/time_series.hpp>
 
 #include <mutex>
+#include <functional>
+#include <array>
 
 #include <deque>
 
 
 #include <yaml-cpp/yaml.h>
 
+#include "fbgs-sensing/acquisition_control.h"
+#include "fbgs-sensing/connection_supervisor.h"
+#include "fbgs-sensing/wait_policy.h"
+#include "fbgs-sensing/real_time_config.h"
+#include "fbgs-sensing/strain_converter.h"
+#include "fbgs-sensing/clock_synchronizer.h"
+#include "fbgs-sensing/sample_sequence_monitor.h"
+#include "fbgs-sensing/tip_state_estimator.h"
+#include "fbgs-sensing/shape_predictor.h"
+#include "fbgs-sensing/shape_interpolator.h"
+#include "fbgs-sensing/modal_shape_codec.h"
+#include "fbgs-sensing/shared_memory_ring.h"
+#include "fbgs-sensing/raw_capture.h"
+#include "fbgs-sensing/instrumentation.h"
+#include "fbgs-sensing/memory_footprint.h"
+
 // This class implements a simple interface to the FBGS sensing system utilizing TCP sockets
 class ShapeSensingInterface
 {
@@ -44,6 +67,7 @@ public:
         Eigen::Vector4i error_status;
         Eigen::VectorXd	peak_wavelengths; //num_gratings x 1 vector
         Eigen::VectorXd	peak_powers; //num_gratings x 1 vector
+        Eigen::VectorXd	strains; //num_gratings x 1 vector, only filled when a StrainConverter is set
     };
 
     struct Sensor
@@ -55,6 +79,11 @@ public:
         int num_shape_points;
         Eigen::MatrixXd shape; //num_shape_points x 3 matrix
         Eigen::VectorXd arc_length; //num_shape_points x 1 vector
+
+        //  Only filled when the tip state estimation is enabled
+        Eigen::Vector3d tip_position { Eigen::Vector3d::Zero() };
+        Eigen::Vector3d tip_velocity { Eigen::Vector3d::Zero() };
+        Eigen::Vector3d tip_acceleration { Eigen::Vector3d::Zero() };
     };
 
     //Structure
@@ -63,7 +92,15 @@ public:
 
 
         int sample_number;
+        //  Samples lost between the previous sample and this one
+        unsigned int missed_since_previous { 0 };
         std::chrono::high_resolution_clock::time_point time_stamp;
+        //  Time stamp without the transport jitter, equal to time_stamp without a ClockSynchronizer
+        std::chrono::high_resolution_clock::time_point synchronised_time_stamp;
+        //  Stages of the acquisition of the sample, with time_stamp (frame read): the frame started to be read
+        //  (the socket was readable, or the previous frame done) and the frame was parsed
+        std::chrono::high_resolution_clock::time_point readable_time_stamp;
+        std::chrono::high_resolution_clock::time_point parsed_time_stamp;
         int num_channels;
         int num_sensors;
 
@@ -78,9 +115,11 @@ public:
 //    // Constructor
 //    ShapeSensingInterface(std::string ip_address, std::string port_number);
 
-    ShapeSensingInterface(std::shared_ptr<const bool> t_stop_demos,
-                          std::shared_ptr<const bool> t_start_recording,
-                          const double t_frequency=100);
+    // The control and the io_context can be shared among several interfaces (see AcquisitionManager),
+    // new ones are created if not given
+    ShapeSensingInterface(std::shared_ptr<AcquisitionControl> t_control=nullptr,
+                          const double t_frequency=100,
+                          std::shared_ptr<boost::asio::io_context> t_io_context=nullptr);
 	
 	// Simple destructor
 	~ShapeSensingInterface();
@@ -90,25 +129,186 @@ public:
 
 	
 	
+    void setAddress(const std::string &t_ip_address, const std::string &t_port_number)
+    {
+        m_ip_address = t_ip_address;
+        m_port_number = t_port_number;
+    }
+
 	bool connect();
     bool nextSampleReady();
     bool readNextSample(Sample &sample);
 
+    //  The steps of readNextSample(): read the raw frame, parse it and run the online processing
+    bool readFrame();
+    bool parseFrame(const char *t_data,
+                    const std::size_t t_size,
+                    Sample &sample) const;
+    void processSample(Sample &sample);
+
+    //  Keeps the sample if recording and forwards it to the sample callback
+    void storeSample(const Sample &sample);
+
     void extracted(Sample const &sample, Eigen::VectorXd &sample_data,
                    unsigned int &index) const;
     Eigen::MatrixXd getDataAsEigenMatrix() const;
 
 
+    //  The time stamps are the synchronised ones, without the jitter when a ClockSynchronizer is set
     void getSamplesData(YAML::Node &t_FBGS_node, Eigen::MatrixXd &t_FBGS_data)const;
 
+    //  Same as getSamplesData but the shapes are stored as modal coefficients
+    void getSamplesModalData(YAML::Node &t_FBGS_node,
+                             Eigen::MatrixXd &t_FBGS_data,
+                             ModalShapeCodec &t_codec)const;
+
+
+    //  Drops, duplicates and reorders of the stream since the connection, can be called at any time
+    SampleSequenceMonitor::Statistics getSequenceStatistics() const
+    {
+        return m_sequence_monitor.getStatistics();
+    }
+
+
+    //  Estimates the time stamps of the samples from their sample numbers, the synchronised
+    //  time stamps are then used by the predictor and the interpolator
+    void setClockSynchronizer(std::shared_ptr<ClockSynchronizer> t_clock_synchronizer)
+    {
+        m_clock_synchronizer = t_clock_synchronizer;
+    }
+
+
+    //  Computes the strains of every channel from the peak wavelengths of each new sample
+    void setStrainConverter(std::shared_ptr<StrainConverter> t_strain_converter)
+    {
+        m_strain_converter = t_strain_converter;
+    }
+
+
+    //  Estimates position, velocity and acceleration of the tip of every sensor at each new sample,
+    //  the samples are dated by their sample number at the frequency given to the constructor
+    void enableTipStateEstimation(const double t_alpha=0.5,
+                                  const double t_beta=0.1,
+                                  const double t_gamma=0.01)
+    {
+        m_tip_estimator_gains << t_alpha, t_beta, t_gamma;
+        m_tip_estimators.clear();
+        m_estimate_tip_state = true;
+    }
+
+    void estimateTipStates(Sample &sample);
+
 
-    void startRecordinLoop()
+    //  Feeds every new sample to a predictor that extrapolates the shapes to the current time,
+    //  with the synchronised time stamps if a ClockSynchronizer is set
+    void setShapePredictor(std::shared_ptr<ShapePredictor> t_shape_predictor)
     {
-        thread = std::thread([&](){recordingLoop();});
+        m_shape_predictor = t_shape_predictor;
+    }
+
 
+    //  Keeps the history of the last samples to interpolate the shapes at a higher rate
+    void setShapeInterpolator(std::shared_ptr<ShapeInterpolator> t_shape_interpolator)
+    {
+        m_shape_interpolator = t_shape_interpolator;
+    }
+
+
+    //  Publishes every new sample in a shared memory ring, read by other processes with a SharedMemoryReader.
+    //  The segment is created at the first sample, with one block per quantity:
+    //  "channel<i>/wavelengths", "channel<i>/powers", "channel<i>/strains" (num_gratings x 1),
+    //  "sensor<j>/kappa", "sensor<j>/phi" (num_curv_points x 1), "sensor<j>/shape" (num_shape_points x 3),
+    //  "sensor<j>/arc_length" (num_shape_points x 1) and "sensor<j>/tip_state" (3 x 3, position, velocity, acceleration)
+    void enableSharedMemoryPublisher(const std::string &t_name,
+                                     const unsigned int t_num_slots=64)
+    {
+        m_shared_memory_publisher = std::make_unique<SharedMemoryPublisher>(t_name, t_num_slots);
     }
 
 
+    //  Raw capture mode, the cheapest acquisition: while recording, the thread started by startRecordinLoop() and
+    //  the asynchronous acquisition append the frames with their receive times to a raw capture instead of parsing
+    //  them, so there are no samples, callbacks nor processing (next() parses and captures). The capture is parsed offline
+    //  with parseRawCapture() and loadSamples(), see fbgs_parse_capture. The file is complete after shutdown()
+    bool enableRawCapture(const std::string &t_file_name,
+                          const RawCaptureConfig &t_config=RawCaptureConfig());
+
+    RawCaptureWriter::Statistics getRawCaptureStatistics() const
+    {
+        return m_raw_capture ? m_raw_capture->getStatistics() : RawCaptureWriter::Statistics();
+    }
+
+    //  Adds samples parsed offline to the recorded ones, through the online processing, to export them with
+    //  getSamplesData(). The times are counted from the first sample
+    void loadSamples(std::vector<Sample> &t_samples);
+
+
+    //  Memory of the recorded samples (bytes per sample, total, projection), can be called at any time
+    MemoryFootprint getMemoryFootprint() const { return m_memory_account.getFootprint(); }
+
+    //  Limits the memory of the recorded samples, to warn or spill to a raw capture before it runs out.
+    //  The spill file continues the recording of the thread started by startRecordinLoop(), of the asynchronous
+    //  acquisition and of next(), from the frame that does not fit, while the samples are still parsed and
+    //  processed. It is created here, with blocks sized from the budget and counted in it, so that nothing is
+    //  allocated when the memory runs out
+    void setMemoryBudget(const MemoryBudget &t_memory_budget);
+
+    //  Bytes of a recorded sample, with the allocator overhead of its buffers
+    static std::size_t sampleBytes(const Sample &sample);
+
+    void publishSample(const Sample &sample);
+
+
+    void startRecordinLoop();
+
+
+    //  Wake the acquisition thread immediately, see AcquisitionControl
+    void startRecording() { m_control->startRecording(); }
+    void stopRecording() { m_control->stopRecording(); }
+
+    //  Also waits for the acquisition thread to finish, so the samples can be safely read afterwards.
+    //  From a signal handler use getControl()->shutdown() instead
+    void shutdown()
+    {
+        m_control->shutdown();
+
+        joinRecordingThread();
+
+        if(m_raw_capture)
+            m_raw_capture->close();
+        if(m_spill_capture)
+            m_spill_capture->close();
+    }
+
+
+    //  Scheduling, affinity and memory settings of the thread started by startRecordinLoop()
+    void setRealTimeConfig(const RealTimeConfig &t_real_time_config)
+    {
+        m_real_time_config = t_real_time_config;
+    }
+
+    std::shared_ptr<AcquisitionControl> getControl() const { return m_control; }
+
+
+    //  Reconnects automatically when the link drops, the recording continues after the gap
+    void setReconnectPolicy(const ReconnectPolicy &t_reconnect_policy)
+    {
+        m_connection_supervisor.setPolicy(t_reconnect_policy);
+    }
+
+    unsigned int getNumberOfReconnections() const { return m_connection_supervisor.getNumberOfReconnections(); }
+
+
+    //  How the thread started by startRecordinLoop() waits for the frames, to be set before it starts
+    void setWaitPolicy(const WaitPolicy &t_wait_policy)
+    {
+        m_socket_waiter.setPolicy(t_wait_policy);
+    }
+
+    //  CPU time and wake-up latency of the acquisition thread, to choose the wait policy
+    SocketWaiter::Statistics getWaitStatistics() const { return m_socket_waiter.getStatistics(); }
+
+
 
     //    bool fetchDataFromTCPIP(unsigned int &index);
 
@@ -117,6 +317,32 @@ public:
     //    bool fetchDataFromTCPIP();
 
     void recordingLoop();
+
+
+    //  Reads the stream with asynchronous operations on the io_context, which must be run by the caller.
+    //  Alternative to startRecordinLoop() to serve several devices from the same thread
+    void startAsyncAcquisition();
+
+    //  Coroutine alternative to startAsyncAcquisition(), the two must not be used together.
+    //  The next sample of the stream, empty once the stream ended (closed without reconnection or shutdown).
+    //  The sample goes through the same processing and recording as with the other acquisition modes.
+    //  Example, with several devices on the same io_context (see SampleStream on testing a co_await):
+    //      boost::asio::co_spawn(*io_context, [&]() -> boost::asio::awaitable<void> {
+    //          while(std::optional<Sample> sample = co_await interface.next()){
+    //              ...
+    //          }
+    //      }, boost::asio::detached);
+    boost::asio::awaitable<std::optional<Sample>> next();
+
+    //  Same as next() but reuses t_sample, false once the stream ended
+    boost::asio::awaitable<bool> next(Sample &t_sample);
+
+
+    //  Called from the acquisition thread for every new sample
+    void setSampleCallback(std::function<void(const Sample&)> t_sample_callback)
+    {
+        m_sample_callback = t_sample_callback;
+    }
     // private:
 
     int m_size;
@@ -126,10 +352,24 @@ public:
     std::string m_port_number { "5001" };
 	bool m_connected;
 			
-	boost::asio::io_context m_io_context;
+    std::shared_ptr<boost::asio::io_context> m_io_context;
 	boost::asio::ip::tcp::resolver m_resolver;
 	boost::asio::ip::tcp::socket m_socket;
 
+    //  Last frame received, reused to avoid allocations
+    std::vector<char> m_frame;
+    std::chrono::high_resolution_clock::time_point m_frame_time_stamp;
+    std::chrono::high_resolution_clock::time_point m_readable_time_stamp;
+
+    //  State of the asynchronous acquisition
+    void asyncReadFrame();
+    void onAsyncReadError(const boost::system::error_code &t_error);
+    boost::asio::awaitable<bool> awaitReconnection();
+    std::array<char, 4> m_async_header;
+    Sample m_async_sample;
+
+    std::function<void(const Sample&)> m_sample_callback { nullptr };
+
 
 
 
@@ -139,13 +379,71 @@ public:
 
 
 
-    std::shared_ptr<const bool> m_stop_demos { nullptr };
+    std::shared_ptr<AcquisitionControl> m_control { nullptr };
+
+    //  Readable whenever the state of the control changes
+    int m_control_event_fd { -1 };
+
+    ConnectionSupervisor m_connection_supervisor;
+
+    SocketWaiter m_socket_waiter;
+
+
+    SampleSequenceMonitor m_sequence_monitor;
+
+    std::shared_ptr<ClockSynchronizer> m_clock_synchronizer { nullptr };
+
+    std::shared_ptr<StrainConverter> m_strain_converter { nullptr };
+
+
+    bool m_estimate_tip_state { false };
+    Eigen::Vector3d m_tip_estimator_gains { 0.5, 0.1, 0.01 };
+    std::vector<TipStateEstimator> m_tip_estimators;
+
+    std::shared_ptr<ShapePredictor> m_shape_predictor { nullptr };
+
+    std::shared_ptr<ShapeInterpolator> m_shape_interpolator { nullptr };
+
+    std::unique_ptr<SharedMemoryPublisher> m_shared_memory_publisher { nullptr };
 
-    std::shared_ptr<const bool> m_start_recording { nullptr };
+    std::unique_ptr<RawCaptureWriter> m_raw_capture { nullptr };
+
+    //  Receives the frames recorded once the memory budget is exhausted
+    std::unique_ptr<RawCaptureWriter> m_spill_capture { nullptr };
+    bool m_spill_active { false };
+
+    //  Appends the last frame read to the raw capture if recording
+    void captureFrame();
+
+    //  Keeps the sample in the recorded samples within the memory budget, false if it does not fit
+    bool recordSample(const Sample &sample);
+
+    SampleMemoryAccount m_memory_account;
 
 
 
     std::thread thread;
+
+    RealTimeConfig m_real_time_config;
+    real_time_tools::RealTimeThread m_real_time_thread;
+    bool m_real_time_thread_running { false };
+
+    static void *recordingLoopHelper(void *t_interface)
+    {
+        static_cast<ShapeSensingInterface*>(t_interface)->recordingLoop();
+        return nullptr;
+    }
+
+    void joinRecordingThread()
+    {
+        if(thread.joinable() and thread.get_id() != std::this_thread::get_id())
+            thread.join();
+
+        if(m_real_time_thread_running){
+            m_real_time_thread.join();
+            m_real_time_thread_running = false;
+        }
+    }
     std::chrono::high_resolution_clock::time_point m_start;
 
     std::deque<Sample> m_samples_stack;
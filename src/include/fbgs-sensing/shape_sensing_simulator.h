@@ -0,0 +1,78 @@
+/*
+This code implements a simulation of the stream of the FBGS Shape Sensing interrogator
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include <Eigen/Dense>
+
+#include "fbgs-sensing/frame_server.h"
+#include "fbgs-sensing/fiber_motion.h"
+
+
+// This class generates the frames of the Shape Sensing interrogator, in the exact format parsed by
+// ShapeSensingInterface, for sensors following a FiberMotion. Every sensor has 4 channels (3 outer cores
+// 120 degrees apart and the central core) whose peak wavelengths follow the bending strains, followed by
+// the curvature, the curvature angle and the shape. The shape points are 1 mm apart, as assumed by the interface.
+//
+// Served by a FrameServer it replaces the interrogator on a dev box:
+//      ShapeSensingSimulator::Config config;
+//      config.frequency = 1000;
+//      FrameServer server(std::make_shared<ShapeSensingSimulator>(config), "127.0.0.1", 5001);
+//      server.start();
+class ShapeSensingSimulator : public FrameSource
+{
+public:
+
+    struct Config
+    {
+        double frequency { 100 };               //  Hz
+
+        int num_sensors { 1 };
+        int num_gratings { 10 };                //  per channel, also the number of curvature points
+        int num_shape_points { 200 };
+
+        //  0 for an endless stream
+        std::uint64_t num_samples { 0 };
+
+        FiberMotion::Parameters motion;
+
+        //  Of the wavelengths, as used by StrainConverter
+        double gauge_factor { 0.78 };
+    };
+
+
+    explicit ShapeSensingSimulator(const Config &t_config);
+
+
+    bool nextFrame(std::vector<char> &t_frame,
+                   double &t_time) override;
+
+
+    const Config &getConfig() const { return m_config; }
+
+    // Ground truth, the motion of every sensor (each one is phase shifted)
+    const FiberMotion &getMotion(const int t_sensor) const { return m_motions.at(t_sensor); }
+
+    // Unstrained wavelength (nm) of a grating, the same for all the channels
+    double getReferenceWavelength(const int t_grating) const;
+
+
+private:
+
+    Config m_config;
+
+    std::vector<FiberMotion> m_motions;
+
+    //  The interrogator keeps counting when the client reconnects
+    std::uint64_t m_sample_number { 0 };
+
+    std::string m_date;
+
+    //  Reused between frames
+    Eigen::MatrixXd m_shape;
+};
@@ -0,0 +1,207 @@
+/*
+This code implements the publication of the samples to other processes through shared memory
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <Eigen/Dense>
+
+#include "fbgs-sensing/memory_footprint.h"
+
+
+// The shared memory segment is a header followed by a ring of fixed stride slots. Every slot holds the
+// sample number, the time stamp and the data of one sample as a list of column major blocks of doubles,
+// whose names and sizes are described once in the header (they are derived from the topology of the
+// first sample). Slots are protected by a sequence number (seqlock): odd while written, 2*(index+1) once
+// the sample index is complete. Readers never block the publisher, they check the sequence after reading.
+namespace shared_memory
+{
+
+constexpr std::uint64_t MAGIC { 0x46424753524e4731 };   //  "FBGSRNG1"
+constexpr std::uint32_t VERSION { 1 };
+constexpr std::uint32_t MAX_BLOCKS { 128 };
+constexpr std::size_t NAME_SIZE { 32 };
+
+
+struct BlockDescriptor
+{
+    char name[NAME_SIZE];
+    std::uint32_t rows;
+    std::uint32_t cols;
+    std::uint64_t offset;   //  in doubles from the start of the payload of a slot
+};
+
+
+struct alignas(64) Header
+{
+    std::uint64_t magic;
+    std::uint32_t version;
+    std::uint32_t num_slots;
+    std::uint64_t slot_stride;          //  bytes, multiple of 64
+    std::uint64_t payload_size;         //  doubles
+    std::uint32_t num_blocks;
+    BlockDescriptor blocks[MAX_BLOCKS];
+
+    alignas(64) std::atomic<std::uint64_t> write_count;
+};
+
+
+struct alignas(64) SlotHeader
+{
+    std::atomic<std::uint64_t> sequence;
+    std::int64_t sample_number;
+    std::int64_t time_stamp_ns;     //  synchronised time stamp, since the epoch of the high resolution clock
+};
+
+}
+
+
+
+
+// Publisher side, owns the segment and removes it on destruction
+class SharedMemoryPublisher
+{
+public:
+
+    struct Block
+    {
+        std::string name;
+        unsigned int rows;
+        unsigned int cols;
+    };
+
+
+    SharedMemoryPublisher(const std::string &t_name,
+                          const unsigned int t_num_slots=64);
+
+    ~SharedMemoryPublisher();
+
+    SharedMemoryPublisher(const SharedMemoryPublisher&) = delete;
+    SharedMemoryPublisher &operator=(const SharedMemoryPublisher&) = delete;
+
+
+    // Creates the segment with the given layout
+    bool create(const std::vector<Block> &t_blocks);
+
+    bool isCreated() const { return m_header != nullptr; }
+
+    // True if the blocks have the same sizes as the ones of the segment
+    bool matches(const std::vector<Block> &t_blocks) const;
+
+
+    // Opens the next slot for writing, then fill the blocks and publish it
+    void beginWrite(const std::int64_t t_sample_number,
+                    const std::int64_t t_time_stamp_ns);
+
+    Eigen::Map<Eigen::MatrixXd> block(const unsigned int t_block);
+
+    void endWrite();
+
+
+    const std::string &getName() const { return m_name; }
+
+    std::size_t getSegmentSize() const { return m_size; }
+    std::size_t getSlotStride() const { return m_header ? m_header->slot_stride : 0; }
+    unsigned int getNumberOfSlots() const { return m_num_slots; }
+
+    unsigned int getNumberOfBlocks() const { return m_header ? m_header->num_blocks : 0; }
+
+    // The segment, of fixed size: the memory does not grow with the samples published
+    MemoryFootprint getMemoryFootprint() const;
+
+    // Number of doubles of a block
+    std::size_t blockSize(const unsigned int t_block) const
+    {
+        return static_cast<std::size_t>(m_header->blocks[t_block].rows) * m_header->blocks[t_block].cols;
+    }
+
+
+private:
+
+    std::string m_name;
+    unsigned int m_num_slots { 64 };
+
+    int m_fd { -1 };
+    std::size_t m_size { 0 };
+    shared_memory::Header *m_header { nullptr };
+
+    std::uint64_t m_index { 0 };
+    shared_memory::SlotHeader *m_slot { nullptr };
+};
+
+
+
+
+// Reader side, can be used by any process knowing the name of the segment
+class SharedMemoryReader
+{
+public:
+
+    // A slot as seen by the reader. The maps point directly into the shared memory:
+    // the data must be considered valid only if isValid() is still true after using it
+    class View
+    {
+    public:
+        std::uint64_t index { 0 };
+        std::int64_t sample_number { 0 };
+        std::int64_t time_stamp_ns { 0 };
+
+        Eigen::Map<const Eigen::MatrixXd> block(const unsigned int t_block) const;
+
+    private:
+        friend class SharedMemoryReader;
+
+        const shared_memory::Header *m_header { nullptr };
+        const shared_memory::SlotHeader *m_slot { nullptr };
+        std::uint64_t m_sequence { 0 };
+    };
+
+
+    SharedMemoryReader(const std::string &t_name);
+
+    ~SharedMemoryReader();
+
+    SharedMemoryReader(const SharedMemoryReader&) = delete;
+    SharedMemoryReader &operator=(const SharedMemoryReader&) = delete;
+
+
+    // Fails until the publisher has received its first sample
+    bool open();
+
+    bool isOpen() const { return m_header != nullptr; }
+
+
+    // Number of samples published so far
+    std::uint64_t getWriteCount() const;
+
+    // View on the newest sample, or on the sample t_index if still in the ring
+    bool latest(View &t_view) const;
+    bool at(const std::uint64_t t_index, View &t_view) const;
+
+    bool isValid(const View &t_view) const;
+
+
+    unsigned int getNumberOfBlocks() const { return m_header ? m_header->num_blocks : 0; }
+    std::string getBlockName(const unsigned int t_block) const;
+
+    // Index of the block with the given name, -1 if not found
+    int findBlock(const std::string &t_name) const;
+
+
+private:
+
+    //  Size of the ring described by the header, 0 if the segment is not ready or too small for it
+    std::size_t checkedSegmentSize() const;
+
+
+    std::string m_name;
+
+    int m_fd { -1 };
+    std::size_t m_size { 0 };
+    const shared_memory::Header *m_header { nullptr };
+};
@@ -0,0 +1,167 @@
+/*
+This code implements the conversion of FBG peak wavelengths into strains
+*/
+
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <limits>
+#include <Eigen/Dense>
+
+
+// This class converts the raw peak wavelengths streamed by the interrogator into strains.
+// For every grating i the strain is computed as
+//
+//      strain_i = 1e6 * ( lambda_i - lambda_0_i ) / ( k_i * lambda_0_i )     [microstrain]
+//
+// where lambda_0_i is the reference (unstrained) wavelength and k_i the gauge factor of the grating.
+// The reference wavelengths can be either given or captured with a tare that averages live samples.
+class StrainConverter
+{
+public:
+    // Constructor, the gauge factor is used for all the gratings unless specified otherwise
+    StrainConverter(const double t_gauge_factor=0.78);
+
+
+    // Number of gratings for every channel, allocates all the internal buffers
+    void setTopology(const std::vector<int> &t_num_gratings);
+
+    // Stacked vectors over all the gratings of all the channels (channel after channel)
+    // NOTE: to be set before the acquisition thread starts, they are not synchronised
+    // Throws std::invalid_argument if the size does not match the gratings of the topology
+    // (or, before the first sample, the size of the other vector)
+    void setReferenceWavelengths(const Eigen::VectorXd &t_reference_wavelengths);
+    void setGaugeFactors(const Eigen::VectorXd &t_gauge_factors);
+
+    const Eigen::VectorXd &getReferenceWavelengths() const { return m_reference_wavelengths; }
+    const Eigen::VectorXd &getGaugeFactors() const { return m_gauge_factors; }
+
+    bool hasReference() const { return m_has_reference.load(std::memory_order_acquire); }
+
+
+    // Ask to average the next t_number_of_samples samples into the reference wavelengths.
+    // It can be called from any thread, the averaging happens in the thread calling update()
+    void startTare(const unsigned int t_number_of_samples);
+    bool tareCompleted() const { return m_tare_completed.load(std::memory_order_acquire); }
+
+
+    // Fills channel.strains from channel.peak_wavelengths for all the channels.
+    // While a tare is running the samples are accumulated, and until there is a reference
+    // the strains are set to NaN.
+    // Works with any channel type exposing peak_wavelengths and strains.
+    template<typename Channel>
+    void update(std::vector<Channel> &t_channels);
+
+
+private:
+
+    template<typename Channel>
+    bool topologyMatches(const std::vector<Channel> &t_channels) const;
+
+    template<typename Channel>
+    static void invalidateStrains(std::vector<Channel> &t_channels);
+
+    void checkSize(const Eigen::VectorXd &t_vector, const Eigen::VectorXd &t_other) const;
+    void updateScales();
+
+    void beginTare(const unsigned int t_number_of_samples);
+    void completeTare();
+
+
+    double m_gauge_factor { 0.78 };
+
+    //  Gratings of every channel and their offset in the stacked vectors
+    std::vector<int> m_num_gratings;
+    std::vector<int> m_offsets;
+    int m_total_gratings { 0 };
+
+    Eigen::VectorXd m_reference_wavelengths;
+    Eigen::VectorXd m_gauge_factors;
+
+    //  1e6 / ( k_i * lambda_0_i ) precomputed once per reference
+    Eigen::VectorXd m_scales;
+
+    std::atomic<bool> m_has_reference { false };
+
+
+    //  Tare state, the request is the only part shared between threads
+    std::atomic<unsigned int> m_tare_request { 0 };
+    std::atomic<bool> m_tare_completed { false };
+    unsigned int m_tare_target { 0 };
+    unsigned int m_tare_count { 0 };
+    Eigen::VectorXd m_tare_sum;
+};
+
+
+
+
+template<typename Channel>
+bool StrainConverter::topologyMatches(const std::vector<Channel> &t_channels) const
+{
+    if(t_channels.size() != m_num_gratings.size())
+        return false;
+
+    for(unsigned int i=0; i<t_channels.size(); i++)
+        if(t_channels[i].num_gratings != m_num_gratings[i])
+            return false;
+
+    return true;
+}
+
+
+template<typename Channel>
+void StrainConverter::invalidateStrains(std::vector<Channel> &t_channels)
+{
+    //  The channels are reused from sample to sample, the previous strains must not survive
+    for(auto &channel : t_channels){
+        channel.strains.resize(channel.num_gratings);
+        channel.strains.setConstant(std::numeric_limits<double>::quiet_NaN());
+    }
+}
+
+
+template<typename Channel>
+void StrainConverter::update(std::vector<Channel> &t_channels)
+{
+    //  Allocation only happens at the first sample or if the interrogator changes configuration
+    if(not topologyMatches(t_channels)){
+        std::vector<int> num_gratings;
+        for(const auto &channel : t_channels)
+            num_gratings.push_back(channel.num_gratings);
+        setTopology(num_gratings);
+    }
+
+
+    if(const unsigned int requested = m_tare_request.exchange(0, std::memory_order_acq_rel); requested > 0)
+        beginTare(requested);
+
+
+    if(m_tare_target > 0){
+        for(unsigned int i=0; i<t_channels.size(); i++)
+            m_tare_sum.segment(m_offsets[i], m_num_gratings[i]) += t_channels[i].peak_wavelengths;
+
+        if(++m_tare_count == m_tare_target)
+            completeTare();
+
+        invalidateStrains(t_channels);
+        return;
+    }
+
+
+    if(not m_has_reference.load(std::memory_order_relaxed)){
+        invalidateStrains(t_channels);
+        return;
+    }
+
+
+    for(unsigned int i=0; i<t_channels.size(); i++){
+        auto &channel = t_channels[i];
+        const int offset = m_offsets[i];
+        const int num_gratings = m_num_gratings[i];
+
+        channel.strains.resize(num_gratings);
+        channel.strains.array() = ( channel.peak_wavelengths.array() - m_reference_wavelengths.segment(offset, num_gratings).array() )
+                                  * m_scales.segment(offset, num_gratings).array();
+    }
+}
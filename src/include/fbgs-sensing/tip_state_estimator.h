@@ -0,0 +1,65 @@
+/*
+This code implements an online estimator of the sensor tip kinematics
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <Eigen/Dense>
+
+
+// This class implements an alpha-beta-gamma filter on the tip position of a sensor.
+// It runs on every new sample. The time between two samples is the difference of their sample numbers
+// times the period of the interrogator: the arrival times would give a few microseconds for the frames
+// of a burst (initial dump, coalesced TCP segments). Missing samples are handled correctly, a sample
+// number going backward restarts the filter. All the quantities are fixed size: no allocation happens.
+class TipStateEstimator
+{
+public:
+
+    struct State
+    {
+        Eigen::Vector3d position { Eigen::Vector3d::Zero() };
+        Eigen::Vector3d velocity { Eigen::Vector3d::Zero() };
+        Eigen::Vector3d acceleration { Eigen::Vector3d::Zero() };
+    };
+
+
+    // Gains of the filter, larger values follow the measurements more closely but filter less
+    TipStateEstimator(const double t_alpha=0.5,
+                      const double t_beta=0.1,
+                      const double t_gamma=0.01,
+                      const double t_period=0.01);
+
+
+    void setGains(const double t_alpha,
+                  const double t_beta,
+                  const double t_gamma);
+
+    // Period of the samples of the interrogator [s]
+    void setPeriod(const double t_period);
+
+    void reset();
+
+
+    // Include a new measurement of the tip position of sample t_sample_number
+    const State &update(const std::int64_t t_sample_number,
+                        const Eigen::Vector3d &t_position);
+
+    const State &getState() const { return m_state; }
+
+    bool isInitialised() const { return m_number_of_updates >= 2; }
+
+
+private:
+
+    double m_alpha { 0.5 };
+    double m_beta { 0.1 };
+    double m_gamma { 0.01 };
+    double m_period { 0.01 };
+
+    State m_state;
+
+    std::int64_t m_last_sample_number { 0 };
+    unsigned int m_number_of_updates { 0 };
+};
@@ -0,0 +1,135 @@
+/*
+This code implements the strategies used by the acquisition threads to wait for the next frame
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include <time.h>
+
+
+// How the acquisition thread waits for data. Spinning gives the lowest wake-up latency but burns a core,
+// blocking costs no CPU but pays the scheduler wake-up, spinning then blocking is in between: the thread
+// spins for a short while after every frame, which catches the frames of a fast stream, and sleeps when
+// the stream is slow or stops.
+struct WaitPolicy
+{
+    enum class Strategy
+    {
+        SPIN,
+        SPIN_THEN_BLOCK,
+        BLOCK
+    };
+
+    Strategy strategy { Strategy::BLOCK };
+
+    //  Checks of the socket before sleeping with SPIN_THEN_BLOCK, one check takes about a microsecond
+    unsigned int spin_iterations { 1000 };
+
+    //  Measures the delay between the arrival of the data in the kernel (software receive time stamp)
+    //  and the wake-up of the thread, costs one extra system call per wake-up
+    bool measure_wake_latency { false };
+};
+
+
+
+// This class waits until a socket is readable or the state of the acquisition changes, with the strategy
+// of a WaitPolicy, and measures what the strategy costs and gives: CPU time of the waiting thread and wake-up
+// latency (from the SO_TIMESTAMPING software receive time stamp). The CPU clock of the thread is read when
+// the statistics are, so a thread that is behind, and never waits, still reports its CPU time.
+// configureSocket() and wait() are called by a single thread, the statistics can be read from any thread.
+class SocketWaiter
+{
+public:
+
+    struct Statistics
+    {
+        std::uint64_t wake_ups { 0 };           //  waits that ended with data, without the data already there
+        std::uint64_t spin_wake_ups { 0 };      //  of which found while spinning
+        std::uint64_t immediate { 0 };          //  waits that found the data already there
+        std::uint64_t timeouts { 0 };
+
+        double wall_time { 0 };                 //  s, since the first wait
+        double cpu_time { 0 };                  //  s, used by the waiting thread over the same time
+        double wait_cpu_time { 0 };             //  s, of which spent waiting
+        double cpu_load { 0 };                  //  cpu_time / wall_time, 1 for a whole core
+
+        std::uint64_t latency_count { 0 };
+        double latency_mean { 0 };              //  µs
+        double latency_p99 { 0 };               //  µs, upper bound of the bucket
+        double latency_max { 0 };               //  µs
+    };
+
+
+    SocketWaiter() = default;
+
+    explicit SocketWaiter(const WaitPolicy &t_policy) : m_policy(t_policy) {}
+
+
+    void setPolicy(const WaitPolicy &t_policy) { m_policy = t_policy; }
+    const WaitPolicy &getPolicy() const { return m_policy; }
+
+
+    // Sets the bytes to be queued before the socket is readable (see AcquisitionControl::setReadableThreshold())
+    // and enables the receive time stamps of the socket, to be called after every (re)connection.
+    // The measurement of the CPU time starts at the first call, or at the first wait
+    void configureSocket(const int t_fd,
+                         const int t_readable_threshold=1);
+
+
+    // Same contract as AcquisitionControl::waitReadable(): true only if t_fd is readable,
+    // false at the timeout (in ms, -1 for none) or when t_event_fd signals a change of state
+    bool wait(const int t_fd,
+              const int t_event_fd,
+              const int t_timeout_ms=-1);
+
+
+    // Once the thread ended, the times are the ones of its last wait
+    Statistics getStatistics() const;
+
+    // Not to be called while the thread waits
+    void reset();
+
+
+private:
+
+    //  0 if the socket is readable, 1 if the event fd is, -1 at the timeout
+    static int poll(const int t_fd, const int t_event_fd, const int t_timeout_ms);
+
+    void recordWakeLatency(const int t_fd);
+
+    void startMeasurement();
+
+    static std::int64_t threadCpuTimeNs();
+    static std::int64_t monotonicTimeNs();
+
+
+    WaitPolicy m_policy;
+
+
+    //  Single writer, the atomics are only there for the readers of the statistics
+    std::atomic<std::uint64_t> m_wake_ups { 0 };
+    std::atomic<std::uint64_t> m_spin_wake_ups { 0 };
+    std::atomic<std::uint64_t> m_immediate { 0 };
+    std::atomic<std::uint64_t> m_timeouts { 0 };
+
+    //  Written before m_measuring is set
+    std::int64_t m_first_wall_ns { -1 };
+    std::int64_t m_first_cpu_ns { 0 };
+    clockid_t m_cpu_clock { CLOCK_THREAD_CPUTIME_ID };
+    std::atomic_bool m_measuring { false };
+
+    std::atomic<std::int64_t> m_wall_ns { 0 };
+    std::atomic<std::int64_t> m_cpu_ns { 0 };
+    std::atomic<std::int64_t> m_wait_cpu_ns { 0 };
+
+    //  Latencies in power of two buckets of ns, bucket i holds [2^i, 2^(i+1))
+    static constexpr unsigned int LATENCY_BUCKETS { 40 };
+    std::array<std::atomic<std::uint64_t>, LATENCY_BUCKETS> m_latency_histogram {};
+    std::atomic<std::uint64_t> m_latency_count { 0 };
+    std::atomic<std::int64_t> m_latency_sum_ns { 0 };
+    std::atomic<std::int64_t> m_latency_max_ns { 0 };
+};
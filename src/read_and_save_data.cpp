@@ -19,25 +19,19 @@
 
 
 
-std::shared_ptr<bool> StopDemos =
-    std::make_shared<bool>(false);
+std::shared_ptr<AcquisitionControl> control =
+    std::make_shared<AcquisitionControl>();
 
 
 
 
 void my_handler(int)
 {
-    *StopDemos = true;
+    control->shutdown();
 }
 
 
 
-
-std::shared_ptr<bool> start_recording =
-    std::make_shared<bool>(false);
-
-
-
 void checkPathAndCreateFolders(const std::filesystem::path& t_path);
 
 
@@ -75,7 +69,6 @@ int main(int, char **)
     sigemptyset(&sigIntHandler.sa_mask);
     sigIntHandler.sa_flags = 0;
     sigaction(SIGINT, &sigIntHandler, NULL);
-    *StopDemos = false;
 
 
 
@@ -87,12 +80,10 @@ int main(int, char **)
 
 
 
-//    ShapeSensingInterface interface(StopDemos,
-//                                    start_recording,
+//    ShapeSensingInterface interface(control,
 //                                    recording_frequency);
 
-    IllumiSenseInterface interface(StopDemos,
-                                    start_recording,
+    IllumiSenseInterface interface(control,
                                    recording_frequency);
 
 
@@ -115,17 +106,17 @@ int main(int, char **)
     std::cout << "Input to start" << std::endl;
     getchar();
 
-    *start_recording = true;
+    interface.startRecording();
     std::cout << "\n\n";
 
     for(int i=5; i>=0; i--){
-        std::cout << "Recording : " << i << " s\r";
+        std::cout << "Recording : " << i << " s, dropped samples : " << interface.getSequenceStatistics().dropped << "   \r";
         std::cout.flush();
         std::this_thread::sleep_for(std::chrono::duration(std::chrono::seconds(1)));
     }
 
-    *StopDemos = true;
-    *start_recording = false;
+    interface.stopRecording();
+    interface.shutdown();
 
 
 
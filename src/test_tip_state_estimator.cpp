@@ -0,0 +1,72 @@
+#include <iostream>
+#include <cmath>
+
+#include "fbgs-sensing/tip_state_estimator.h"
+
+
+
+// Feeds the estimator the way the acquisition does after a stall: a burst of consecutive samples arriving
+// together, then samples with gaps. The tip moves at constant velocity, the estimated velocity must follow
+// it and the acceleration must stay small. Returns a non-zero status on failure.
+
+
+
+namespace
+{
+
+const double PERIOD { 0.001 };
+const Eigen::Vector3d VELOCITY { 0.02, -0.01, 0.005 };   //  m/s
+
+
+Eigen::Vector3d tipPosition(const std::int64_t t_sample_number)
+{
+    return Eigen::Vector3d(0.1, 0.05, 0.3) + VELOCITY*(t_sample_number*PERIOD);
+}
+
+
+bool check(const TipStateEstimator::State &t_state, const char *t_step)
+{
+    const double velocity_error = (t_state.velocity - VELOCITY).norm();
+    const double acceleration = t_state.acceleration.norm();
+
+    const bool ok = velocity_error < 0.1*VELOCITY.norm() and acceleration < 1;
+
+    std::cout << (ok ? "[OK]   " : "[FAIL] ") << t_step << ": velocity error " << velocity_error
+              << " m/s, acceleration " << acceleration << " m/s^2" << std::endl;
+
+    return ok;
+}
+
+}
+
+
+
+int main()
+{
+    bool ok = true;
+
+    TipStateEstimator estimator(0.5, 0.1, 0.01, PERIOD);
+
+    //  Initial dump: 200 samples received within a few microseconds
+    std::int64_t sample_number = 1000;
+    for(int i=0; i<200; i++, sample_number++)
+        estimator.update(sample_number, tipPosition(sample_number));
+    ok = check(estimator.getState(), "burst") and ok;
+
+    //  Regular stream with every other sample missing
+    for(int i=0; i<200; i++, sample_number += 2)
+        estimator.update(sample_number, tipPosition(sample_number));
+    ok = check(estimator.getState(), "missing samples") and ok;
+
+    //  Duplicates are ignored
+    estimator.update(sample_number - 2, tipPosition(sample_number - 2));
+    estimator.update(sample_number - 2, tipPosition(sample_number - 2));
+    ok = check(estimator.getState(), "duplicates") and ok;
+
+    //  Interrogator restarted, the filter starts again from its first samples
+    for(sample_number = 0; sample_number < 200; sample_number++)
+        estimator.update(sample_number, tipPosition(sample_number));
+    ok = check(estimator.getState(), "restart") and ok;
+
+    return ok ? 0 : 1;
+}